@@ -16,6 +16,8 @@ public:
     AudioSystem::InitParams initParams;
     initParams.audioSystemType = AudioSystemType::FMOD;
     initParams.audioAssetsPath = "assets/Audio/";
+    initParams.systemConfig.rightHanded = true; // OpenGL coordinates
+    initParams.systemConfig.occlusion.enabled = true;
 
     s_audioSystem.Initialise(initParams);
 	}
@@ -35,29 +37,71 @@ public:
     return s_audioSystem.LoadSound(soundName, soundMode);
 	}
 
+	static bool LoadSounds(const std::vector<std::string>& soundNames, AudioSystemSoundMode soundMode = AudioSystemSoundMode_DEFAULT, const AudioSystem::LoadProgressCallback& progress = nullptr)
+	{
+		return s_audioSystem.LoadSounds(soundNames, soundMode, progress);
+	}
+
+	static bool LoadSoundManifest(const std::string& manifestName, AudioSystemSoundMode soundMode = AudioSystemSoundMode_DEFAULT, const AudioSystem::LoadProgressCallback& progress = nullptr)
+	{
+		return s_audioSystem.LoadSoundManifest(manifestName, soundMode, progress);
+	}
+
 	static bool UnloadSound(const std::string& soundName)
 	{
     return s_audioSystem.UnloadSound(soundName);
 	}
 
-	static bool PlaySound(const std::string& soundName)
+	static bool MountSoundBank(const std::string& bankName)
+	{
+		return s_audioSystem.MountSoundBank(bankName);
+	}
+
+	static bool UnmountSoundBank(const std::string& bankName)
+	{
+		return s_audioSystem.UnmountSoundBank(bankName);
+	}
+
+	static bool IsSoundReady(const std::string& soundName)
+	{
+		return s_audioSystem.IsSoundReady(soundName);
+	}
+
+	// fadeTime: seconds the sound fades in or out (0 = at once)
+	static bool PlaySound(const std::string& soundName, float fadeTime = 0.0f)
+	{
+    return s_audioSystem.PlaySound(soundName, fadeTime);
+	}
+
+	// sample accurate: at a time of the audio clock, or some seconds from now
+	static bool PlaySoundAt(const std::string& soundName, double time)
+	{
+		return s_audioSystem.PlaySoundAt(soundName, time);
+	}
+
+	static bool PlaySoundDelayed(const std::string& soundName, float delay)
 	{
-    return s_audioSystem.PlaySound(soundName);
+		return s_audioSystem.PlaySoundDelayed(soundName, delay);
 	}
 
-	static bool StopSound(const std::string& soundName)
+	static double GetAudioTime()
 	{
-		return s_audioSystem.StopSound(soundName);
+		return s_audioSystem.GetOutputTime();
 	}
 
-	static bool PauseSound(const std::string& soundName)
+	static bool StopSound(const std::string& soundName, float fadeTime = 0.0f)
 	{
-		return s_audioSystem.PauseSound(soundName, true);
+		return s_audioSystem.StopSound(soundName, fadeTime);
 	}
 
-	static bool ResumeSound(const std::string& soundName)
+	static bool PauseSound(const std::string& soundName, float fadeTime = 0.0f)
 	{
-		return s_audioSystem.PauseSound(soundName, false);
+		return s_audioSystem.PauseSound(soundName, true, fadeTime);
+	}
+
+	static bool ResumeSound(const std::string& soundName, float fadeTime = 0.0f)
+	{
+		return s_audioSystem.PauseSound(soundName, false, fadeTime);
 	}
 
 	static bool SetSoundVolume(const std::string& soundName, float volume)
@@ -69,6 +113,27 @@ public:
 	{
     return s_audioSystem.SetSoundPitch(soundName, pitch);
 	}
+
+	// events (finished, looped, marker reached) are delivered to the callback of the sound during Update
+	static bool SetSoundCallback(const std::string& soundName, const AudioSystem::SoundCallback& callback)
+	{
+		return s_audioSystem.SetSoundCallback(soundName, callback);
+	}
+
+	static bool SetSoundMarkers(const std::string& soundName, const std::vector<float>& times)
+	{
+		return s_audioSystem.SetSoundMarkers(soundName, times);
+	}
+
+	static bool SetSoundLoop(const std::string& soundName, const AudioSystemLoop& loop)
+	{
+		return s_audioSystem.SetSoundLoop(soundName, loop);
+	}
+
+	static bool SetSoundFilter(const std::string& soundName, const AudioSystemFilter& filter)
+	{
+		return s_audioSystem.SetSoundFilter(soundName, filter);
+	}
 	
 	//////////////////////  3D AUDIO /////////////////////
 
@@ -81,6 +146,8 @@ public:
 
 		float minDistance { -1.0f };
 		float maxDistance { -1.0f };
+
+		AudioSystemRolloff rolloff;
 	};
 
 	class AudioSource
@@ -90,6 +157,8 @@ public:
 		IAudioSystemSound* sound { nullptr };
 		AudioSourceDesc desc;
 
+		AudioSystemEmitterHandle emitter;
+
 	public:
 
 		void Play()
@@ -98,6 +167,7 @@ public:
 			{
 				sound->Set3DAttributes(desc.position, desc.velocity);
 				sound->Set3DMinMaxDistance(desc.minDistance, desc.maxDistance);
+				sound->Set3DRolloff(desc.rolloff);
 			}
 		}
 
@@ -112,7 +182,7 @@ public:
 			if (sound)
 			{
 				desc.position = position;
-				sound->Set3DAttributes(position, desc.velocity);
+				s_audioSystem.SetEmitter3DAttributes(emitter, position, desc.velocity);
 			}
 		}
 
@@ -122,7 +192,7 @@ public:
 			if (sound)
 			{
 				desc.velocity = velocity;
-				sound->Set3DAttributes(desc.position, velocity);
+				s_audioSystem.SetEmitter3DAttributes(emitter, desc.position, velocity);
 			}
 		}
 
@@ -138,6 +208,16 @@ public:
 			}
 		}
 
+		void Set3DRolloff(const AudioSystemRolloff& rolloff)
+		{
+			assert(sound);
+			if (sound)
+			{
+				desc.rolloff = rolloff;
+				sound->Set3DRolloff(rolloff);
+			}
+		}
+
 		friend class AudioManager;
 	};
 	
@@ -156,11 +236,119 @@ public:
       auto sound = s_audioSystem.GetSound(desc.soundName);
       audioSource.desc = desc;
       audioSource.sound = sound;
+      audioSource.emitter = s_audioSystem.AddEmitter(desc.soundName);
+      s_audioSystem.SetEmitter3DAttributes(audioSource.emitter, desc.position, desc.velocity);
     }
 
 		return audioSource;
 	}
 
+	static void AddOcclusionBox(const AudioSystemOcclusionBox& box)
+	{
+		s_audioSystem.AddOcclusionBox(box);
+	}
+
+	static void ClearOcclusionBoxes()
+	{
+		s_audioSystem.ClearOcclusionBoxes();
+	}
+
+	static void SetRoom(const AudioSystemRoom& room)
+	{
+		s_audioSystem.SetRoom(room);
+	}
+
+	//////////////////////////////////////////////////////////
+
+	/////////////////////////  BUSES ////////////////////////
+
+	static bool CreateBus(const std::string& busName, const std::string& parentBusName = "")
+	{
+		return s_audioSystem.CreateBus(busName, parentBusName);
+	}
+
+	static bool SetBusVolume(const std::string& busName, float volume)
+	{
+		return s_audioSystem.SetBusVolume(busName, volume);
+	}
+
+	static bool PauseBus(const std::string& busName)
+	{
+		return s_audioSystem.PauseBus(busName, true);
+	}
+
+	static bool ResumeBus(const std::string& busName)
+	{
+		return s_audioSystem.PauseBus(busName, false);
+	}
+
+	static bool MuteBus(const std::string& busName)
+	{
+		return s_audioSystem.MuteBus(busName, true);
+	}
+
+	static bool UnmuteBus(const std::string& busName)
+	{
+		return s_audioSystem.MuteBus(busName, false);
+	}
+
+	static bool SetSoundBus(const std::string& soundName, const std::string& busName)
+	{
+		return s_audioSystem.SetSoundBus(soundName, busName);
+	}
+
+	static bool DuckBus(const std::string& busName, const std::string& sidechainBusName, const AudioSystemDucking& ducking = AudioSystemDucking())
+	{
+		return s_audioSystem.SetBusDucking(busName, sidechainBusName, ducking);
+	}
+
+	static bool UnduckBus(const std::string& busName)
+	{
+		return s_audioSystem.SetBusDucking(busName, "", AudioSystemDucking());
+	}
+
+	//////////////////////////////////////////////////////////
+
+	/////////////////////////  REVERB ////////////////////////
+
+	static void SetReverb(const AudioSystemReverb& reverb)
+	{
+		s_audioSystem.SetReverb(reverb);
+	}
+
+	static bool SetReverbImpulseResponse(const std::string& impulseResponseName)
+	{
+		return s_audioSystem.SetReverbImpulseResponse(impulseResponseName);
+	}
+
+	static bool SetSoundReverbSend(const std::string& soundName, float level)
+	{
+		return s_audioSystem.SetSoundReverbSend(soundName, level);
+	}
+
+	//////////////////////////////////////////////////////////
+
+	/////////////////////////  MASTER ////////////////////////
+
+	static void SetMasterDynamics(const AudioSystemMasterDynamics& dynamics)
+	{
+		s_audioSystem.SetMasterDynamics(dynamics);
+	}
+
+	//////////////////////////////////////////////////////////
+
+	/////////////////////////  STATS ////////////////////////
+
+	static bool GetMemoryStats(AudioSystemMemoryStats& outStats)
+	{
+		return s_audioSystem.GetMemoryStats(outStats);
+	}
+
+	static bool GetFileStats(AudioSystemFileStats& outStats)
+	{
+		return s_audioSystem.GetFileStats(outStats);
+	}
+
 	//////////////////////////////////////////////////////////
 
 
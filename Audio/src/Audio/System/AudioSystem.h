@@ -1,9 +1,16 @@
 #ifndef AUDIO_SYSTEM_H
 #define AUDIO_SYSTEM_H
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <set>
 
 #include "AudioSystemFactory.h"
+#include "System_Common\AudioSystemEmitters.h"
+#include "System_Common\AudioSystemOcclusion.h"
+#include "System_Common\AudioSystemParallel.h"
 
 // AudioSystem
 //
@@ -15,17 +22,34 @@ public:
   {
     AudioSystemType audioSystemType{ AudioSystemType::FMOD };
     const char* audioAssetsPath;
+
+    // max number of threads used to load sound batches (0 = one per hardware thread)
+    size_t maxLoadThreads{ 0 };
+
+    AudioSystemConfig systemConfig;
   };
 
+  using LoadProgressCallback = AudioSystemParallel::Progress;
+
+  // called during Update with the events of a sound
+  using SoundCallback = std::function<void(const std::string& soundName, const AudioSystemSoundEvent& event)>;
+
 
   void Initialise(const InitParams& params)
   {
     // init system
-    system = AudioSystemFactory::NewSystem(params.audioSystemType);
-    system->Initialise();
-
     // set audio assets path
     audioAssetsPath = params.audioAssetsPath;
+
+    AudioSystemConfig systemConfig = params.systemConfig;
+    systemConfig.assetsPath = audioAssetsPath;
+
+    system = AudioSystemFactory::NewSystem(params.audioSystemType);
+    system->Initialise(systemConfig);
+
+    maxLoadThreads = params.maxLoadThreads;
+
+    occlusion.Init(params.systemConfig.occlusion);
   }
 
   void Deinitialise()
@@ -41,6 +65,12 @@ public:
       system->UnloadSound(entry.second);
     }
     soundMap.clear();
+    soundCallbacks.clear();
+    bankSoundMap.clear();
+    soundBankMap.clear();
+    busMap.clear();
+    emitters.Clear();
+    occlusion.Deinit();
 
     // deinitialise system
     system->Deinitialise();
@@ -51,7 +81,25 @@ public:
   {
     if (system)
     {
+      // one batch with all the emitters moved this frame
+      AudioSystemEmitterBatch emitterBatch;
+      if (emitters.Flush(emitterBatch))
+      {
+        system->Set3DAttributes(emitterBatch);
+      }
+
+      if (occlusion.IsEnabled())
+      {
+        occlusion.Update(listenerPosition, emitters);
+        for (size_t emitter : occlusion.GetChangedEmitters())
+        {
+          emitters.GetSound(emitter)->Set3DOcclusion(occlusion.GetGain(emitter), occlusion.GetLowPassCutoff(emitter));
+        }
+      }
+
       system->Update();
+
+      DispatchSoundEvents();
     }
   }
 
@@ -68,19 +116,100 @@ public:
       return true;
     }
 
-    std::string soundPath = audioAssetsPath + soundName;
-    if (auto sound = system->LoadSound(soundPath, soundMode))
+    const AudioSystemSoundBank* soundBank = nullptr;
+    if (auto sound = NewSound(soundName, soundMode, soundBank))
     {
       // insert a new pair in the map
       soundMap.insert(std::make_pair(soundName, sound));
+      if (soundBank)
+      {
+        bankSoundMap.insert(std::make_pair(soundName, soundBank));
+      }
       return true;
     }
 
-    printf("Failed to load sound %s\n", soundPath.c_str());
+    printf("Failed to load sound %s\n", (audioAssetsPath + soundName).c_str());
 
     return false;
   }
 
+  // Load a batch of sounds concurrently. All the loaded sounds are added to the sound map at once when the batch is done.
+  bool LoadSounds(const std::vector<std::string>& soundNames, AudioSystemSoundMode soundMode = AudioSystemSoundMode_DEFAULT, const LoadProgressCallback& progress = nullptr)
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    // skip the sounds already loaded and the duplicated ones
+    std::vector<std::string> batch;
+    std::set<std::string> batchNames;
+    for (auto& soundName : soundNames)
+    {
+      if (soundMap.find(soundName) == soundMap.end() && batchNames.insert(soundName).second)
+      {
+        batch.push_back(soundName);
+      }
+    }
+
+    std::vector<IAudioSystemSound*> batchSounds(batch.size(), nullptr);
+    std::vector<const AudioSystemSoundBank*> batchSoundBanks(batch.size(), nullptr);
+    AudioSystemParallel::For(batch.size(), maxLoadThreads, [&](size_t i)
+    {
+      batchSounds[i] = NewSound(batch[i], soundMode, batchSoundBanks[i]);
+    }, progress);
+
+    // commit the batch
+    bool allLoaded = true;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      if (batchSounds[i])
+      {
+        soundMap.insert(std::make_pair(batch[i], batchSounds[i]));
+        if (batchSoundBanks[i])
+        {
+          bankSoundMap.insert(std::make_pair(batch[i], batchSoundBanks[i]));
+        }
+      }
+      else
+      {
+        printf("Failed to load sound %s\n", (audioAssetsPath + batch[i]).c_str());
+        allLoaded = false;
+      }
+    }
+
+    return allLoaded;
+  }
+
+  // Load all the sounds listed in a manifest file: one sound name per line, lines starting with '#' are ignored
+  bool LoadSoundManifest(const std::string& manifestName, AudioSystemSoundMode soundMode = AudioSystemSoundMode_DEFAULT, const LoadProgressCallback& progress = nullptr)
+  {
+    std::string manifestPath = audioAssetsPath + manifestName;
+    std::ifstream manifestFile(manifestPath.c_str());
+    if (!manifestFile.is_open())
+    {
+      printf("Failed to open sound manifest %s\n", manifestPath.c_str());
+      return false;
+    }
+
+    std::vector<std::string> soundNames;
+    std::string line;
+    while (std::getline(manifestFile, line))
+    {
+      // trim the line
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == std::string::npos || line[first] == '#')
+      {
+        continue;
+      }
+      size_t last = line.find_last_not_of(" \t\r");
+
+      soundNames.push_back(line.substr(first, last - first + 1));
+    }
+
+    return LoadSounds(soundNames, soundMode, progress);
+  }
+
   bool UnloadSound(const std::string& soundName)
   {
     if (!system)
@@ -95,16 +224,98 @@ public:
       return false;
     }
 
+    emitters.Remove(soundMapIt->second);
+    soundCallbacks.erase(soundMapIt->second);
+
     if (system->UnloadSound(soundMapIt->second))
     {
       soundMap.erase(soundMapIt);
+      bankSoundMap.erase(soundName);
       return true;
     }
 
     return false;
   }
 
-  bool PlaySound(const std::string& soundName)
+  // Mount a sound bank. Sounds found in the mounted banks are loaded from them instead of from loose files.
+  bool MountSoundBank(const std::string& bankName)
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    if (soundBankMap.find(bankName) != soundBankMap.end())
+    {
+      // bank already mounted
+      return true;
+    }
+
+    if (auto soundBank = system->MountSoundBank(audioAssetsPath + bankName))
+    {
+      soundBankMap.insert(std::make_pair(bankName, soundBank));
+      return true;
+    }
+
+    return false;
+  }
+
+  // Unmount a sound bank. The sounds loaded from it are unloaded as their samples live in the bank.
+  bool UnmountSoundBank(const std::string& bankName)
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    auto soundBankMapIt = soundBankMap.find(bankName);
+    if (soundBankMapIt == soundBankMap.end())
+    {
+      printf("Failed to unmount sound bank %s. Error: Sound bank not mounted.\n", bankName.c_str());
+      return false;
+    }
+
+    const AudioSystemSoundBank* soundBank = soundBankMapIt->second;
+
+    std::vector<std::string> bankSounds;
+    for (auto& entry : bankSoundMap)
+    {
+      if (entry.second == soundBank)
+      {
+        bankSounds.push_back(entry.first);
+      }
+    }
+
+    // the sounds are no longer mixed once unloaded: only then the bank can be unmapped
+    bool unloaded = true;
+    for (auto& soundName : bankSounds)
+    {
+      unloaded &= UnloadSound(soundName);
+    }
+
+    if (!unloaded)
+    {
+      printf("Failed to unmount sound bank %s. Error: Unable to unload its sounds.\n", bankName.c_str());
+      return false;
+    }
+
+    if (!system->UnmountSoundBank(soundBank))
+    {
+      return false;
+    }
+
+    soundBankMap.erase(soundBankMapIt);
+    return true;
+  }
+
+  // A sound loaded with AudioSystemSoundMode_NONBLOCKING is not ready until its load is done
+  bool IsSoundReady(const std::string& soundName)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    return sound && sound->IsReady();
+  }
+
+  bool PlaySound(const std::string& soundName, float fadeTime = 0.0f)
   {
     if (!system)
     {
@@ -118,10 +329,39 @@ public:
       return false;
     }
 
-    return soundMapIt->second->Play();
+    return soundMapIt->second->Play(fadeTime);
   }
 
-  bool StopSound(const std::string& soundName)
+  // Play a sound at a time of the audio clock (GetOutputTime)
+  bool PlaySoundAt(const std::string& soundName, double time, float fadeTime = 0.0f)
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    auto soundMapIt = soundMap.find(soundName);
+    if (soundMapIt == soundMap.end())
+    {
+      printf("Failed to play sound %s. Error: Sound not loaded.", soundName.c_str());
+      return false;
+    }
+
+    return soundMapIt->second->PlayAt(time, fadeTime);
+  }
+
+  // Play a sound the given seconds after a sound played now would be heard
+  bool PlaySoundDelayed(const std::string& soundName, float delay)
+  {
+    return system && PlaySoundAt(soundName, system->GetOutputTime() + double(std::max(delay, 0.0f)));
+  }
+
+  double GetOutputTime() const
+  {
+    return system ? system->GetOutputTime() : 0.0;
+  }
+
+  bool StopSound(const std::string& soundName, float fadeTime = 0.0f)
   {
     if (!system)
     {
@@ -135,10 +375,10 @@ public:
       return false;
     }
 
-    return soundMapIt->second->Stop();
+    return soundMapIt->second->Stop(fadeTime);
   }
 
-  bool PauseSound(const std::string& soundName, bool pause)
+  bool PauseSound(const std::string& soundName, bool pause, float fadeTime = 0.0f)
   {
     if (!system)
     {
@@ -152,7 +392,7 @@ public:
       return false;
     }
 
-    return soundMapIt->second->Pause(pause);
+    return soundMapIt->second->Pause(pause, fadeTime);
   }
 
   bool SetSoundVolume(const std::string& soundName, float volume)
@@ -192,8 +432,280 @@ public:
     return soundMapIt->second->SetPitch(pitch);
   }
 
+  // Create a bus nested in the given parent bus ("" = master bus)
+  bool CreateBus(const std::string& busName, const std::string& parentBusName = "")
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    if (busMap.find(busName) != busMap.end())
+    {
+      // bus already created
+      return true;
+    }
+
+    IAudioSystemBus* parentBus = nullptr;
+    if (!parentBusName.empty())
+    {
+      parentBus = GetBus(parentBusName);
+      if (!parentBus)
+      {
+        printf("Failed to create bus %s. Error: Parent bus %s not created.\n", busName.c_str(), parentBusName.c_str());
+        return false;
+      }
+    }
+
+    if (auto bus = system->CreateBus(busName, parentBus))
+    {
+      busMap.insert(std::make_pair(busName, bus));
+      return true;
+    }
+
+    return false;
+  }
+
+  bool SetBusVolume(const std::string& busName, float volume)
+  {
+    IAudioSystemBus* bus = GetBus(busName);
+    if (!bus)
+    {
+      printf("Failed to set volume for bus %s. Error: Bus not created.\n", busName.c_str());
+      return false;
+    }
+
+    if (volume > 1.0f) volume = 1.0f;
+    if (volume < 0.0f) volume = 0.0f;
+
+    return bus->SetVolume(volume);
+  }
+
+  bool PauseBus(const std::string& busName, bool pause)
+  {
+    IAudioSystemBus* bus = GetBus(busName);
+    if (!bus)
+    {
+      printf("Failed to %s bus %s. Error: Bus not created.\n", pause ? "pause" : "resume", busName.c_str());
+      return false;
+    }
+
+    return bus->SetPaused(pause);
+  }
+
+  bool MuteBus(const std::string& busName, bool mute)
+  {
+    IAudioSystemBus* bus = GetBus(busName);
+    if (!bus)
+    {
+      printf("Failed to %s bus %s. Error: Bus not created.\n", mute ? "mute" : "unmute", busName.c_str());
+      return false;
+    }
+
+    return bus->SetMuted(mute);
+  }
+
+  // Duck a bus by the level of the sidechain bus ("" = no ducking)
+  bool SetBusDucking(const std::string& busName, const std::string& sidechainBusName, const AudioSystemDucking& ducking)
+  {
+    IAudioSystemBus* bus = GetBus(busName);
+    if (!bus)
+    {
+      printf("Failed to set ducking for bus %s. Error: Bus not created.\n", busName.c_str());
+      return false;
+    }
+
+    IAudioSystemBus* sidechainBus = nullptr;
+    if (!sidechainBusName.empty())
+    {
+      sidechainBus = GetBus(sidechainBusName);
+      if (!sidechainBus || sidechainBus == bus)
+      {
+        printf("Failed to set ducking for bus %s. Error: Sidechain bus %s not valid.\n", busName.c_str(), sidechainBusName.c_str());
+        return false;
+      }
+    }
+
+    return bus->SetDucking(sidechainBus, ducking);
+  }
+
+  // Route a sound to a bus ("" = master bus)
+  bool SetSoundBus(const std::string& soundName, const std::string& busName)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set bus for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    IAudioSystemBus* bus = nullptr;
+    if (!busName.empty())
+    {
+      bus = GetBus(busName);
+      if (!bus)
+      {
+        printf("Failed to set bus for sound %s. Error: Bus %s not created.\n", soundName.c_str(), busName.c_str());
+        return false;
+      }
+    }
+
+    return sound->SetBus(bus);
+  }
+
+  // Emitter placing a sound in the world. Its 3D attributes are sent to the system on the next update.
+  AudioSystemEmitterHandle AddEmitter(const std::string& soundName)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    return sound ? emitters.Add(sound) : AudioSystemEmitterHandle();
+  }
+
+  // Ignored once the sound of the emitter is unloaded
+  void SetEmitter3DAttributes(const AudioSystemEmitterHandle& emitter, const AudioSystemVector& position, const AudioSystemVector& velocity)
+  {
+    emitters.Set(emitter, position, velocity);
+  }
+
+  // Scene geometry occluding the emitters, when occlusion is enabled
+  void AddOcclusionBox(const AudioSystemOcclusionBox& box)
+  {
+    occlusion.AddBox(box);
+  }
+
+  void ClearOcclusionBoxes()
+  {
+    occlusion.ClearBoxes();
+  }
+
+  // Room the listener is in, for the early reflections
+  void SetRoom(const AudioSystemRoom& room)
+  {
+    if (system)
+    {
+      system->SetRoom(room);
+    }
+  }
+
+  bool SetSoundLoop(const std::string& soundName, const AudioSystemLoop& loop)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set loop for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    return sound->SetLoop(loop);
+  }
+
+  bool SetSoundMarkers(const std::string& soundName, const std::vector<float>& times)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set markers for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    return sound->SetMarkers(times);
+  }
+
+  // Callback of the events of a sound (null = none). It is called on the game thread, during Update.
+  bool SetSoundCallback(const std::string& soundName, const SoundCallback& callback)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set callback for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    if (callback)
+    {
+      soundCallbacks[sound] = SoundCallbackEntry{ soundName, callback };
+    }
+    else
+    {
+      soundCallbacks.erase(sound);
+    }
+
+    return true;
+  }
+
+  bool SetSoundFilter(const std::string& soundName, const AudioSystemFilter& filter)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set filter for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    return sound->SetFilter(filter);
+  }
+
+  // Shared reverb the sounds are sent to
+  void SetReverb(const AudioSystemReverb& reverb)
+  {
+    if (system)
+    {
+      system->SetReverb(reverb);
+    }
+  }
+
+  // Measured impulse response the reverb convolves the sends with ("" = algorithmic reverb)
+  bool SetReverbImpulseResponse(const std::string& impulseResponseName)
+  {
+    if (!system)
+    {
+      return false;
+    }
+
+    std::string impulseResponsePath = impulseResponseName.empty() ? impulseResponseName : audioAssetsPath + impulseResponseName;
+    if (!system->SetReverbImpulseResponse(impulseResponsePath))
+    {
+      printf("Failed to set reverb impulse response %s\n", impulseResponsePath.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool SetSoundReverbSend(const std::string& soundName, float level)
+  {
+    IAudioSystemSound* sound = GetSound(soundName);
+    if (!sound)
+    {
+      printf("Failed to set reverb send for sound %s. Error: Sound not loaded.\n", soundName.c_str());
+      return false;
+    }
+
+    return sound->SetReverbSend(level);
+  }
+
+  // Compressor and limiter of the master bus
+  void SetMasterDynamics(const AudioSystemMasterDynamics& dynamics)
+  {
+    if (system)
+    {
+      system->SetMasterDynamics(dynamics);
+    }
+  }
+
+  bool GetMemoryStats(AudioSystemMemoryStats& outStats) const
+  {
+    return system && system->GetMemoryStats(outStats);
+  }
+
+  bool GetFileStats(AudioSystemFileStats& outStats) const
+  {
+    return system && system->GetFileStats(outStats);
+  }
+
   void SetListener(const AudioSystemVector& position, const AudioSystemVector& velocity, const AudioSystemVector& forward, const AudioSystemVector& up)
   {
+    listenerPosition = position;
+
     if (system)
     {
       system->SetListener(position, velocity, forward, up);
@@ -202,21 +714,82 @@ public:
 
 private:
 
+  // Create a sound from the mounted banks or from its loose file. Safe to call from the loading threads.
+  IAudioSystemSound* NewSound(const std::string& soundName, AudioSystemSoundMode soundMode, const AudioSystemSoundBank*& outSoundBank) const
+  {
+    AudioSystemSoundData soundData;
+    outSoundBank = system->FindBankSound(soundName, soundData);
+    if (outSoundBank)
+    {
+      return system->LoadSoundFromMemory(soundData, soundMode);
+    }
+
+    return system->LoadSound(audioAssetsPath + soundName, soundMode);
+  }
+
+  // Deliver the events raised since the last update to the callbacks of their sounds
+  void DispatchSoundEvents()
+  {
+    IAudioSystemSound* sound = nullptr;
+    AudioSystemSoundEvent event;
+    while (system->PollSoundEvent(sound, event))
+    {
+      auto callbackIt = soundCallbacks.find(sound);
+      if (callbackIt != soundCallbacks.end())
+      {
+        // copied, as the callback may unload the sound
+        SoundCallbackEntry entry = callbackIt->second;
+        entry.callback(entry.soundName, event);
+      }
+    }
+  }
+
   IAudioSystemSound* GetSound(const std::string& soundName)
   {
     auto soundMapIt = soundMap.find(soundName);
     return soundMapIt != soundMap.end() ? soundMapIt->second : nullptr;
   }
 
+  IAudioSystemBus* GetBus(const std::string& busName)
+  {
+    auto busMapIt = busMap.find(busName);
+    return busMapIt != busMap.end() ? busMapIt->second : nullptr;
+  }
+
 private:
 
   std::string audioAssetsPath;
 
+  size_t maxLoadThreads{ 0 };
+
   std::unique_ptr<IAudioSystem> system;
 
   using SoundMap = std::map<std::string, IAudioSystemSound*>;
   SoundMap soundMap;
 
+  // callbacks of the sound events
+  struct SoundCallbackEntry
+  {
+    std::string soundName;
+    SoundCallback callback;
+  };
+
+  std::map<IAudioSystemSound*, SoundCallbackEntry> soundCallbacks;
+
+  // mounted sound banks and the sounds loaded from them
+  using SoundBankMap = std::map<std::string, const AudioSystemSoundBank*>;
+  SoundBankMap soundBankMap;
+  SoundBankMap bankSoundMap;
+
+  // buses, owned by the system
+  using BusMap = std::map<std::string, IAudioSystemBus*>;
+  BusMap busMap;
+
+  AudioSystemEmitters emitters;
+
+  AudioSystemOcclusion occlusion;
+  AudioSystemVector listenerPosition{ 0.0f, 0.0f, 0.0f };
+
   friend class AudioManager;
 };
 
@@ -1,26 +1,88 @@
 #ifndef AUDIO_SYSTEM_COMMON_H
 #define AUDIO_SYSTEM_COMMON_H
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "AudioSystemDefines.h"
+#include "AudioSystemSoundBank.h"
+
+// Interface for AudioSystemBus: a group of sounds mixed together, nested in a parent bus
+class IAudioSystemBus
+{
+public:
+
+  virtual ~IAudioSystemBus() = default;
+
+  virtual bool SetVolume(float volume) = 0;
+  virtual bool SetPaused(bool paused) = 0;
+  virtual bool SetMuted(bool muted) = 0;
+
+  // ducked by the level of the sidechain bus (null sidechain bus = no ducking)
+  virtual bool SetDucking(IAudioSystemBus* sidechainBus, const AudioSystemDucking& ducking) = 0;
+};
 
 // Interface for AudioSystemSound
 class IAudioSystemSound
 {
 public:
 
-  virtual bool Play() = 0;
-  virtual bool Stop() = 0;
-  virtual bool Pause(bool pause) = 0;
+  virtual ~IAudioSystemSound() = default;
+
+  // fadeTime: seconds the volume is ramped in or out, so the sound does not click (0 = at once).
+  // Stopped and paused sounds are only stopped or paused once faded out.
+  virtual bool Play(float fadeTime) = 0;
+
+  // start at the given time of the audio clock (IAudioSystem::GetOutputTime), to the sample. Past times start at once.
+  virtual bool PlayAt(double time, float fadeTime) = 0;
+
+  virtual bool Stop(float fadeTime) = 0;
+  virtual bool Pause(bool pause, float fadeTime) = 0;
   virtual bool Release() = 0;
 
+  // false while a nonblocking load is in progress or when it failed
+  virtual bool IsReady() = 0;
+
   virtual bool SetVolume(float volume) = 0;
   virtual bool SetPitch(float pitch) = 0;
 
+  // null bus = master bus
+  virtual bool SetBus(IAudioSystemBus* bus) = 0;
+
   virtual void Set3DAttributes(const AudioSystemVector& position, const AudioSystemVector& velocity) = 0;
   virtual void Set3DMinMaxDistance(float minDistance, float maxDistance) = 0;
+  virtual void Set3DRolloff(const AudioSystemRolloff& rolloff) = 0;
+
+  // occlusion by the scene geometry: gain and low-pass cutoff in Hz
+  virtual void Set3DOcclusion(float gain, float lowPassCutoff) = 0;
+
+  virtual bool SetLoop(const AudioSystemLoop& loop) = 0;
+
+  // times in seconds of the sound that raise AudioSystemSoundEventType::MARKER when played
+  virtual bool SetMarkers(const std::vector<float>& times) = 0;
+
+  virtual bool SetFilter(const AudioSystemFilter& filter) = 0;
+
+  // level the sound is sent to the shared reverb with (0 = dry)
+  virtual bool SetReverbSend(float level) = 0;
+};
+
+// 3D attributes of a batch of sounds, in SoA layout
+struct AudioSystemEmitterBatch
+{
+  size_t numEmitters{ 0 };
+  IAudioSystemSound* const* sounds{ nullptr };
+
+  const float* positionX{ nullptr };
+  const float* positionY{ nullptr };
+  const float* positionZ{ nullptr };
+
+  const float* velocityX{ nullptr };
+  const float* velocityY{ nullptr };
+  const float* velocityZ{ nullptr };
 };
 
 // AudioSystemListener
@@ -52,22 +114,149 @@ class IAudioSystem
 {
 public:
 
-	virtual void Initialise() = 0;
+	virtual ~IAudioSystem() = default;
+
+	virtual void Initialise(const AudioSystemConfig& config) = 0;
 	virtual void Deinitialise() = 0;
 
 	virtual void Update() = 0;
 
+	// audio clock in seconds: time at which a sound played now is heard. Sounds are scheduled against it.
+	virtual double GetOutputTime() const = 0;
+
+	// Next event raised by the sounds since the last call, on the game thread. False when there are no more.
+	virtual bool PollSoundEvent(IAudioSystemSound*&, AudioSystemSoundEvent&) { return false; }
+
   virtual IAudioSystemSound* LoadSound(const std::string& soundName, AudioSystemSoundMode audioSystemSoundMode) = 0;
+  virtual IAudioSystemSound* LoadSoundFromMemory(const AudioSystemSoundData& soundData, AudioSystemSoundMode audioSystemSoundMode) = 0;
   virtual bool UnloadSound(IAudioSystemSound* audioSystemSound) = 0;
 
+	// 3D attributes of the sounds moved since the last update, sent once before each update
+	virtual void Set3DAttributes(const AudioSystemEmitterBatch& batch)
+	{
+		for (size_t i = 0; i < batch.numEmitters; i++)
+		{
+			AudioSystemVector position{ batch.positionX[i], batch.positionY[i], batch.positionZ[i] };
+			AudioSystemVector velocity{ batch.velocityX[i], batch.velocityY[i], batch.velocityZ[i] };
+			batch.sounds[i]->Set3DAttributes(position, velocity);
+		}
+	}
+
+	// Room the listener is in, for the early reflections. Backends without them ignore it.
+	virtual void SetRoom(const AudioSystemRoom& room) {}
+
+	// Shared reverb the sounds are sent to with their reverb send level
+	virtual void SetReverb(const AudioSystemReverb& reverb) {}
+
+	// Measured impulse response (WAV file) the shared reverb convolves the sends with ("" = algorithmic reverb).
+	// Backends without convolution return false.
+	virtual bool SetReverbImpulseResponse(const std::string& impulseResponsePath) { return false; }
+
+	// Compressor and limiter of the master bus. Backends without them ignore it.
+	virtual void SetMasterDynamics(const AudioSystemMasterDynamics& dynamics) {}
+
+	// Buses. They live until the system is deinitialised. Null parent bus = master bus.
+	virtual IAudioSystemBus* CreateBus(const std::string& busName, IAudioSystemBus* parentBus) = 0;
+
+	// Stats, when the backend keeps them
+	virtual bool GetMemoryStats(AudioSystemMemoryStats& outStats) const { return false; }
+	virtual bool GetFileStats(AudioSystemFileStats& outStats) const { return false; }
+
 	void SetListener(const AudioSystemVector& position, const AudioSystemVector& velocity, const AudioSystemVector& forward, const AudioSystemVector& up)
 	{
 		listener.Set(position, velocity, forward, up);
 	}
 
+	// Sound banks. The backend threads (e.g. FMOD file callbacks) may look for sounds while the game mounts banks.
+
+	const AudioSystemSoundBank* MountSoundBank(const std::string& bankPath)
+	{
+		std::unique_ptr<AudioSystemSoundBank> soundBank = std::make_unique<AudioSystemSoundBank>();
+		if (!soundBank->Mount(bankPath))
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(soundBanksMutex);
+		soundBanks.push_back(std::move(soundBank));
+		return soundBanks.back().get();
+	}
+
+	// A bank whose data is still read (see AcquireBankSound) is not unmounted
+	bool UnmountSoundBank(const AudioSystemSoundBank* soundBank)
+	{
+		std::lock_guard<std::mutex> lock(soundBanksMutex);
+		if (soundBankUsers.find(soundBank) != soundBankUsers.end())
+		{
+			printf("Failed to unmount sound bank %s. Error: Its data is still read.\n", soundBank->GetPath().c_str());
+			return false;
+		}
+
+		for (auto it = soundBanks.begin(); it != soundBanks.end(); ++it)
+		{
+			if (it->get() == soundBank)
+			{
+				soundBanks.erase(it);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Find a sound in the mounted banks. The last mounted bank has priority.
+	const AudioSystemSoundBank* FindBankSound(const std::string& soundName, AudioSystemSoundData& outSoundData) const
+	{
+		std::lock_guard<std::mutex> lock(soundBanksMutex);
+		return FindMountedBankSound(soundName, outSoundData);
+	}
+
+	// Find a sound in the mounted banks and keep its bank mounted until ReleaseBankSound (e.g. while a backend file reads it)
+	const AudioSystemSoundBank* AcquireBankSound(const std::string& soundName, AudioSystemSoundData& outSoundData) const
+	{
+		std::lock_guard<std::mutex> lock(soundBanksMutex);
+		const AudioSystemSoundBank* soundBank = FindMountedBankSound(soundName, outSoundData);
+		if (soundBank)
+		{
+			soundBankUsers[soundBank]++;
+		}
+
+		return soundBank;
+	}
+
+	void ReleaseBankSound(const AudioSystemSoundBank* soundBank) const
+	{
+		std::lock_guard<std::mutex> lock(soundBanksMutex);
+		auto soundBankUsersIt = soundBankUsers.find(soundBank);
+		if (soundBankUsersIt != soundBankUsers.end() && --soundBankUsersIt->second == 0)
+		{
+			soundBankUsers.erase(soundBankUsersIt);
+		}
+	}
+
 protected:
 
 	AudioSystemListener listener;
+
+	std::vector<std::unique_ptr<AudioSystemSoundBank>> soundBanks;
+	mutable std::map<const AudioSystemSoundBank*, size_t> soundBankUsers;
+	mutable std::mutex soundBanksMutex;
+
+private:
+
+	// Note: soundBanksMutex must be locked
+	const AudioSystemSoundBank* FindMountedBankSound(const std::string& soundName, AudioSystemSoundData& outSoundData) const
+	{
+		for (auto it = soundBanks.rbegin(); it != soundBanks.rend(); ++it)
+		{
+			if ((*it)->Find(soundName, outSoundData))
+			{
+				return it->get();
+			}
+		}
+
+		return nullptr;
+	}
 };
 
 #endif // !AUDIO_SYSTEM_IMPL_H
@@ -1,14 +1,224 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 typedef size_t AudioSystemSoundMode;
 
-#define AudioSystemSoundMode_DEFAULT 0x00000000
-#define AudioSystemSoundMode_2D      0x00000001
-#define AudioSystemSoundMode_3D      0x00000002
+#define AudioSystemSoundMode_DEFAULT     0x00000000
+#define AudioSystemSoundMode_2D          0x00000001
+#define AudioSystemSoundMode_3D          0x00000002
+#define AudioSystemSoundMode_STREAM      0x00000004 // decode from disk while playing instead of loading the whole sound
+#define AudioSystemSoundMode_COMPRESSED  0x00000008 // keep the sound compressed in memory and decode it while playing
+#define AudioSystemSoundMode_NONBLOCKING 0x00000010 // load in the background. Playing it before it is ready starts it once loaded.
+#define AudioSystemSoundMode_LOOP        0x00000020
+
+// Speakers of the output
+enum class AudioSystemSpeakerMode
+{
+	MONO,
+	STEREO,
+	QUAD,
+	SURROUND_5_1,
+	SURROUND_7_1
+};
+
+// Occlusion of the 3D sounds by the scene geometry
+struct AudioSystemOcclusionConfig
+{
+	bool enabled{ false };
+	size_t raysPerUpdate{ 256 }; // emitters whose ray is cast each update, the others keep their last occlusion
+	size_t raysPerJob{ 64 };     // rays cast by each worker job
+	size_t maxThreads{ 0 };      // worker threads casting the rays (0 = one per hardware thread)
+
+	// gain and low-pass cutoff from a clear path to a fully occluded one
+	float minGain{ 0.3f };
+	float minLowPassCutoff{ 800.0f };
+	float maxLowPassCutoff{ 22000.0f };
+};
+
+// Dynamics of the master bus, before the output: an optional compressor, then a brickwall limiter
+struct AudioSystemMasterDynamics
+{
+	bool compressor{ false };
+	float threshold{ -12.0f }; // dB where the compression starts
+	float ratio{ 4.0f };       // dB in per dB out over the threshold
+	float knee{ 6.0f };        // dB around the threshold where the ratio grows smoothly (0 = hard knee)
+	float attack{ 0.005f };    // seconds
+	float release{ 0.15f };    // seconds
+	float makeupGain{ 0.0f };  // dB
+
+	bool limiter{ true };
+	float ceiling{ -0.3f };        // dB the output never goes over
+	float limiterRelease{ 0.1f }; // seconds
+};
+
+// Audio system settings
+struct AudioSystemConfig
+{
+	int maxChannels{ 512 };          // channels that can play at once, real or virtual
+	int maxSoftwareChannels{ 64 };   // channels actually mixed. The quietest ones become virtual.
+	bool vol0BecomesVirtual{ true }; // silent channels become virtual and cost nothing to mix
+	float virtualVolume{ 0.0f };     // volume below which a channel is silent (0 = backend default)
+
+	// backend allocations: from a fixed arena, or from the heap keeping count of them
+	void* memoryPool{ nullptr };
+	size_t memoryPoolSize{ 0 };
+	bool trackMemory{ false };
+
+	// backend file reads are served from the mounted sound banks, or from disk
+	bool bankFileSystem{ false };
+
+	// path the sound names are relative to, set by AudioSystem to its audio assets path
+	std::string assetsPath;
+
+	// 3D coordinates: left-handed by default (+X right, +Y up, +Z forward)
+	bool rightHanded{ false };
+
+	// Doppler shift of the moving sounds and listener (0 = no Doppler)
+	float dopplerScale{ 1.0f };
+	float speedOfSound{ 343.0f }; // in units per second
+
+	// binaural rendering for headphones: HRIR set file and number of voices rendered with it (TxikiAudio only)
+	std::string hrtfPath;
+	size_t maxHRTFVoices{ 16 };
+
+	// 3D sounds mixed in an ambisonic bus of this order (1 to 3) and decoded once, 0 = spatialised one by one (TxikiAudio only)
+	size_t ambisonicOrder{ 0 };
+
+	// output speakers. Falls back to stereo when the device does not support them.
+	AudioSystemSpeakerMode speakerMode{ AudioSystemSpeakerMode::STEREO };
+
+	AudioSystemOcclusionConfig occlusion;
+
+	AudioSystemMasterDynamics masterDynamics;
+};
+
+// Memory used by the backend
+struct AudioSystemMemoryStats
+{
+	size_t currentBytes{ 0 };
+	size_t peakBytes{ 0 };
+	size_t numAllocations{ 0 };
+};
+
+// Files read by the backend
+struct AudioSystemFileStats
+{
+	size_t numBankFilesOpened{ 0 };
+	size_t numDiskFilesOpened{ 0 };
+	size_t bankBytesRead{ 0 };
+	size_t diskBytesRead{ 0 };
+};
 
 struct AudioSystemVector
 {
 	float x;
 	float y;
 	float z;
-};
\ No newline at end of file
+};
+
+// Box of the scene geometry occluding the sounds
+struct AudioSystemOcclusionBox
+{
+	AudioSystemVector center{ 0.0f, 0.0f, 0.0f };
+	AudioSystemVector halfExtents{ 1.0f, 1.0f, 1.0f };
+	AudioSystemVector rotation{ 0.0f, 0.0f, 0.0f }; // euler angles in radians, applied in x, y, z order
+	float occlusion{ 1.0f };                        // of a ray crossing the box (0 = transparent, 1 = blocks the sound)
+};
+
+// Wall of a convex room, facing inwards: the room is where dot(normal, p) >= offset
+struct AudioSystemRoomWall
+{
+	AudioSystemVector normal{ 0.0f, 1.0f, 0.0f };
+	float offset{ 0.0f };
+	float reflection{ 0.8f }; // gain of a reflection on the wall
+};
+
+// Room the listener is in, for the early reflections (TxikiAudio only)
+struct AudioSystemRoom
+{
+	std::vector<AudioSystemRoomWall> walls;
+};
+
+// Looping of a sound, points in seconds (negative = the loop points of the file, or else the start or end of the sound)
+struct AudioSystemLoop
+{
+	bool enabled{ true };
+	float start{ -1.0f };
+	float end{ -1.0f };
+	float crossfade{ 0.0f }; // seconds the end of the loop fades into the sound before its start, hiding the seam (into the start of the loop if there is not enough sound before it)
+};
+
+// Event raised by a sound, delivered on the game thread
+enum class AudioSystemSoundEventType
+{
+	FINISHED, // reached its end, or stopped at the end of a fade out
+	LOOPED,   // went back to the start of its loop
+	MARKER    // reached one of its markers
+};
+
+struct AudioSystemSoundEvent
+{
+	AudioSystemSoundEventType type{ AudioSystemSoundEventType::FINISHED };
+	size_t marker{ 0 }; // index of the marker reached, in time order
+};
+
+// Filter of a sound (e.g. muffled or underwater), cutoffs in Hz
+struct AudioSystemFilter
+{
+	float lowPassCutoff{ 22000.0f }; // 22000 = no low-pass
+	float highPassCutoff{ 10.0f };   // 10 = no high-pass
+};
+
+// Reverb shared by the sounds sent to it
+struct AudioSystemReverb
+{
+	float decayTime{ 1.5f }; // seconds for the tail to fall 60 dB
+	float damping{ 0.5f };   // how much faster the high frequencies decay (0 = as fast as the rest, 1 = much faster)
+	float preDelay{ 0.02f }; // seconds before the tail starts
+	float wetLevel{ 1.0f };  // gain of the tail in the mix (0 = off)
+};
+
+// Ducking of a bus by the level of a sidechain bus (e.g. the music under the dialogue)
+struct AudioSystemDucking
+{
+	float threshold{ -40.0f }; // dB of the sidechain bus where the ducking starts. The bus goes 1 dB down per dB over it.
+	float depth{ -12.0f };     // lowest gain in dB the bus is ducked to
+	float attack{ 0.05f };     // seconds to duck
+	float release{ 0.5f };     // seconds to come back up
+};
+
+// Distance attenuation of a 3D sound between its min and max distance
+enum class AudioSystemRolloffType
+{
+	INVERSE, // min distance / distance
+	LINEAR,  // from 1 at min distance to 0 at max distance
+	CUSTOM   // curve of points
+};
+
+struct AudioSystemRolloffPoint
+{
+	float distance;
+	float gain;
+};
+
+struct AudioSystemRolloff
+{
+	AudioSystemRolloffType type{ AudioSystemRolloffType::INVERSE };
+	std::vector<AudioSystemRolloffPoint> curve; // CUSTOM only: points sorted by distance
+};
+
+// Sound samples already in memory (e.g. a sound from a mounted sound bank)
+struct AudioSystemSoundData
+{
+	const short* samples{ nullptr }; // interleaved PCM16
+	size_t numSamples{ 0 };          // all channels included
+	size_t numChannels{ 0 };
+	size_t sampleRate{ 0 };
+
+	const uint16_t* peaks{ nullptr }; // optional max absolute sample value per block of frames
+	size_t numPeaks{ 0 };
+};
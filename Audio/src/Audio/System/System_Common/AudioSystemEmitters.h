@@ -0,0 +1,238 @@
+#ifndef AUDIO_SYSTEM_EMITTERS_H
+#define AUDIO_SYSTEM_EMITTERS_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "AudioSystemCommon.h"
+
+// Handle to an emitter. A freed emitter is reused by other sounds: the generation tells the old handles apart.
+struct AudioSystemEmitterHandle
+{
+  static const size_t INVALID_INDEX = size_t(-1);
+
+  size_t index{ INVALID_INDEX };
+  uint32_t generation{ 0 };
+};
+
+// AudioSystemEmitters
+//
+// 3D attributes of the sounds placed in the world, in SoA layout with a dirty bit per emitter.
+// Moving an emitter only writes the buffer: the moved emitters are sent to the backend in one batch per update.
+class AudioSystemEmitters
+{
+public:
+
+  // Emitter of the sound, created on first use
+  AudioSystemEmitterHandle Add(IAudioSystemSound* sound)
+  {
+    auto emitterMapIt = emitterMap.find(sound);
+    if (emitterMapIt != emitterMap.end())
+    {
+      return GetHandle(emitterMapIt->second);
+    }
+
+    size_t emitter;
+    if (!freeEmitters.empty())
+    {
+      emitter = freeEmitters.back();
+      freeEmitters.pop_back();
+    }
+    else
+    {
+      emitter = sounds.size();
+      Resize(emitter + 1);
+    }
+
+    sounds[emitter] = sound;
+    emitterMap.insert(std::make_pair(sound, emitter));
+
+    return GetHandle(emitter);
+  }
+
+  void Remove(IAudioSystemSound* sound)
+  {
+    auto emitterMapIt = emitterMap.find(sound);
+    if (emitterMapIt == emitterMap.end())
+    {
+      return;
+    }
+
+    size_t emitter = emitterMapIt->second;
+    sounds[emitter] = nullptr;
+    generations[emitter]++;
+    ClearDirty(emitter);
+    freeEmitters.push_back(emitter);
+
+    emitterMap.erase(emitterMapIt);
+  }
+
+  // Handles of removed emitters are ignored, even once their emitter is reused
+  void Set(const AudioSystemEmitterHandle& handle, const AudioSystemVector& position, const AudioSystemVector& velocity)
+  {
+    size_t emitter = handle.index;
+    if (emitter >= sounds.size() || !sounds[emitter] || generations[emitter] != handle.generation)
+    {
+      return;
+    }
+
+    positionX[emitter] = position.x;
+    positionY[emitter] = position.y;
+    positionZ[emitter] = position.z;
+    velocityX[emitter] = velocity.x;
+    velocityY[emitter] = velocity.y;
+    velocityZ[emitter] = velocity.z;
+
+    dirtyBits[emitter >> 6] |= uint64_t(1) << (emitter & 63);
+  }
+
+  // Gather the emitters moved since the last flush into a contiguous batch
+  bool Flush(AudioSystemEmitterBatch& outBatch)
+  {
+    batch.Clear();
+
+    for (size_t word = 0; word < dirtyBits.size(); word++)
+    {
+      uint64_t bits = dirtyBits[word];
+      dirtyBits[word] = 0;
+
+      // visit the set bits only: most emitters do not move every frame
+      while (bits)
+      {
+        size_t bit = LowestBit(bits);
+        bits &= bits - 1;
+
+        size_t emitter = (word << 6) + bit;
+        batch.sounds.push_back(sounds[emitter]);
+        batch.positionX.push_back(positionX[emitter]);
+        batch.positionY.push_back(positionY[emitter]);
+        batch.positionZ.push_back(positionZ[emitter]);
+        batch.velocityX.push_back(velocityX[emitter]);
+        batch.velocityY.push_back(velocityY[emitter]);
+        batch.velocityZ.push_back(velocityZ[emitter]);
+      }
+    }
+
+    outBatch.numEmitters = batch.sounds.size();
+    outBatch.sounds = batch.sounds.data();
+    outBatch.positionX = batch.positionX.data();
+    outBatch.positionY = batch.positionY.data();
+    outBatch.positionZ = batch.positionZ.data();
+    outBatch.velocityX = batch.velocityX.data();
+    outBatch.velocityY = batch.velocityY.data();
+    outBatch.velocityZ = batch.velocityZ.data();
+
+    return outBatch.numEmitters > 0;
+  }
+
+  size_t Size() const { return sounds.size(); }
+
+  // null for the free emitters
+  IAudioSystemSound* GetSound(size_t emitter) const { return sounds[emitter]; }
+
+  AudioSystemVector GetPosition(size_t emitter) const
+  {
+    return { positionX[emitter], positionY[emitter], positionZ[emitter] };
+  }
+
+  void Clear()
+  {
+    Resize(0);
+    dirtyBits.clear();
+    freeEmitters.clear();
+    emitterMap.clear();
+
+    // the generations are kept, so the handles given before stay invalid once their emitters are reused
+    for (auto& generation : generations)
+    {
+      generation++;
+    }
+  }
+
+private:
+
+  AudioSystemEmitterHandle GetHandle(size_t emitter) const
+  {
+    AudioSystemEmitterHandle handle;
+    handle.index = emitter;
+    handle.generation = generations[emitter];
+    return handle;
+  }
+
+  void Resize(size_t numEmitters)
+  {
+    sounds.resize(numEmitters, nullptr);
+    positionX.resize(numEmitters, 0.0f);
+    positionY.resize(numEmitters, 0.0f);
+    positionZ.resize(numEmitters, 0.0f);
+    velocityX.resize(numEmitters, 0.0f);
+    velocityY.resize(numEmitters, 0.0f);
+    velocityZ.resize(numEmitters, 0.0f);
+
+    dirtyBits.resize((numEmitters + 63) / 64, 0);
+
+    if (generations.size() < numEmitters)
+    {
+      generations.resize(numEmitters, 0);
+    }
+  }
+
+  void ClearDirty(size_t emitter)
+  {
+    dirtyBits[emitter >> 6] &= ~(uint64_t(1) << (emitter & 63));
+  }
+
+  static size_t LowestBit(uint64_t bits)
+  {
+    size_t bit = 0;
+    while (!(bits & 1))
+    {
+      bits >>= 1;
+      bit++;
+    }
+
+    return bit;
+  }
+
+  // emitters
+  std::vector<IAudioSystemSound*> sounds;
+  std::vector<float> positionX;
+  std::vector<float> positionY;
+  std::vector<float> positionZ;
+  std::vector<float> velocityX;
+  std::vector<float> velocityY;
+  std::vector<float> velocityZ;
+  std::vector<uint32_t> generations; // incremented when the emitter is removed
+
+  std::vector<uint64_t> dirtyBits;
+  std::vector<size_t> freeEmitters;
+  std::map<IAudioSystemSound*, size_t> emitterMap;
+
+  // emitters moved, sent to the backend
+  struct Batch
+  {
+    std::vector<IAudioSystemSound*> sounds;
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+
+    void Clear()
+    {
+      sounds.clear();
+      positionX.clear();
+      positionY.clear();
+      positionZ.clear();
+      velocityX.clear();
+      velocityY.clear();
+      velocityZ.clear();
+    }
+  };
+
+  Batch batch;
+};
+
+#endif // !AUDIO_SYSTEM_EMITTERS_H
@@ -0,0 +1,142 @@
+#ifndef AUDIO_SYSTEM_MAPPED_FILE_H
+#define AUDIO_SYSTEM_MAPPED_FILE_H
+
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// AudioSystemMappedFile
+//
+// Read only memory mapping of a whole file
+class AudioSystemMappedFile
+{
+public:
+
+  AudioSystemMappedFile() = default;
+  AudioSystemMappedFile(const AudioSystemMappedFile&) = delete;
+  AudioSystemMappedFile& operator=(const AudioSystemMappedFile&) = delete;
+
+  ~AudioSystemMappedFile()
+  {
+    Close();
+  }
+
+  bool Open(const std::string& path)
+  {
+    Close();
+
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+      Close();
+      return false;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+      Close();
+      return false;
+    }
+
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+      Close();
+      return false;
+    }
+    size = static_cast<size_t>(fileStat.st_size);
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    data = view != MAP_FAILED ? static_cast<const uint8_t*>(view) : nullptr;
+#endif
+
+    if (!data)
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void Close()
+  {
+#ifdef _WIN32
+    if (data)
+    {
+      UnmapViewOfFile(data);
+    }
+    if (mapping)
+    {
+      CloseHandle(mapping);
+      mapping = nullptr;
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(file);
+      file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data)
+    {
+      munmap(const_cast<uint8_t*>(data), size);
+    }
+    if (fd >= 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+#endif
+
+    data = nullptr;
+    size = 0;
+  }
+
+  const uint8_t* GetData() const { return data; }
+  size_t GetSize() const { return size; }
+
+private:
+
+  const uint8_t* data{ nullptr };
+  size_t size{ 0 };
+
+#ifdef _WIN32
+  HANDLE file{ INVALID_HANDLE_VALUE };
+  HANDLE mapping{ nullptr };
+#else
+  int fd{ -1 };
+#endif
+};
+
+#endif // !AUDIO_SYSTEM_MAPPED_FILE_H
@@ -0,0 +1,405 @@
+#ifndef AUDIO_SYSTEM_OCCLUSION_H
+#define AUDIO_SYSTEM_OCCLUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "AudioSystemCommon.h"
+#include "AudioSystemEmitters.h"
+#include "AudioSystemParallel.h"
+
+// AudioSystemOcclusion
+//
+// Occlusion of the emitters by the scene geometry: boxes kept in a BVH, with a ray cast from the listener to each emitter.
+// The rays are spread over several updates and cast in parallel, so the cost per update is bounded whatever the number of emitters.
+// The occlusion of an emitter is the sum of the occlusion of the boxes its ray crosses, mapped to a gain and a low-pass cutoff.
+class AudioSystemOcclusion
+{
+public:
+
+  void Init(const AudioSystemOcclusionConfig& config_)
+  {
+    config = config_;
+
+    if (config.enabled)
+    {
+      workers.Start(config.maxThreads);
+    }
+  }
+
+  void Deinit()
+  {
+    workers.Stop();
+    ClearBoxes();
+  }
+
+  bool IsEnabled() const { return config.enabled; }
+
+  // Boxes the rays are cast against. The BVH is rebuilt on the next update.
+  size_t AddBox(const AudioSystemOcclusionBox& box)
+  {
+    Box newBox;
+    newBox.center = box.center;
+    newBox.halfExtents = box.halfExtents;
+    newBox.occlusion = box.occlusion;
+
+    // rotation of the box, applied in x, y, z order
+    float cosX = std::cos(box.rotation.x), sinX = std::sin(box.rotation.x);
+    float cosY = std::cos(box.rotation.y), sinY = std::sin(box.rotation.y);
+    float cosZ = std::cos(box.rotation.z), sinZ = std::sin(box.rotation.z);
+    float rotation[3][3] =
+    {
+      { cosZ * cosY, cosZ * sinY * sinX - sinZ * cosX, cosZ * sinY * cosX + sinZ * sinX },
+      { sinZ * cosY, sinZ * sinY * sinX + cosZ * cosX, sinZ * sinY * cosX - cosZ * sinX },
+      { -sinY,       cosY * sinX,                      cosY * cosX }
+    };
+
+    // the box axes are the columns of the rotation
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+      newBox.axes[axis] = { rotation[0][axis], rotation[1][axis], rotation[2][axis] };
+    }
+
+    // world bounds
+    const float halfExtents[3] = { box.halfExtents.x, box.halfExtents.y, box.halfExtents.z };
+    const float center[3] = { box.center.x, box.center.y, box.center.z };
+    for (size_t row = 0; row < 3; row++)
+    {
+      float extent = 0.0f;
+      for (size_t axis = 0; axis < 3; axis++)
+      {
+        extent += std::abs(rotation[row][axis]) * halfExtents[axis];
+      }
+      newBox.bounds.min[row] = center[row] - extent;
+      newBox.bounds.max[row] = center[row] + extent;
+    }
+
+    boxes.push_back(newBox);
+    dirtyBVH = true;
+
+    return boxes.size() - 1;
+  }
+
+  void ClearBoxes()
+  {
+    boxes.clear();
+    dirtyBVH = true;
+  }
+
+  // Cast the rays of the next emitters. The emitters whose occlusion changed are in GetChangedEmitters.
+  void Update(const AudioSystemVector& listenerPosition, const AudioSystemEmitters& emitters)
+  {
+    changedEmitters.clear();
+
+    if (dirtyBVH)
+    {
+      BuildBVH();
+      dirtyBVH = false;
+    }
+
+    size_t numEmitters = emitters.Size();
+    occlusion.resize(numEmitters, 0.0f);
+    castOcclusion.resize(numEmitters, 0.0f);
+    occlusionSounds.resize(numEmitters, nullptr);
+    if (numEmitters == 0)
+    {
+      return;
+    }
+
+    // emitters of this update, round robin
+    size_t numRays = std::min(config.raysPerUpdate, numEmitters);
+    rayEmitters.clear();
+    for (size_t i = 0; i < numRays; i++)
+    {
+      rayEmitters.push_back((nextEmitter + i) % numEmitters);
+    }
+    nextEmitter = (nextEmitter + numRays) % numEmitters;
+
+    // cast in parallel: each job writes the occlusion of its own emitters. A single job is cast on this thread.
+    size_t raysPerJob = std::max(config.raysPerJob, size_t(1));
+    size_t numJobs = (numRays + raysPerJob - 1) / raysPerJob;
+    workers.For(numJobs, [&](size_t job)
+    {
+      size_t end = std::min(numRays, (job + 1) * raysPerJob);
+      for (size_t i = job * raysPerJob; i < end; i++)
+      {
+        size_t emitter = rayEmitters[i];
+        castOcclusion[emitter] = emitters.GetSound(emitter) ? CastRay(listenerPosition, emitters.GetPosition(emitter)) : 0.0f;
+      }
+    });
+
+    for (size_t emitter : rayEmitters)
+    {
+      IAudioSystemSound* sound = emitters.GetSound(emitter);
+      if (!sound)
+      {
+        occlusionSounds[emitter] = nullptr;
+        continue;
+      }
+
+      // a reused emitter gets its occlusion even if it did not change
+      if (std::abs(castOcclusion[emitter] - occlusion[emitter]) > 1e-3f || occlusionSounds[emitter] != sound)
+      {
+        occlusion[emitter] = castOcclusion[emitter];
+        occlusionSounds[emitter] = sound;
+        changedEmitters.push_back(emitter);
+      }
+    }
+  }
+
+  const std::vector<size_t>& GetChangedEmitters() const { return changedEmitters; }
+
+  // occlusion of an emitter, from 0 (clear path) to 1 (fully occluded)
+  float GetOcclusion(size_t emitter) const { return occlusion[emitter]; }
+
+  float GetGain(size_t emitter) const
+  {
+    return 1.0f + (config.minGain - 1.0f) * occlusion[emitter];
+  }
+
+  // interpolated in octaves, which is how the cutoff is heard
+  float GetLowPassCutoff(size_t emitter) const
+  {
+    return config.maxLowPassCutoff * std::pow(config.minLowPassCutoff / config.maxLowPassCutoff, occlusion[emitter]);
+  }
+
+private:
+
+  struct Bounds
+  {
+    float min[3]{ 0.0f, 0.0f, 0.0f };
+    float max[3]{ 0.0f, 0.0f, 0.0f };
+
+    void Grow(const Bounds& bounds)
+    {
+      for (size_t axis = 0; axis < 3; axis++)
+      {
+        min[axis] = std::min(min[axis], bounds.min[axis]);
+        max[axis] = std::max(max[axis], bounds.max[axis]);
+      }
+    }
+  };
+
+  struct Box
+  {
+    Bounds bounds;
+    AudioSystemVector center;
+    AudioSystemVector halfExtents;
+    AudioSystemVector axes[3];
+    float occlusion;
+  };
+
+  // Leaves hold count boxes from first. Inner nodes have count 0 and their children at first and first + 1.
+  struct Node
+  {
+    Bounds bounds;
+    size_t first;
+    size_t count;
+  };
+
+  static const size_t MAX_LEAF_BOXES = 2;
+
+  void BuildBVH()
+  {
+    nodes.clear();
+    boxIndices.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+      boxIndices[i] = i;
+    }
+
+    if (boxes.empty())
+    {
+      return;
+    }
+
+    nodes.push_back(Node());
+    BuildNode(0, 0, boxes.size());
+  }
+
+  // Split at the median of the box centers along the longest axis
+  void BuildNode(size_t node, size_t first, size_t count)
+  {
+    Bounds bounds = boxes[boxIndices[first]].bounds;
+    Bounds centers;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+      centers.min[axis] = centers.max[axis] = GetCenter(boxIndices[first], axis);
+    }
+
+    for (size_t i = first + 1; i < first + count; i++)
+    {
+      bounds.Grow(boxes[boxIndices[i]].bounds);
+      for (size_t axis = 0; axis < 3; axis++)
+      {
+        float center = GetCenter(boxIndices[i], axis);
+        centers.min[axis] = std::min(centers.min[axis], center);
+        centers.max[axis] = std::max(centers.max[axis], center);
+      }
+    }
+
+    nodes[node].bounds = bounds;
+    if (count <= MAX_LEAF_BOXES)
+    {
+      nodes[node].first = first;
+      nodes[node].count = count;
+      return;
+    }
+
+    size_t axis = 0;
+    for (size_t i = 1; i < 3; i++)
+    {
+      if (centers.max[i] - centers.min[i] > centers.max[axis] - centers.min[axis])
+      {
+        axis = i;
+      }
+    }
+
+    size_t half = count / 2;
+    std::nth_element(boxIndices.begin() + first, boxIndices.begin() + first + half, boxIndices.begin() + first + count, [this, axis](size_t a, size_t b)
+    {
+      return GetCenter(a, axis) < GetCenter(b, axis);
+    });
+
+    // children next to each other (Note: nodes grows, so node is accessed by index)
+    size_t children = nodes.size();
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[node].first = children;
+    nodes[node].count = 0;
+
+    BuildNode(children, first, half);
+    BuildNode(children + 1, first + half, count - half);
+  }
+
+  float GetCenter(size_t box, size_t axis) const
+  {
+    return (boxes[box].bounds.min[axis] + boxes[box].bounds.max[axis]) * 0.5f;
+  }
+
+  // Occlusion of the boxes crossed by the segment from the listener to the emitter.
+  // Boxes the listener or the emitter are in do not count: a sound is not occluded by the object playing it.
+  float CastRay(const AudioSystemVector& from, const AudioSystemVector& to) const
+  {
+    if (nodes.empty())
+    {
+      return 0.0f;
+    }
+
+    const float origin[3] = { from.x, from.y, from.z };
+    const float direction[3] = { to.x - from.x, to.y - from.y, to.z - from.z };
+
+    float inverseDirection[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+      inverseDirection[axis] = 1.0f / (std::abs(direction[axis]) > 1e-12f ? direction[axis] : 1e-12f);
+    }
+
+    float totalOcclusion = 0.0f;
+
+    size_t stack[64];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+      const Node& node = nodes[stack[--stackSize]];
+      if (!IntersectBounds(node.bounds, origin, inverseDirection))
+      {
+        continue;
+      }
+
+      if (node.count == 0)
+      {
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = node.first + 1;
+        continue;
+      }
+
+      for (size_t i = node.first; i < node.first + node.count; i++)
+      {
+        const Box& box = boxes[boxIndices[i]];
+        if (CrossesBox(box, from, direction))
+        {
+          totalOcclusion += box.occlusion;
+          if (totalOcclusion >= 1.0f)
+          {
+            return 1.0f;
+          }
+        }
+      }
+    }
+
+    return totalOcclusion;
+  }
+
+  // Slab test of the segment (t in [0, 1]) against world bounds
+  static bool IntersectBounds(const Bounds& bounds, const float* origin, const float* inverseDirection)
+  {
+    float tMin = 0.0f;
+    float tMax = 1.0f;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+      float t1 = (bounds.min[axis] - origin[axis]) * inverseDirection[axis];
+      float t2 = (bounds.max[axis] - origin[axis]) * inverseDirection[axis];
+      tMin = std::max(tMin, std::min(t1, t2));
+      tMax = std::min(tMax, std::max(t1, t2));
+    }
+
+    return tMin <= tMax;
+  }
+
+  // Slab test in the space of the box: the segment must enter and leave it
+  static bool CrossesBox(const Box& box, const AudioSystemVector& from, const float* direction)
+  {
+    const float relative[3] = { from.x - box.center.x, from.y - box.center.y, from.z - box.center.z };
+    const float halfExtents[3] = { box.halfExtents.x, box.halfExtents.y, box.halfExtents.z };
+
+    float tEnter = -1e30f;
+    float tExit = 1e30f;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+      const AudioSystemVector& boxAxis = box.axes[axis];
+      float origin = relative[0] * boxAxis.x + relative[1] * boxAxis.y + relative[2] * boxAxis.z;
+      float speed = direction[0] * boxAxis.x + direction[1] * boxAxis.y + direction[2] * boxAxis.z;
+
+      if (std::abs(speed) < 1e-12f)
+      {
+        // parallel to the slab
+        if (std::abs(origin) > halfExtents[axis])
+        {
+          return false;
+        }
+        continue;
+      }
+
+      float t1 = (-halfExtents[axis] - origin) / speed;
+      float t2 = (halfExtents[axis] - origin) / speed;
+      tEnter = std::max(tEnter, std::min(t1, t2));
+      tExit = std::min(tExit, std::max(t1, t2));
+    }
+
+    return tEnter <= tExit && tEnter > 0.0f && tExit < 1.0f;
+  }
+
+  AudioSystemOcclusionConfig config;
+  AudioSystemWorkers workers;
+
+  // scene geometry
+  std::vector<Box> boxes;
+  std::vector<size_t> boxIndices;
+  std::vector<Node> nodes;
+  bool dirtyBVH{ false };
+
+  // occlusion of each emitter, and the sound it was computed for
+  std::vector<float> occlusion;
+  std::vector<IAudioSystemSound*> occlusionSounds;
+  std::vector<size_t> changedEmitters;
+
+  // rays of an update
+  std::vector<size_t> rayEmitters;
+  std::vector<float> castOcclusion;
+  size_t nextEmitter{ 0 };
+};
+
+#endif // !AUDIO_SYSTEM_OCCLUSION_H
@@ -0,0 +1,229 @@
+#ifndef AUDIO_SYSTEM_PARALLEL_H
+#define AUDIO_SYSTEM_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// AudioSystemParallel
+//
+// Runs a batch of independent jobs across a bounded number of worker threads
+class AudioSystemParallel
+{
+public:
+
+  using Job = std::function<void(size_t jobIndex)>;
+  using Progress = std::function<void(size_t numJobsDone, size_t numJobs)>;
+
+  // number of threads to use for a batch (0 = one per hardware thread)
+  static size_t NumThreads(size_t maxThreads)
+  {
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    if (hardwareThreads == 0)
+    {
+      hardwareThreads = 1;
+    }
+
+    return maxThreads == 0 ? hardwareThreads : std::min(maxThreads, hardwareThreads);
+  }
+
+  // Run job(0) ... job(numJobs - 1) and block until all of them are done.
+  // The progress is reported on the calling thread.
+  static void For(size_t numJobs, size_t maxThreads, const Job& job, const Progress& progress = nullptr)
+  {
+    if (numJobs == 0)
+    {
+      return;
+    }
+
+    size_t numThreads = std::min(NumThreads(maxThreads), numJobs);
+    if (numThreads == 1)
+    {
+      // not worth spawning threads
+      for (size_t i = 0; i < numJobs; i++)
+      {
+        job(i);
+
+        if (progress)
+        {
+          progress(i + 1, numJobs);
+        }
+      }
+      return;
+    }
+
+    std::atomic<size_t> nextJob{ 0 };
+    size_t numJobsDone = 0;
+    std::mutex mutex;
+    std::condition_variable jobDone;
+
+    auto worker = [&]()
+    {
+      for (size_t i = nextJob++; i < numJobs; i = nextJob++)
+      {
+        job(i);
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          numJobsDone++;
+        }
+        jobDone.notify_one();
+      }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; i++)
+    {
+      workers.emplace_back(worker);
+    }
+
+    // wait for the jobs, reporting the progress as they complete
+    size_t numJobsReported = 0;
+    while (numJobsReported < numJobs)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [&]() { return numJobsDone != numJobsReported; });
+        numJobsReported = numJobsDone;
+      }
+
+      if (progress)
+      {
+        progress(numJobsReported, numJobs);
+      }
+    }
+
+    for (auto& w : workers)
+    {
+      w.join();
+    }
+  }
+};
+
+// AudioSystemWorkers
+//
+// Worker threads kept alive between batches, for the jobs run on every update: AudioSystemParallel::For spawns its threads on each call.
+class AudioSystemWorkers
+{
+public:
+
+  ~AudioSystemWorkers()
+  {
+    Stop();
+  }
+
+  // The calling thread of For runs jobs too, so one thread less is spawned
+  void Start(size_t maxThreads)
+  {
+    Stop();
+
+    running = true;
+    size_t numThreads = AudioSystemParallel::NumThreads(maxThreads);
+    for (size_t i = 1; i < numThreads; i++)
+    {
+      threads.emplace_back(&AudioSystemWorkers::Run, this);
+    }
+  }
+
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    wakeUp.notify_all();
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    threads.clear();
+  }
+
+  // Run job(0) ... job(numJobs - 1) and block until all of them are done
+  void For(size_t numJobs_, const AudioSystemParallel::Job& job_)
+  {
+    if (threads.empty() || numJobs_ <= 1)
+    {
+      // not worth waking the workers
+      for (size_t i = 0; i < numJobs_; i++)
+      {
+        job_(i);
+      }
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &job_;
+      numJobs = numJobs_;
+      nextJob = 0;
+      numWorkersDone = 0;
+      batch++;
+    }
+    wakeUp.notify_all();
+
+    RunJobs();
+
+    // every worker is done with the batch before the next one is set
+    std::unique_lock<std::mutex> lock(mutex);
+    batchDone.wait(lock, [this]() { return numWorkersDone == threads.size(); });
+    job = nullptr;
+  }
+
+private:
+
+  void Run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t lastBatch = batch;
+
+    while (true)
+    {
+      wakeUp.wait(lock, [&]() { return !running || batch != lastBatch; });
+      if (!running)
+      {
+        return;
+      }
+      lastBatch = batch;
+
+      lock.unlock();
+      RunJobs();
+      lock.lock();
+
+      if (++numWorkersDone == threads.size())
+      {
+        batchDone.notify_one();
+      }
+    }
+  }
+
+  void RunJobs()
+  {
+    for (size_t i = nextJob++; i < numJobs; i = nextJob++)
+    {
+      (*job)(i);
+    }
+  }
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable batchDone;
+  bool running{ false };
+
+  // batch being run
+  uint64_t batch{ 0 };
+  const AudioSystemParallel::Job* job{ nullptr };
+  size_t numJobs{ 0 };
+  std::atomic<size_t> nextJob{ 0 };
+  size_t numWorkersDone{ 0 };
+};
+
+#endif // !AUDIO_SYSTEM_PARALLEL_H
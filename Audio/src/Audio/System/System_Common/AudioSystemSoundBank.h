@@ -0,0 +1,202 @@
+#ifndef AUDIO_SYSTEM_SOUND_BANK_H
+#define AUDIO_SYSTEM_SOUND_BANK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "AudioSystemDefines.h"
+#include "AudioSystemMappedFile.h"
+
+// Sound bank file layout (little endian):
+//
+//  AudioSystemSoundBankHeader
+//  AudioSystemSoundBankEntry[numEntries]  table of contents, sorted by name hash
+//  names                                  null terminated sound names
+//  payloads                               samples and peaks, each one aligned to AudioSystemSoundBankHeader::ALIGNMENT bytes
+//
+// Samples are already in the mixer native layout: interleaved PCM16 stereo at 44100Hz.
+// Peaks hold the max absolute sample value of each block of PEAK_BLOCK_FRAMES frames.
+struct AudioSystemSoundBankHeader
+{
+  static const uint32_t MAGIC = 0x42535854; // "TXSB"
+  static const uint32_t VERSION = 2;
+  static const uint32_t ALIGNMENT = 64;
+  static const uint32_t PEAK_BLOCK_FRAMES = 1024;
+
+  static const uint32_t NUM_CHANNELS = 2;
+  static const uint32_t SAMPLE_RATE = 44100;
+
+  uint32_t magic{ MAGIC };
+  uint32_t version{ VERSION };
+  uint32_t numEntries{ 0 };
+  uint32_t alignment{ ALIGNMENT };
+  uint64_t namesOffset{ 0 };
+  uint64_t namesSize{ 0 };
+};
+
+struct AudioSystemSoundBankEntry
+{
+  uint64_t nameHash{ 0 };
+  uint32_t nameOffset{ 0 };     // from AudioSystemSoundBankHeader::namesOffset
+  uint32_t numChannels{ 0 };
+  uint32_t sampleRate{ 0 };
+  uint32_t numPeaks{ 0 };
+  uint64_t samplesOffset{ 0 };  // from the start of the bank
+  uint64_t numSamples{ 0 };     // PCM16 samples, all channels included
+  uint64_t peaksOffset{ 0 };    // from the start of the bank
+};
+
+// AudioSystemSoundBank
+//
+// A mounted bank: the file is mapped once and the sounds are resolved without any parsing or copy
+class AudioSystemSoundBank
+{
+public:
+
+  // FNV-1a
+  static uint64_t Hash(const char* name)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *name; name++)
+    {
+      hash ^= static_cast<uint8_t>(*name);
+      hash *= 1099511628211ULL;
+    }
+
+    return hash;
+  }
+
+  bool Mount(const std::string& path)
+  {
+    if (!file.Open(path))
+    {
+      printf("Failed to mount sound bank %s. Error: Unable to map the file.\n", path.c_str());
+      return false;
+    }
+
+    const uint8_t* data = file.GetData();
+    size_t size = file.GetSize();
+
+    if (size < sizeof(AudioSystemSoundBankHeader))
+    {
+      printf("Failed to mount sound bank %s. Error: File too small.\n", path.c_str());
+      file.Close();
+      return false;
+    }
+
+    header = reinterpret_cast<const AudioSystemSoundBankHeader*>(data);
+    if (header->magic != AudioSystemSoundBankHeader::MAGIC || header->version != AudioSystemSoundBankHeader::VERSION)
+    {
+      printf("Failed to mount sound bank %s. Error: Not a sound bank or unsupported version.\n", path.c_str());
+      Unmount();
+      return false;
+    }
+
+    uint64_t tocSize = uint64_t(header->numEntries) * sizeof(AudioSystemSoundBankEntry);
+    if (!InFile(sizeof(AudioSystemSoundBankHeader), tocSize, size) || !InFile(header->namesOffset, header->namesSize, size))
+    {
+      printf("Failed to mount sound bank %s. Error: Truncated table of contents.\n", path.c_str());
+      Unmount();
+      return false;
+    }
+
+    entries = reinterpret_cast<const AudioSystemSoundBankEntry*>(data + sizeof(AudioSystemSoundBankHeader));
+    names = reinterpret_cast<const char*>(data + header->namesOffset);
+
+    // the last name is terminated, so every name found is
+    if (header->numEntries > 0 && (header->namesSize == 0 || names[header->namesSize - 1] != '\0'))
+    {
+      printf("Failed to mount sound bank %s. Error: Names not null terminated.\n", path.c_str());
+      Unmount();
+      return false;
+    }
+
+    for (uint32_t i = 0; i < header->numEntries; i++)
+    {
+      const AudioSystemSoundBankEntry& entry = entries[i];
+      bool samplesInFile = entry.numSamples <= size / sizeof(short) && InFile(entry.samplesOffset, entry.numSamples * sizeof(short), size);
+      bool peaksInFile = InFile(entry.peaksOffset, uint64_t(entry.numPeaks) * sizeof(uint16_t), size);
+      if (entry.nameOffset >= header->namesSize || !samplesInFile || !peaksInFile)
+      {
+        printf("Failed to mount sound bank %s. Error: Entry %u out of bounds.\n", path.c_str(), i);
+        Unmount();
+        return false;
+      }
+
+      // Find does a binary search on the hashes
+      if (i > 0 && entries[i - 1].nameHash > entry.nameHash)
+      {
+        printf("Failed to mount sound bank %s. Error: Table of contents not sorted.\n", path.c_str());
+        Unmount();
+        return false;
+      }
+    }
+
+    bankPath = path;
+    return true;
+  }
+
+  void Unmount()
+  {
+    file.Close();
+
+    header = nullptr;
+    entries = nullptr;
+    names = nullptr;
+    bankPath.clear();
+  }
+
+  bool Find(const std::string& soundName, AudioSystemSoundData& outSoundData) const
+  {
+    if (!header)
+    {
+      return false;
+    }
+
+    uint64_t hash = Hash(soundName.c_str());
+
+    const AudioSystemSoundBankEntry* begin = entries;
+    const AudioSystemSoundBankEntry* end = entries + header->numEntries;
+    auto it = std::lower_bound(begin, end, hash, [](const AudioSystemSoundBankEntry& entry, uint64_t h) { return entry.nameHash < h; });
+
+    // check the names in case of hash collision
+    for (; it != end && it->nameHash == hash; ++it)
+    {
+      if (std::strcmp(names + it->nameOffset, soundName.c_str()) == 0)
+      {
+        outSoundData.samples = reinterpret_cast<const short*>(file.GetData() + it->samplesOffset);
+        outSoundData.numSamples = static_cast<size_t>(it->numSamples);
+        outSoundData.numChannels = it->numChannels;
+        outSoundData.sampleRate = it->sampleRate;
+        outSoundData.peaks = reinterpret_cast<const uint16_t*>(file.GetData() + it->peaksOffset);
+        outSoundData.numPeaks = it->numPeaks;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  const std::string& GetPath() const { return bankPath; }
+
+private:
+
+  // the bytes [offset, offset + length) are in a file of the given size, without overflowing
+  static bool InFile(uint64_t offset, uint64_t length, uint64_t size)
+  {
+    return offset <= size && length <= size - offset;
+  }
+
+  AudioSystemMappedFile file;
+
+  const AudioSystemSoundBankHeader* header{ nullptr };
+  const AudioSystemSoundBankEntry* entries{ nullptr };
+  const char* names{ nullptr };
+
+  std::string bankPath;
+};
+
+#endif // !AUDIO_SYSTEM_SOUND_BANK_H
@@ -0,0 +1,134 @@
+#ifndef AUDIO_SYSTEM_BUS_FMOD_H
+#define AUDIO_SYSTEM_BUS_FMOD_H
+
+// AudioSystemBusFMOD
+//
+// FMOD channel group. Channels are routed to it when they are played.
+class AudioSystemBusFMOD : public IAudioSystemBus
+{
+public:
+
+  AudioSystemBusFMOD(FMOD::ChannelGroup* group) : channelGroup(group) {}
+
+  bool SetVolume(float volume) final
+  {
+    FMOD_RESULT result = channelGroup->setVolume(volume);
+    if (result != FMOD_OK)
+      printf("Failed to set volume for bus. Error: %s \n", FMOD_ErrorString(result));
+
+    return (result == FMOD_OK);
+  }
+
+  bool SetPaused(bool paused) final
+  {
+    FMOD_RESULT result = channelGroup->setPaused(paused);
+    if (result != FMOD_OK)
+      printf("Failed to %s bus. Error: %s \n", paused ? "pause" : "resume", FMOD_ErrorString(result));
+
+    return (result == FMOD_OK);
+  }
+
+  bool SetMuted(bool muted) final
+  {
+    FMOD_RESULT result = channelGroup->setMute(muted);
+    if (result != FMOD_OK)
+      printf("Failed to %s bus. Error: %s \n", muted ? "mute" : "unmute", FMOD_ErrorString(result));
+
+    return (result == FMOD_OK);
+  }
+
+  // The sidechain bus feeds a compressor at the end of this bus. FMOD's compressor has no depth: its ratio is set
+  // high, so the bus goes about 1 dB down per dB the sidechain is over the threshold, without a floor.
+  bool SetDucking(IAudioSystemBus* sidechainBus, const AudioSystemDucking& ducking) final
+  {
+    if (sidechainDSP)
+    {
+      duckingCompressor->disconnectFrom(sidechainDSP);
+      sidechainDSP = nullptr;
+    }
+
+    if (!sidechainBus)
+    {
+      return !duckingCompressor || duckingCompressor->setBypass(true) == FMOD_OK;
+    }
+
+    FMOD_RESULT result = FMOD_OK;
+    if (!duckingCompressor)
+    {
+      FMOD::System* system = nullptr;
+      result = channelGroup->getSystemObject(&system);
+      if (result == FMOD_OK)
+        result = system->createDSPByType(FMOD_DSP_TYPE_COMPRESSOR, &duckingCompressor);
+      if (result == FMOD_OK)
+        result = channelGroup->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, duckingCompressor);
+
+      if (result != FMOD_OK)
+      {
+        printf("Failed to create ducking for bus. Error: %s \n", FMOD_ErrorString(result));
+        if (duckingCompressor)
+          duckingCompressor->release();
+        duckingCompressor = nullptr;
+        return false;
+      }
+
+      FMOD_DSP_PARAMETER_SIDECHAIN useSidechain{ true };
+      duckingCompressor->setParameterData(FMOD_DSP_COMPRESSOR_USESIDECHAIN, &useSidechain, sizeof(useSidechain));
+      duckingCompressor->setParameterFloat(FMOD_DSP_COMPRESSOR_RATIO, 50.0f);
+    }
+
+    // the output of the sidechain bus, after its fader
+    result = static_cast<AudioSystemBusFMOD*>(sidechainBus)->GetChannelGroup()->getDSP(FMOD_CHANNELCONTROL_DSP_HEAD, &sidechainDSP);
+    if (result == FMOD_OK)
+      result = duckingCompressor->addInput(sidechainDSP, nullptr, FMOD_DSPCONNECTION_TYPE_SIDECHAIN);
+    if (result != FMOD_OK)
+    {
+      printf("Failed to set sidechain of bus. Error: %s \n", FMOD_ErrorString(result));
+      sidechainDSP = nullptr;
+      return false;
+    }
+
+    duckingCompressor->setParameterFloat(FMOD_DSP_COMPRESSOR_THRESHOLD, std::min(std::max(ducking.threshold, -80.0f), 0.0f));
+    duckingCompressor->setParameterFloat(FMOD_DSP_COMPRESSOR_ATTACK, std::min(std::max(ducking.attack * 1000.0f, 0.1f), 1000.0f));
+    duckingCompressor->setParameterFloat(FMOD_DSP_COMPRESSOR_RELEASE, std::min(std::max(ducking.release * 1000.0f, 10.0f), 5000.0f));
+    duckingCompressor->setBypass(false);
+    return true;
+  }
+
+  // The DSP processes the mix of the whole bus, instead of each channel
+  bool AddDSP(FMOD::DSP* dsp)
+  {
+    FMOD_RESULT result = channelGroup->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, dsp);
+    if (result != FMOD_OK)
+      printf("Failed to add DSP to bus. Error: %s \n", FMOD_ErrorString(result));
+
+    return (result == FMOD_OK);
+  }
+
+  bool RemoveDSP(FMOD::DSP* dsp)
+  {
+    return channelGroup->removeDSP(dsp) == FMOD_OK;
+  }
+
+  FMOD::ChannelGroup* GetChannelGroup() const { return channelGroup; }
+
+  void Release()
+  {
+    if (duckingCompressor)
+    {
+      duckingCompressor->release();
+      duckingCompressor = nullptr;
+    }
+
+    channelGroup->release();
+  }
+
+private:
+
+  FMOD::ChannelGroup* channelGroup{ nullptr };
+
+  // ducking by a sidechain bus, created the first time it is set
+  FMOD::DSP* duckingCompressor{ nullptr };
+  FMOD::DSP* sidechainDSP{ nullptr };
+};
+
+#endif // !AUDIO_SYSTEM_BUS_FMOD_H
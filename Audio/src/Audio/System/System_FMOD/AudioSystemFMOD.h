@@ -4,8 +4,13 @@
 #include "FMOD/fmod.hpp"
 #include "FMOD/fmod_errors.h"
 
+#include "AudioSystemBusFMOD.h"
+#include "AudioSystemFMODFileSystem.h"
+#include "AudioSystemFMODMemory.h"
 #include "AudioSystemSoundFMOD.h"
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 
@@ -13,10 +18,24 @@ class AudioSystemFMOD : public IAudioSystem
 {
 	FMOD::System* system { nullptr };
 
+	bool bankFileSystem { false };
+
+	std::vector<std::unique_ptr<AudioSystemBusFMOD>> buses;
+
+	// master bus dynamics, created the first time they are set
+	FMOD::DSP* compressor { nullptr };
+	FMOD::DSP* limiter { nullptr };
+
 public:
 
-	void Initialise() override
+	void Initialise(const AudioSystemConfig& config) override
 	{
+		// memory callbacks go first: FMOD allocates as soon as the system is created
+		if (!AudioSystemFMODMemory::Initialise(config))
+		{
+			return;
+		}
+
 		FMOD_RESULT result = FMOD::System_Create(&system);
 		if (result != FMOD_OK)
 		{
@@ -24,13 +43,77 @@ public:
 			return;
 		}
 
-		// TO-DO: init config data should be passed as an argument of the function
-		int maxChannels = 50;
+		bankFileSystem = config.bankFileSystem && AudioSystemFMODFileSystem::Install(system, this, config.assetsPath);
+
+		// real channels: the rest of the channels are virtual, only their position is updated
+		result = system->setSoftwareChannels(config.maxSoftwareChannels);
+		if (result != FMOD_OK)
+		{
+			printf("Failed to set FMOD software channels. Error: %s \n", FMOD_ErrorString(result));
+		}
+
+		FMOD_SPEAKERMODE speakerMode = FMOD_SPEAKERMODE_STEREO;
+		switch (config.speakerMode)
+		{
+		case AudioSystemSpeakerMode::MONO: speakerMode = FMOD_SPEAKERMODE_MONO; break;
+		case AudioSystemSpeakerMode::STEREO: speakerMode = FMOD_SPEAKERMODE_STEREO; break;
+		case AudioSystemSpeakerMode::QUAD: speakerMode = FMOD_SPEAKERMODE_QUAD; break;
+		case AudioSystemSpeakerMode::SURROUND_5_1: speakerMode = FMOD_SPEAKERMODE_5POINT1; break;
+		case AudioSystemSpeakerMode::SURROUND_7_1: speakerMode = FMOD_SPEAKERMODE_7POINT1; break;
+		}
+
+		result = system->setSoftwareFormat(0, speakerMode, 0);
+		if (result != FMOD_OK)
+		{
+			printf("Failed to set FMOD speaker mode. Error: %s \n", FMOD_ErrorString(result));
+		}
+
 		FMOD_INITFLAGS flags = FMOD_INIT_NORMAL;
+		if (config.rightHanded)
+		{
+			flags |= FMOD_INIT_3D_RIGHTHANDED;
+		}
+
+		if (config.occlusion.enabled)
+		{
+			// low-pass filter of the occluded channels
+			flags |= FMOD_INIT_CHANNEL_LOWPASS;
+		}
+
+		if (config.vol0BecomesVirtual)
+		{
+			flags |= FMOD_INIT_VOL0_BECOMES_VIRTUAL;
+
+			if (config.virtualVolume > 0.0f)
+			{
+				FMOD_ADVANCEDSETTINGS advancedSettings;
+				memset(&advancedSettings, 0, sizeof(FMOD_ADVANCEDSETTINGS));
+				advancedSettings.cbSize = sizeof(FMOD_ADVANCEDSETTINGS);
+				advancedSettings.vol0virtualvol = config.virtualVolume;
+				system->setAdvancedSettings(&advancedSettings);
+			}
+		}
+
 		void* extraDriverData = nullptr;
-		system->init(maxChannels, flags, extraDriverData);
+		result = system->init(config.maxChannels, flags, extraDriverData);
+		if (result != FMOD_OK)
+		{
+			printf("Failed to initialise FMOD system. Error: %s \n", FMOD_ErrorString(result));
+			system->release();
+			system = nullptr;
+			return;
+		}
+
+		// Note: FMOD's speed of sound is 340 units per second for a distance factor of 1.0f
+		result = system->set3DSettings(config.dopplerScale, config.speedOfSound / 340.0f, 1.0f);
+		if (result != FMOD_OK)
+		{
+			printf("Failed to set FMOD 3D settings. Error: %s \n", FMOD_ErrorString(result));
+		}
 
     AudioSystemSoundFMOD::s_system = system;
+
+    SetMasterDynamics(config.masterDynamics);
 	}
 
 	void Deinitialise() override
@@ -39,6 +122,21 @@ public:
 		{
 			return;
 		}
+
+		for (auto& bus : buses)
+		{
+			bus->Release();
+		}
+		buses.clear();
+
+		for (FMOD::DSP* dsp : { compressor, limiter })
+		{
+			if (dsp)
+			{
+				dsp->release();
+			}
+		}
+		compressor = limiter = nullptr;
 		
 		system->release();
 	}
@@ -59,33 +157,81 @@ public:
 
 		// update the system
 		system->update();
+
+		// play the sounds that were waiting for their nonblocking load
+		AudioSystemSoundFMOD::UpdatePendingSounds();
+	}
+
+	bool PollSoundEvent(IAudioSystemSound*& outSound, AudioSystemSoundEvent& outEvent) override
+	{
+		return AudioSystemSoundFMOD::PollSoundEvent(outSound, outEvent);
+	}
+
+	double GetOutputTime() const override
+	{
+		if (!system)
+		{
+			return 0.0;
+		}
+
+		// mixer clock of the master group, one mix block ahead: the earliest a channel played now can start
+		FMOD::ChannelGroup* masterGroup = nullptr;
+		unsigned long long clock = 0;
+		if (system->getMasterChannelGroup(&masterGroup) != FMOD_OK || masterGroup->getDSPClock(&clock, nullptr) != FMOD_OK)
+		{
+			return 0.0;
+		}
+
+		unsigned int blockLength = 0;
+		int sampleRate = 0;
+		system->getDSPBufferSize(&blockLength, nullptr);
+		system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+		return sampleRate > 0 ? double(clock + blockLength) / double(sampleRate) : 0.0;
 	}
 
   IAudioSystemSound* LoadSound(const std::string& soundName, AudioSystemSoundMode audioSystemSoundMode) final
   {
     if (!system)
     {
-      return false;
+      return nullptr;
     }
 
-    // get sound mode
-    FMOD_MODE soundMode = FMOD_DEFAULT;
-    if (audioSystemSoundMode & AudioSystemSoundMode_2D)
+    // create the sound
+    FMOD::Sound* sound = nullptr;
+    FMOD_RESULT result = system->createSound(soundName.c_str(), GetSoundMode(audioSystemSoundMode), nullptr, &sound);
+    if (result != FMOD_OK)
     {
-      soundMode |= FMOD_2D;
+      printf("Failed to load sound. Error: %s \n", FMOD_ErrorString(result));
+      return nullptr;
     }
-    else if (audioSystemSoundMode & AudioSystemSoundMode_3D)
+
+    return new AudioSystemSoundFMOD(sound);
+  }
+
+  IAudioSystemSound* LoadSoundFromMemory(const AudioSystemSoundData& soundData, AudioSystemSoundMode audioSystemSoundMode) final
+  {
+    if (!system)
     {
-      soundMode |= FMOD_3D;
+      return nullptr;
     }
 
-    // create the sound
+    // raw PCM16 samples used in place: FMOD does not copy them
+    FMOD_CREATESOUNDEXINFO exinfo;
+    memset(&exinfo, 0, sizeof(FMOD_CREATESOUNDEXINFO));
+    exinfo.cbsize = sizeof(FMOD_CREATESOUNDEXINFO);
+    exinfo.length = static_cast<unsigned int>(soundData.numSamples * sizeof(short));
+    exinfo.numchannels = static_cast<int>(soundData.numChannels);
+    exinfo.defaultfrequency = static_cast<int>(soundData.sampleRate);
+    exinfo.format = FMOD_SOUND_FORMAT_PCM16;
+
+    FMOD_MODE soundMode = GetSoundMode(audioSystemSoundMode) | FMOD_OPENMEMORY_POINT | FMOD_OPENRAW;
+
     FMOD::Sound* sound = nullptr;
-    FMOD_RESULT result = system->createSound(soundName.c_str(), soundMode, nullptr, &sound);
+    FMOD_RESULT result = system->createSound(reinterpret_cast<const char*>(soundData.samples), soundMode, &exinfo, &sound);
     if (result != FMOD_OK)
     {
-      printf("Failed to load sound. Error: %s \n", FMOD_ErrorString(result));
-      return false;
+      printf("Failed to load sound from memory. Error: %s \n", FMOD_ErrorString(result));
+      return nullptr;
     }
 
     return new AudioSystemSoundFMOD(sound);
@@ -101,6 +247,164 @@ public:
 
     return false;
   }
+
+  void SetReverb(const AudioSystemReverb& reverb) final
+  {
+    if (!system)
+    {
+      return;
+    }
+
+    // reverb instance 0, the one the channels are sent to
+    FMOD_REVERB_PROPERTIES properties = FMOD_PRESET_GENERIC;
+    properties.DecayTime = std::min(std::max(reverb.decayTime * 1000.0f, 100.0f), 20000.0f);
+    properties.EarlyDelay = std::min(std::max(reverb.preDelay * 1000.0f, 0.0f), 300.0f);
+    properties.HFDecayRatio = 100.0f - std::min(std::max(reverb.damping, 0.0f), 1.0f) * 90.0f;
+    properties.WetLevel = reverb.wetLevel > 0.0f ? std::max(20.0f * std::log10(reverb.wetLevel), -80.0f) : -80.0f;
+
+    FMOD_RESULT result = system->setReverbProperties(0, &properties);
+    if (result != FMOD_OK)
+    {
+      printf("Failed to set reverb. Error: %s \n", FMOD_ErrorString(result));
+    }
+  }
+
+  // Note: FMOD's compressor has no knee setting, it is always hard
+  void SetMasterDynamics(const AudioSystemMasterDynamics& dynamics) final
+  {
+    if (!system)
+    {
+      return;
+    }
+
+    if (!compressor)
+    {
+      FMOD::ChannelGroup* masterGroup = nullptr;
+      FMOD_RESULT result = system->getMasterChannelGroup(&masterGroup);
+      if (result == FMOD_OK)
+      {
+        result = system->createDSPByType(FMOD_DSP_TYPE_COMPRESSOR, &compressor);
+      }
+      if (result == FMOD_OK)
+      {
+        result = system->createDSPByType(FMOD_DSP_TYPE_LIMITER, &limiter);
+      }
+
+      // the head is the end of the chain: the limiter goes last
+      if (result == FMOD_OK)
+      {
+        result = masterGroup->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, compressor);
+      }
+      if (result == FMOD_OK)
+      {
+        result = masterGroup->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, limiter);
+      }
+
+      if (result != FMOD_OK)
+      {
+        printf("Failed to create master dynamics. Error: %s \n", FMOD_ErrorString(result));
+        for (FMOD::DSP* dsp : { compressor, limiter })
+        {
+          if (dsp)
+          {
+            dsp->release();
+          }
+        }
+        compressor = limiter = nullptr;
+        return;
+      }
+    }
+
+    compressor->setParameterFloat(FMOD_DSP_COMPRESSOR_THRESHOLD, std::min(std::max(dynamics.threshold, -80.0f), 0.0f));
+    compressor->setParameterFloat(FMOD_DSP_COMPRESSOR_RATIO, std::min(std::max(dynamics.ratio, 1.0f), 50.0f));
+    compressor->setParameterFloat(FMOD_DSP_COMPRESSOR_ATTACK, std::min(std::max(dynamics.attack * 1000.0f, 0.1f), 1000.0f));
+    compressor->setParameterFloat(FMOD_DSP_COMPRESSOR_RELEASE, std::min(std::max(dynamics.release * 1000.0f, 10.0f), 5000.0f));
+    compressor->setParameterFloat(FMOD_DSP_COMPRESSOR_GAINMAKEUP, std::min(std::max(dynamics.makeupGain, 0.0f), 30.0f));
+    compressor->setBypass(!dynamics.compressor);
+
+    limiter->setParameterFloat(FMOD_DSP_LIMITER_CEILING, std::min(std::max(dynamics.ceiling, -12.0f), 0.0f));
+    limiter->setParameterFloat(FMOD_DSP_LIMITER_RELEASETIME, std::min(std::max(dynamics.limiterRelease * 1000.0f, 1.0f), 1000.0f));
+    limiter->setParameterFloat(FMOD_DSP_LIMITER_MODE, 1.0f); // linked: the channels are limited together
+    limiter->setBypass(!dynamics.limiter);
+  }
+
+  IAudioSystemBus* CreateBus(const std::string& busName, IAudioSystemBus* parentBus) final
+  {
+    if (!system)
+    {
+      return nullptr;
+    }
+
+    FMOD::ChannelGroup* channelGroup = nullptr;
+    FMOD_RESULT result = system->createChannelGroup(busName.c_str(), &channelGroup);
+    if (result != FMOD_OK)
+    {
+      printf("Failed to create bus %s. Error: %s \n", busName.c_str(), FMOD_ErrorString(result));
+      return nullptr;
+    }
+
+    // new channel groups are children of the master group
+    if (parentBus)
+    {
+      static_cast<AudioSystemBusFMOD*>(parentBus)->GetChannelGroup()->addGroup(channelGroup);
+    }
+
+    buses.push_back(std::make_unique<AudioSystemBusFMOD>(channelGroup));
+    return buses.back().get();
+  }
+
+  bool GetMemoryStats(AudioSystemMemoryStats& outStats) const final
+  {
+    return AudioSystemFMODMemory::GetStats(outStats);
+  }
+
+  bool GetFileStats(AudioSystemFileStats& outStats) const final
+  {
+    if (!bankFileSystem)
+    {
+      return false;
+    }
+
+    AudioSystemFMODFileSystem::GetStats(outStats);
+    return true;
+  }
+
+private:
+
+  FMOD_MODE GetSoundMode(AudioSystemSoundMode audioSystemSoundMode) const
+  {
+    FMOD_MODE soundMode = FMOD_DEFAULT;
+    if (audioSystemSoundMode & AudioSystemSoundMode_2D)
+    {
+      soundMode |= FMOD_2D;
+    }
+    else if (audioSystemSoundMode & AudioSystemSoundMode_3D)
+    {
+      soundMode |= FMOD_3D;
+    }
+
+    // memory/CPU tradeoff: decoded PCM by default, compressed in memory or streamed from disk
+    if (audioSystemSoundMode & AudioSystemSoundMode_STREAM)
+    {
+      soundMode |= FMOD_CREATESTREAM;
+    }
+    else if (audioSystemSoundMode & AudioSystemSoundMode_COMPRESSED)
+    {
+      soundMode |= FMOD_CREATECOMPRESSEDSAMPLE;
+    }
+
+    if (audioSystemSoundMode & AudioSystemSoundMode_NONBLOCKING)
+    {
+      soundMode |= FMOD_NONBLOCKING;
+    }
+
+    if (audioSystemSoundMode & AudioSystemSoundMode_LOOP)
+    {
+      soundMode |= FMOD_LOOP_NORMAL;
+    }
+
+    return soundMode;
+  }
 };
 
 #endif // !AUDIO_SYSTEM_FMOD
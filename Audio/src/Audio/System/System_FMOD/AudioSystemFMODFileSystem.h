@@ -0,0 +1,209 @@
+#ifndef AUDIO_SYSTEM_FMOD_FILE_SYSTEM_H
+#define AUDIO_SYSTEM_FMOD_FILE_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// AudioSystemFMODFileSystem
+//
+// FMOD file callbacks. Sounds found in the mounted sound banks are read straight from the bank mapping
+// behind a generated WAV header, and their bank stays mounted until they are closed. Any other file is read from disk.
+class AudioSystemFMODFileSystem
+{
+public:
+
+  static bool Install(FMOD::System* system, const IAudioSystem* audioSystem_, const std::string& assetsPath_)
+  {
+    audioSystem = audioSystem_;
+    assetsPath = assetsPath_;
+
+    FMOD_RESULT result = system->setFileSystem(Open, Close, Read, Seek, nullptr, nullptr, -1);
+    if (result != FMOD_OK)
+    {
+      printf("Failed to set FMOD file system. Error: %s \n", FMOD_ErrorString(result));
+      return false;
+    }
+
+    return true;
+  }
+
+  static void GetStats(AudioSystemFileStats& outStats)
+  {
+    outStats.numBankFilesOpened = numBankFilesOpened;
+    outStats.numDiskFilesOpened = numDiskFilesOpened;
+    outStats.bankBytesRead = bankBytesRead;
+    outStats.diskBytesRead = diskBytesRead;
+  }
+
+private:
+
+  static const size_t WAV_HEADER_SIZE = 44;
+
+  struct File
+  {
+    // file on disk
+    FILE* file{ nullptr };
+
+    // or sound in a mounted bank, kept mounted while the file is open
+    const AudioSystemSoundBank* soundBank{ nullptr };
+    unsigned char header[WAV_HEADER_SIZE];
+    const unsigned char* samples{ nullptr };
+    size_t samplesSize{ 0 };
+    size_t position{ 0 };
+  };
+
+  static FMOD_RESULT F_CALLBACK Open(const char* name, unsigned int* fileSize, void** handle, void* userData)
+  {
+    File* file = new File();
+
+    AudioSystemSoundData soundData;
+    file->soundBank = AcquireBankSound(name, soundData);
+    if (file->soundBank)
+    {
+      file->samples = reinterpret_cast<const unsigned char*>(soundData.samples);
+      file->samplesSize = soundData.numSamples * sizeof(short);
+      WriteWavHeader(soundData, file->samplesSize, file->header);
+
+      *fileSize = static_cast<unsigned int>(WAV_HEADER_SIZE + file->samplesSize);
+      numBankFilesOpened++;
+    }
+    else
+    {
+      file->file = fopen(name, "rb");
+      if (!file->file)
+      {
+        delete file;
+        return FMOD_ERR_FILE_NOTFOUND;
+      }
+
+      fseek(file->file, 0, SEEK_END);
+      *fileSize = static_cast<unsigned int>(ftell(file->file));
+      fseek(file->file, 0, SEEK_SET);
+      numDiskFilesOpened++;
+    }
+
+    *handle = file;
+    return FMOD_OK;
+  }
+
+  static FMOD_RESULT F_CALLBACK Close(void* handle, void* userData)
+  {
+    File* file = static_cast<File*>(handle);
+    if (file->file)
+    {
+      fclose(file->file);
+    }
+    else
+    {
+      audioSystem->ReleaseBankSound(file->soundBank);
+    }
+
+    delete file;
+    return FMOD_OK;
+  }
+
+  static FMOD_RESULT F_CALLBACK Read(void* handle, void* buffer, unsigned int sizeBytes, unsigned int* bytesRead, void* userData)
+  {
+    File* file = static_cast<File*>(handle);
+
+    if (file->file)
+    {
+      *bytesRead = static_cast<unsigned int>(fread(buffer, 1, sizeBytes, file->file));
+      diskBytesRead += *bytesRead;
+    }
+    else
+    {
+      // copy straight from the bank mapping: header first, then the samples
+      unsigned char* out = static_cast<unsigned char*>(buffer);
+      size_t fileSize = WAV_HEADER_SIZE + file->samplesSize;
+      size_t count = std::min(size_t(sizeBytes), fileSize - std::min(file->position, fileSize));
+
+      size_t copied = 0;
+      if (file->position < WAV_HEADER_SIZE)
+      {
+        size_t headerCount = std::min(count, WAV_HEADER_SIZE - file->position);
+        memcpy(out, &file->header[file->position], headerCount);
+        copied += headerCount;
+      }
+
+      if (copied < count)
+      {
+        memcpy(out + copied, &file->samples[file->position + copied - WAV_HEADER_SIZE], count - copied);
+      }
+
+      file->position += count;
+      *bytesRead = static_cast<unsigned int>(count);
+      bankBytesRead += count;
+    }
+
+    return *bytesRead < sizeBytes ? FMOD_ERR_FILE_EOF : FMOD_OK;
+  }
+
+  static FMOD_RESULT F_CALLBACK Seek(void* handle, unsigned int pos, void* userData)
+  {
+    File* file = static_cast<File*>(handle);
+    if (file->file)
+    {
+      return fseek(file->file, long(pos), SEEK_SET) == 0 ? FMOD_OK : FMOD_ERR_FILE_COULDNOTSEEK;
+    }
+
+    file->position = pos;
+    return FMOD_OK;
+  }
+
+  // The name is the path to a loose file: the assets path, then the name of the sound in the banks
+  static const AudioSystemSoundBank* AcquireBankSound(const char* name, AudioSystemSoundData& outSoundData)
+  {
+    if (!audioSystem || strncmp(name, assetsPath.c_str(), assetsPath.size()) != 0)
+    {
+      return nullptr;
+    }
+
+    return audioSystem->AcquireBankSound(name + assetsPath.size(), outSoundData);
+  }
+
+  static void WriteWavHeader(const AudioSystemSoundData& soundData, size_t dataSize, unsigned char* header)
+  {
+    uint32_t numChannels = uint32_t(soundData.numChannels);
+    uint32_t sampleRate = uint32_t(soundData.sampleRate);
+    uint32_t blockAlign = numChannels * sizeof(short);
+
+    auto write16 = [&](size_t offset, uint32_t value) { header[offset] = value & 0xFF; header[offset + 1] = (value >> 8) & 0xFF; };
+    auto write32 = [&](size_t offset, uint32_t value) { write16(offset, value & 0xFFFF); write16(offset + 2, value >> 16); };
+
+    memcpy(&header[0], "RIFF", 4);
+    write32(4, uint32_t(WAV_HEADER_SIZE - 8 + dataSize));
+    memcpy(&header[8], "WAVE", 4);
+    memcpy(&header[12], "fmt ", 4);
+    write32(16, 16);
+    write16(20, 1); // PCM
+    write16(22, numChannels);
+    write32(24, sampleRate);
+    write32(28, sampleRate * blockAlign);
+    write16(32, blockAlign);
+    write16(34, 16);
+    memcpy(&header[36], "data", 4);
+    write32(40, uint32_t(dataSize));
+  }
+
+  static const IAudioSystem* audioSystem;
+  static std::string assetsPath;
+
+  // FMOD reads from its own threads
+  static std::atomic<size_t> numBankFilesOpened;
+  static std::atomic<size_t> numDiskFilesOpened;
+  static std::atomic<size_t> bankBytesRead;
+  static std::atomic<size_t> diskBytesRead;
+};
+
+const IAudioSystem* AudioSystemFMODFileSystem::audioSystem = nullptr;
+std::string AudioSystemFMODFileSystem::assetsPath;
+std::atomic<size_t> AudioSystemFMODFileSystem::numBankFilesOpened{ 0 };
+std::atomic<size_t> AudioSystemFMODFileSystem::numDiskFilesOpened{ 0 };
+std::atomic<size_t> AudioSystemFMODFileSystem::bankBytesRead{ 0 };
+std::atomic<size_t> AudioSystemFMODFileSystem::diskBytesRead{ 0 };
+
+#endif // !AUDIO_SYSTEM_FMOD_FILE_SYSTEM_H
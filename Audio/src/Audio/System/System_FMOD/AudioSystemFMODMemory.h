@@ -0,0 +1,164 @@
+#ifndef AUDIO_SYSTEM_FMOD_MEMORY_H
+#define AUDIO_SYSTEM_FMOD_MEMORY_H
+
+#include <atomic>
+#include <cstdlib>
+
+// AudioSystemFMODMemory
+//
+// Routes the FMOD allocations to a fixed arena or to heap callbacks that keep count of the memory used.
+// Note: it must be initialised before any FMOD system is created.
+class AudioSystemFMODMemory
+{
+public:
+
+  static bool Initialise(const AudioSystemConfig& config)
+  {
+    if (initialised)
+    {
+      // FMOD memory can only be set up once
+      return true;
+    }
+
+    FMOD_RESULT result = FMOD_OK;
+    if (config.memoryPool && config.memoryPoolSize > 0)
+    {
+      // FMOD allocates from the arena only: it never touches the heap
+      result = FMOD::Memory_Initialize(config.memoryPool, static_cast<int>(config.memoryPoolSize), nullptr, nullptr, nullptr);
+      usingPool = true;
+    }
+    else if (config.trackMemory)
+    {
+      result = FMOD::Memory_Initialize(nullptr, 0, Alloc, Realloc, Free);
+      usingPool = false;
+    }
+    else
+    {
+      return true;
+    }
+
+    if (result != FMOD_OK)
+    {
+      printf("Failed to initialise FMOD memory. Error: %s \n", FMOD_ErrorString(result));
+      return false;
+    }
+
+    initialised = true;
+    return true;
+  }
+
+  static bool GetStats(AudioSystemMemoryStats& outStats)
+  {
+    if (!initialised)
+    {
+      return false;
+    }
+
+    if (usingPool)
+    {
+      int currentBytes = 0;
+      int peakBytes = 0;
+      FMOD::Memory_GetStats(&currentBytes, &peakBytes, false);
+
+      outStats.currentBytes = size_t(currentBytes);
+      outStats.peakBytes = size_t(peakBytes);
+      outStats.numAllocations = 0;
+    }
+    else
+    {
+      outStats.currentBytes = currentBytes;
+      outStats.peakBytes = peakBytes;
+      outStats.numAllocations = numAllocations;
+    }
+
+    return true;
+  }
+
+private:
+
+  // each block starts with its size, keeping the 16 bytes alignment FMOD expects
+  static const size_t HEADER_SIZE = 16;
+
+  static void* F_CALLBACK Alloc(unsigned int size, FMOD_MEMORY_TYPE type, const char* sourceStr)
+  {
+    unsigned char* block = static_cast<unsigned char*>(std::malloc(HEADER_SIZE + size));
+    if (!block)
+    {
+      return nullptr;
+    }
+
+    *reinterpret_cast<size_t*>(block) = size;
+    OnAlloc(size);
+
+    return block + HEADER_SIZE;
+  }
+
+  static void* F_CALLBACK Realloc(void* ptr, unsigned int size, FMOD_MEMORY_TYPE type, const char* sourceStr)
+  {
+    if (!ptr)
+    {
+      return Alloc(size, type, sourceStr);
+    }
+
+    unsigned char* block = static_cast<unsigned char*>(ptr) - HEADER_SIZE;
+    size_t oldSize = *reinterpret_cast<size_t*>(block);
+
+    unsigned char* newBlock = static_cast<unsigned char*>(std::realloc(block, HEADER_SIZE + size));
+    if (!newBlock)
+    {
+      return nullptr;
+    }
+
+    *reinterpret_cast<size_t*>(newBlock) = size;
+    OnFree(oldSize);
+    OnAlloc(size);
+
+    return newBlock + HEADER_SIZE;
+  }
+
+  static void F_CALLBACK Free(void* ptr, FMOD_MEMORY_TYPE type, const char* sourceStr)
+  {
+    if (!ptr)
+    {
+      return;
+    }
+
+    unsigned char* block = static_cast<unsigned char*>(ptr) - HEADER_SIZE;
+    OnFree(*reinterpret_cast<size_t*>(block));
+
+    std::free(block);
+  }
+
+  static void OnAlloc(size_t size)
+  {
+    size_t current = currentBytes.fetch_add(size) + size;
+    numAllocations++;
+
+    size_t peak = peakBytes.load();
+    while (current > peak && !peakBytes.compare_exchange_weak(peak, current))
+    {
+    }
+  }
+
+  static void OnFree(size_t size)
+  {
+    currentBytes.fetch_sub(size);
+    numAllocations--;
+  }
+
+  static bool initialised;
+  static bool usingPool;
+
+  // FMOD allocates from its own threads
+  static std::atomic<size_t> currentBytes;
+  static std::atomic<size_t> peakBytes;
+  static std::atomic<size_t> numAllocations;
+};
+
+bool AudioSystemFMODMemory::initialised = false;
+bool AudioSystemFMODMemory::usingPool = false;
+std::atomic<size_t> AudioSystemFMODMemory::currentBytes{ 0 };
+std::atomic<size_t> AudioSystemFMODMemory::peakBytes{ 0 };
+std::atomic<size_t> AudioSystemFMODMemory::numAllocations{ 0 };
+
+#endif // !AUDIO_SYSTEM_FMOD_MEMORY_H
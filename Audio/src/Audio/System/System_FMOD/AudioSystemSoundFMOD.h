@@ -1,56 +1,99 @@
 #ifndef AUDIO_SYSTEM_SOUND_FMOD_H
 #define AUDIO_SYSTEM_SOUND_FMOD_H
 
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <map>
+#include <vector>
+
 class AudioSystemSoundFMOD : public IAudioSystemSound
 {
 public:
 
   AudioSystemSoundFMOD(FMOD::Sound* s) : sound(s) {}
 
-  bool Play() final
+  bool Play(float fadeTime) final
   {
-    bool paused = false;
-    FMOD_RESULT result = s_system->playSound(sound, nullptr, paused, &channel);
-    if (result != FMOD_OK)
-    {
-      printf("Failed to play sound. Error: %s \n", FMOD_ErrorString(result));
-    }
+    return PlayAt(-1.0, fadeTime);
+  }
 
-    return (result == FMOD_OK);
+  bool PlayAt(double time, float fadeTime) final
+  {
+    startTime = time;
+    startFadeTime = fadeTime;
+    return Start();
   }
 
-  bool Stop() final
+  bool Stop(float fadeTime) final
   {
-    if (!channel)
+    if (pendingPlay)
     {
-      printf("Failed to %s. Sound has null channel.\n", "Stop");
-      return false;
+      CancelPendingPlay();
+      return true;
     }
 
-    FMOD_RESULT result = channel->stop();
-    if (result != FMOD_OK)
-      printf("Failed to stop sound. Error: %s \n", FMOD_ErrorString(result));
+    // the channels faded out are removed by their end callback
+    std::vector<FMOD::Channel*> playingChannels = channels;
+    bool stopped = true;
+    for (auto channel : playingChannels)
+    {
+      if (fadeTime <= 0.0f)
+      {
+        // stopped at once: no finished event
+        RemoveChannel(channel);
+      }
+
+      // faded out, then stopped by FMOD at the end of the fade
+      FMOD_RESULT result = fadeTime > 0.0f ? FadeOut(channel, fadeTime, true) : channel->stop();
+      if (result != FMOD_OK)
+      {
+        printf("Failed to stop sound. Error: %s \n", FMOD_ErrorString(result));
+        stopped = false;
+      }
+    }
 
-    return (result == FMOD_OK);
+    return stopped;
   }
 
-  bool Pause(bool pause) final
+  bool Pause(bool pause, float fadeTime) final
   {
-    if (!channel)
+    if (channels.empty())
     {
-      printf("Failed to %s. Sound has null channel.\n", "Pause");
+      printf("Failed to %s. Sound is not playing.\n", pause ? "Pause" : "Resume");
       return false;
     }
 
-    FMOD_RESULT result = channel->setPaused(pause);
-    if (result != FMOD_OK)
-      printf("Failed to %s sound. Error: %s \n", pause ? "pause" : "resume", FMOD_ErrorString(result));
+    bool done = true;
+    for (auto channel : channels)
+    {
+      FMOD_RESULT result = pause ? (fadeTime > 0.0f ? FadeOut(channel, fadeTime, false) : channel->setPaused(true)) : Resume(channel, fadeTime);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to %s sound. Error: %s \n", pause ? "pause" : "resume", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
 
-    return (result == FMOD_OK);
+    return done;
   }
 
   bool Release() final
   {
+    CancelPendingPlay();
+
+    // releasing the sound stops its channels: do not let their end callback reach this sound
+    std::vector<FMOD::Channel*> playingChannels = channels;
+    for (auto channel : playingChannels)
+    {
+      RemoveChannel(channel);
+    }
+
+    // nor its events the game
+    s_soundEvents.erase(std::remove_if(s_soundEvents.begin(), s_soundEvents.end(), [this](const SoundEvent& soundEvent) { return soundEvent.first == this; }), s_soundEvents.end());
+    markerPoints.clear();
+    loopPoint = nullptr;
+
     if (sound)
     {
       sound->release();
@@ -60,69 +103,670 @@ public:
     return false;
   }
 
+  bool IsReady() final
+  {
+    FMOD_OPENSTATE openState = GetOpenState();
+    return openState != FMOD_OPENSTATE_LOADING && openState != FMOD_OPENSTATE_ERROR;
+  }
+
   bool SetVolume(float volume) final
   {
-    if (!channel)
+    bool done = true;
+    for (auto channel : channels)
     {
-      printf("Failed to %s. Sound has null channel.\n", "SetVolume");
+      FMOD_RESULT result = channel->setVolume(volume);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set volume for sound. Error: %s \n", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
+
+    return done;
+  }
+
+  bool SetPitch(float pitch) final
+  {
+    bool done = true;
+    for (auto channel : channels)
+    {
+      FMOD_RESULT result = channel->setPitch(pitch);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set pitch for sound. Error: %s \n", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
+
+    return done;
+  }
+
+  bool SetBus(IAudioSystemBus* bus) final
+  {
+    channelGroup = bus ? static_cast<AudioSystemBusFMOD*>(bus)->GetChannelGroup() : nullptr;
+
+    // move the channels already playing
+    FMOD::ChannelGroup* group = channelGroup;
+    if (!group)
+    {
+      s_system->getMasterChannelGroup(&group);
+    }
+
+    bool done = true;
+    for (auto channel : channels)
+    {
+      FMOD_RESULT result = channel->setChannelGroup(group);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set bus for sound. Error: %s \n", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
+
+    return done;
+  }
+
+  void Set3DAttributes(const AudioSystemVector& position_, const AudioSystemVector& velocity_) final
+  {
+    // kept for the channels played later
+    position = *reinterpret_cast<const FMOD_VECTOR*> (&position_);
+    velocity = *reinterpret_cast<const FMOD_VECTOR*> (&velocity_);
+    has3DAttributes = true;
+
+    for (auto channel : channels)
+    {
+      channel->set3DAttributes(&position, &velocity);
+    }
+  }
+
+  void Set3DMinMaxDistance(float minDistance_, float maxDistance_) final
+  {
+    // negative distances keep the FMOD defaults
+    if (minDistance_ < 0.0f || maxDistance_ < minDistance_)
+    {
+      return;
+    }
+
+    minDistance = minDistance_;
+    maxDistance = maxDistance_;
+    has3DMinMaxDistance = true;
+
+    for (auto channel : channels)
+    {
+      channel->set3DMinMaxDistance(minDistance, maxDistance);
+    }
+  }
+
+  void Set3DRolloff(const AudioSystemRolloff& rolloff) final
+  {
+    switch (rolloff.type)
+    {
+    case AudioSystemRolloffType::INVERSE:
+      rolloffMode = FMOD_3D_INVERSEROLLOFF;
+      break;
+    case AudioSystemRolloffType::LINEAR:
+      rolloffMode = FMOD_3D_LINEARROLLOFF;
+      break;
+    case AudioSystemRolloffType::CUSTOM:
+      rolloffMode = FMOD_3D_CUSTOMROLLOFF;
+      break;
+    }
+
+    // Note: FMOD keeps a pointer to the custom rolloff points
+    customRolloff.clear();
+    for (auto& point : rolloff.curve)
+    {
+      customRolloff.push_back({ point.distance, point.gain, 0.0f });
+    }
+    has3DRolloff = true;
+
+    for (auto channel : channels)
+    {
+      Apply3DRolloff(channel);
+    }
+  }
+
+  void Set3DOcclusion(float gain, float) final
+  {
+    // Note: FMOD derives both the volume and the low-pass filter from the occlusion, so the cutoff is not used
+    occlusion = std::min(std::max(1.0f - gain, 0.0f), 1.0f);
+
+    for (auto channel : channels)
+    {
+      channel->set3DOcclusion(occlusion, occlusion);
+    }
+  }
+
+  bool SetLoop(const AudioSystemLoop& loop) final
+  {
+    // Note: FMOD has no crossfade at the seam of the loop, so loop.crossfade is not used
+
+    // negative points keep the ones of the sound. In PCM frames, as milliseconds are too coarse for a seamless loop.
+    unsigned int start = 0;
+    unsigned int end = 0;
+    unsigned int length = 0;
+    float frequency = 0.0f;
+    FMOD_RESULT result = sound->getLoopPoints(&start, FMOD_TIMEUNIT_PCM, &end, FMOD_TIMEUNIT_PCM);
+    if (result == FMOD_OK)
+    {
+      result = sound->getLength(&length, FMOD_TIMEUNIT_PCM);
+    }
+
+    if (result == FMOD_OK)
+    {
+      result = sound->getDefaults(&frequency, nullptr);
+    }
+
+    if (result != FMOD_OK)
+    {
+      printf("Failed to set loop for sound. Error: %s \n", FMOD_ErrorString(result));
       return false;
     }
 
-    FMOD_RESULT result = channel->setVolume(volume);
+    unsigned int lastFrame = length > 0 ? length - 1 : 0;
+    start = loop.start >= 0.0f ? std::min(static_cast<unsigned int>(double(loop.start) * frequency), lastFrame) : start;
+    end = loop.end >= 0.0f ? std::min(static_cast<unsigned int>(double(loop.end) * frequency), lastFrame) : end;
+
+    // kept for the channels played later
+    FMOD_MODE mode = loop.enabled ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
+    result = sound->setMode(mode);
+    if (result == FMOD_OK)
+    {
+      result = sound->setLoopPoints(start, FMOD_TIMEUNIT_PCM, end, FMOD_TIMEUNIT_PCM);
+    }
+
     if (result != FMOD_OK)
-      printf("Failed to set volume for sound. Error: %s \n", FMOD_ErrorString(result));
+    {
+      printf("Failed to set loop for sound. Error: %s \n", FMOD_ErrorString(result));
+      return false;
+    }
+
+    AddLoopPoint();
+
+    bool done = true;
+    for (auto channel : channels)
+    {
+      result = channel->setMode(mode);
+      if (result == FMOD_OK)
+      {
+        result = channel->setLoopPoints(start, FMOD_TIMEUNIT_PCM, end, FMOD_TIMEUNIT_PCM);
+      }
+
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set loop for sound. Error: %s \n", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
 
-    return (result == FMOD_OK);
+    return done;
   }
 
-  bool SetPitch(float pitch) final
+  bool SetMarkers(const std::vector<float>& times) final
   {
-    if (!channel)
+    for (auto markerPoint : markerPoints)
     {
-      printf("Failed to %s. Sound has null channel.\n", "SetPitch");
+      sound->deleteSyncPoint(markerPoint);
+    }
+    markerPoints.clear();
+
+    // sync points raise a callback on the channels reaching them
+    std::vector<float> sortedTimes = times;
+    std::sort(sortedTimes.begin(), sortedTimes.end());
+    for (float time : sortedTimes)
+    {
+      FMOD_SYNCPOINT* markerPoint = nullptr;
+      FMOD_RESULT result = sound->addSyncPoint(static_cast<unsigned int>(std::max(time, 0.0f) * 1000.0f), FMOD_TIMEUNIT_MS, "marker", &markerPoint);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set markers for sound. Error: %s \n", FMOD_ErrorString(result));
+        return false;
+      }
+      markerPoints.push_back(markerPoint);
+    }
+
+    return true;
+  }
+
+  bool SetFilter(const AudioSystemFilter& filter_) final
+  {
+    // kept for the channels played later
+    filter = filter_;
+    hasFilter = true;
+
+    bool done = true;
+    for (auto channel : channels)
+    {
+      done &= ApplyFilter(channel);
+    }
+
+    return done;
+  }
+
+  bool SetReverbSend(float level) final
+  {
+    // kept for the channels played later
+    reverbSend = std::min(std::max(level, 0.0f), 1.0f);
+
+    bool done = true;
+    for (auto channel : channels)
+    {
+      FMOD_RESULT result = channel->setReverbProperties(0, reverbSend);
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set reverb send for sound. Error: %s \n", FMOD_ErrorString(result));
+        done = false;
+      }
+    }
+
+    return done;
+  }
+
+  size_t GetNumChannels() const { return channels.size(); }
+
+private:
+
+  // Play a new channel, at startTime when it is set
+  bool Start()
+  {
+    FMOD_OPENSTATE openState = GetOpenState();
+    if (openState == FMOD_OPENSTATE_LOADING)
+    {
+      // nonblocking load in progress: the sound is played once loaded
+      if (!pendingPlay)
+      {
+        pendingPlay = true;
+        s_pendingSounds.push_back(this);
+      }
+      return true;
+    }
+
+    if (openState == FMOD_OPENSTATE_ERROR)
+    {
+      printf("Failed to play sound. Error: Sound failed to load \n");
       return false;
     }
 
-    FMOD_RESULT result = channel->setPitch(pitch);
+    if (!loopPoint)
+    {
+      AddLoopPoint();
+    }
+
+    // start paused, so the 3D attributes are set before the channel is heard
+    FMOD::Channel* channel = nullptr;
+    bool paused = true;
+    FMOD_RESULT result = s_system->playSound(sound, channelGroup, paused, &channel);
     if (result != FMOD_OK)
-      printf("Failed to set pitch for sound. Error: %s \n", FMOD_ErrorString(result));
+    {
+      printf("Failed to play sound. Error: %s \n", FMOD_ErrorString(result));
+      return false;
+    }
+
+    // track the channel until it ends
+    channel->setUserData(this);
+    channel->setCallback(ChannelCallback);
+    channels.push_back(channel);
+
+    if (has3DAttributes)
+    {
+      channel->set3DAttributes(&position, &velocity);
+    }
+
+    if (has3DMinMaxDistance)
+    {
+      channel->set3DMinMaxDistance(minDistance, maxDistance);
+    }
+
+    if (has3DRolloff)
+    {
+      Apply3DRolloff(channel);
+    }
+
+    if (occlusion > 0.0f)
+    {
+      channel->set3DOcclusion(occlusion, occlusion);
+    }
+
+    if (hasFilter)
+    {
+      ApplyFilter(channel);
+    }
+
+    // Note: FMOD sends every channel to the reverb by default
+    channel->setReverbProperties(0, reverbSend);
 
-    return (result == FMOD_OK);
+    if (startTime >= 0.0)
+    {
+      // start at that sample of the mixer clock
+      int sampleRate = 0;
+      s_system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+      channel->setDelay(static_cast<unsigned long long>(startTime * double(sampleRate)), 0, false);
+    }
+
+    if (startFadeTime > 0.0f)
+    {
+      // fade in from the start of the channel
+      unsigned long long startClock = 0;
+      channel->getDelay(&startClock, nullptr, nullptr);
+      AddFade(channel, std::max(startClock, GetClock(channel)), 0.0f, startFadeTime);
+    }
+
+    channel->setPaused(false);
+
+    return true;
+  }
+
+  static unsigned long long GetClock(FMOD::Channel* channel)
+  {
+    unsigned long long clock = 0;
+    channel->getDSPClock(nullptr, &clock);
+    return clock;
   }
 
-  void Set3DAttributes(const AudioSystemVector& position, const AudioSystemVector& velocity) final
+  // Ramp the fade volume of the channel from 'from' to the other end over fadeTime seconds from the mixer clock 'clock'. Returns the clock at the end of the ramp.
+  // Note: the fade volume multiplies the volume of the channel
+  static unsigned long long AddFade(FMOD::Channel* channel, unsigned long long clock, float from, float fadeTime)
   {
-    if (!channel)
+    int sampleRate = 0;
+    s_system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+    unsigned long long fadeEnd = clock + static_cast<unsigned long long>(fadeTime * float(sampleRate));
+
+    channel->removeFadePoints(clock, std::numeric_limits<unsigned long long>::max());
+    channel->addFadePoint(clock, from);
+    channel->addFadePoint(fadeEnd, 1.0f - from);
+
+    return fadeEnd;
+  }
+
+  // Fade the channel out, then stop or pause it
+  static FMOD_RESULT FadeOut(FMOD::Channel* channel, float fadeTime, bool stop)
+  {
+    unsigned long long startClock = 0;
+    channel->getDelay(&startClock, nullptr, nullptr);
+    unsigned long long fadeEnd = AddFade(channel, GetClock(channel), 1.0f, fadeTime);
+    return channel->setDelay(startClock, fadeEnd, stop);
+  }
+
+  static FMOD_RESULT Resume(FMOD::Channel* channel, float fadeTime)
+  {
+    // clear the end of a fade out that paused the channel
+    unsigned long long startClock = 0;
+    unsigned long long endClock = 0;
+    channel->getDelay(&startClock, &endClock, nullptr);
+    if (endClock != 0)
     {
-      printf("Failed to %s. Sound has null channel.\n", "Set3DAttributes");
-      return;
+      channel->setDelay(startClock, 0, false);
     }
 
-    const FMOD_VECTOR* pos = reinterpret_cast<const FMOD_VECTOR*> (&position);
-    const FMOD_VECTOR* vel = reinterpret_cast<const FMOD_VECTOR*> (&velocity);
-    channel->set3DAttributes(pos, vel);
+    if (fadeTime > 0.0f)
+    {
+      AddFade(channel, GetClock(channel), 0.0f, fadeTime);
+    }
+    else
+    {
+      channel->removeFadePoints(0, std::numeric_limits<unsigned long long>::max());
+    }
+
+    return channel->setPaused(false);
   }
 
-  void Set3DMinMaxDistance(float minDistance, float maxDistance) final
+  FMOD_OPENSTATE GetOpenState() const
   {
-    if (!channel)
+    FMOD_OPENSTATE openState = FMOD_OPENSTATE_ERROR;
+    if (sound && sound->getOpenState(&openState, nullptr, nullptr, nullptr) != FMOD_OK)
+    {
+      openState = FMOD_OPENSTATE_ERROR;
+    }
+
+    return openState;
+  }
+
+  void Apply3DRolloff(FMOD::Channel* channel)
+  {
+    channel->setMode(rolloffMode);
+    if (rolloffMode == FMOD_3D_CUSTOMROLLOFF && !customRolloff.empty())
+    {
+      channel->set3DCustomRolloff(customRolloff.data(), static_cast<int>(customRolloff.size()));
+    }
+  }
+
+  // Low-pass and high-pass DSPs at the input of the channel, added the first time it is filtered
+  bool ApplyFilter(FMOD::Channel* channel)
+  {
+    bool lowPass = filter.lowPassCutoff < 22000.0f;
+    bool highPass = filter.highPassCutoff > 10.0f;
+
+    auto filterIt = channelFilters.find(channel);
+    if (filterIt == channelFilters.end())
+    {
+      if (!lowPass && !highPass)
+      {
+        return true;
+      }
+
+      ChannelFilter channelFilter;
+      FMOD_RESULT result = s_system->createDSPByType(FMOD_DSP_TYPE_LOWPASS_SIMPLE, &channelFilter.lowPass);
+      if (result == FMOD_OK)
+      {
+        result = s_system->createDSPByType(FMOD_DSP_TYPE_HIGHPASS_SIMPLE, &channelFilter.highPass);
+      }
+
+      if (result != FMOD_OK)
+      {
+        printf("Failed to set filter for sound. Error: %s \n", FMOD_ErrorString(result));
+        if (channelFilter.lowPass)
+        {
+          channelFilter.lowPass->release();
+        }
+        return false;
+      }
+
+      channel->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, channelFilter.lowPass);
+      channel->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, channelFilter.highPass);
+      filterIt = channelFilters.insert(std::make_pair(channel, channelFilter)).first;
+    }
+
+    ChannelFilter& channelFilter = filterIt->second;
+    channelFilter.lowPass->setParameterFloat(FMOD_DSP_LOWPASS_SIMPLE_CUTOFF, std::min(std::max(filter.lowPassCutoff, 10.0f), 22000.0f));
+    channelFilter.lowPass->setBypass(!lowPass);
+    channelFilter.highPass->setParameterFloat(FMOD_DSP_HIGHPASS_SIMPLE_CUTOFF, std::min(std::max(filter.highPassCutoff, 10.0f), 22000.0f));
+    channelFilter.highPass->setBypass(!highPass);
+
+    return true;
+  }
+
+  // Note: the DSPs must be removed from the channel before they are released
+  void ReleaseFilter(FMOD::Channel* channel)
+  {
+    auto filterIt = channelFilters.find(channel);
+    if (filterIt == channelFilters.end())
     {
-      printf("Failed to %s. Sound has null channel.\n", "Set3DMinMaxDistance");
       return;
     }
+
+    for (auto dsp : { filterIt->second.lowPass, filterIt->second.highPass })
+    {
+      channel->removeDSP(dsp);
+      dsp->release();
+    }
+    channelFilters.erase(filterIt);
   }
 
-private:
+  void CancelPendingPlay()
+  {
+    if (pendingPlay)
+    {
+      pendingPlay = false;
+      s_pendingSounds.erase(std::remove(s_pendingSounds.begin(), s_pendingSounds.end(), this), s_pendingSounds.end());
+    }
+  }
+
+  // Play the sounds whose nonblocking load has finished. Called by AudioSystemFMOD::Update.
+  static void UpdatePendingSounds()
+  {
+    std::vector<AudioSystemSoundFMOD*> pendingSounds = s_pendingSounds;
+    for (auto pendingSound : pendingSounds)
+    {
+      if (pendingSound->GetOpenState() != FMOD_OPENSTATE_LOADING)
+      {
+        pendingSound->CancelPendingPlay();
+        pendingSound->Start();
+      }
+    }
+  }
+
+  // Next event raised by the sounds. Called by AudioSystemFMOD::PollSoundEvent.
+  static bool PollSoundEvent(IAudioSystemSound*& outSound, AudioSystemSoundEvent& outEvent)
+  {
+    if (s_soundEvents.empty())
+    {
+      return false;
+    }
+
+    outSound = s_soundEvents.front().first;
+    outEvent = s_soundEvents.front().second;
+    s_soundEvents.pop_front();
+    return true;
+  }
+
+  // Sync point at the end of the loop, so the channels raise a looped event each time they reach it
+  void AddLoopPoint()
+  {
+    if (loopPoint)
+    {
+      sound->deleteSyncPoint(loopPoint);
+      loopPoint = nullptr;
+    }
+
+    unsigned int loopEnd = 0;
+    if (sound->getLoopPoints(nullptr, FMOD_TIMEUNIT_PCM, &loopEnd, FMOD_TIMEUNIT_PCM) == FMOD_OK)
+    {
+      sound->addSyncPoint(loopEnd, FMOD_TIMEUNIT_PCM, "loop", &loopPoint);
+    }
+  }
+
+  void PostEvent(AudioSystemSoundEventType type, size_t marker = 0)
+  {
+    AudioSystemSoundEvent soundEvent;
+    soundEvent.type = type;
+    soundEvent.marker = marker;
+    s_soundEvents.emplace_back(this, soundEvent);
+  }
+
+  // Stop tracking a channel: its end callback does not reach this sound
+  void RemoveChannel(FMOD::Channel* channel)
+  {
+    channel->setCallback(nullptr);
+    channel->setUserData(nullptr);
+    ReleaseFilter(channel);
+    channels.erase(std::remove(channels.begin(), channels.end(), channel), channels.end());
+  }
+
+  // Called by FMOD from System::update (or from Channel::stop) in the game thread
+  static FMOD_RESULT F_CALLBACK ChannelCallback(FMOD_CHANNELCONTROL* channelControl, FMOD_CHANNELCONTROL_TYPE controlType, FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType, void* commandData1, void* commandData2)
+  {
+    if (controlType != FMOD_CHANNELCONTROL_CHANNEL)
+    {
+      return FMOD_OK;
+    }
+
+    FMOD::Channel* channel = reinterpret_cast<FMOD::Channel*>(channelControl);
+
+    void* userData = nullptr;
+    channel->getUserData(&userData);
+    AudioSystemSoundFMOD* audioSystemSound = static_cast<AudioSystemSoundFMOD*>(userData);
+    if (!audioSystemSound)
+    {
+      return FMOD_OK;
+    }
+
+    if (callbackType == FMOD_CHANNELCONTROL_CALLBACK_END)
+    {
+      auto& channels = audioSystemSound->channels;
+      channels.erase(std::remove(channels.begin(), channels.end(), channel), channels.end());
+      audioSystemSound->ReleaseFilter(channel);
+      audioSystemSound->PostEvent(AudioSystemSoundEventType::FINISHED);
+    }
+    else if (callbackType == FMOD_CHANNELCONTROL_CALLBACK_SYNCPOINT)
+    {
+      // commandData1 is the index of the sync point in the sound
+      FMOD_SYNCPOINT* syncPoint = nullptr;
+      audioSystemSound->sound->getSyncPoint(static_cast<int>(reinterpret_cast<intptr_t>(commandData1)), &syncPoint);
+
+      FMOD_MODE mode = 0;
+      channel->getMode(&mode);
+      auto& markerPoints = audioSystemSound->markerPoints;
+      auto markerIt = std::find(markerPoints.begin(), markerPoints.end(), syncPoint);
+      if (syncPoint == audioSystemSound->loopPoint && (mode & FMOD_LOOP_NORMAL))
+      {
+        audioSystemSound->PostEvent(AudioSystemSoundEventType::LOOPED);
+      }
+      else if (markerIt != markerPoints.end())
+      {
+        audioSystemSound->PostEvent(AudioSystemSoundEventType::MARKER, size_t(markerIt - markerPoints.begin()));
+      }
+    }
+
+    return FMOD_OK;
+  }
 
   static FMOD::System* s_system;
+  static std::vector<AudioSystemSoundFMOD*> s_pendingSounds;
+
+  // events raised by the channels of the sounds, polled by AudioSystemFMOD
+  using SoundEvent = std::pair<AudioSystemSoundFMOD*, AudioSystemSoundEvent>;
+  static std::deque<SoundEvent> s_soundEvents;
 
   FMOD::Sound* sound{ nullptr };
-  FMOD::Channel* channel{ nullptr };
+
+  // channel group the channels are played in (null = master)
+  FMOD::ChannelGroup* channelGroup{ nullptr };
+
+  // channels playing the sound, real or virtual
+  std::vector<FMOD::Channel*> channels;
+
+  bool pendingPlay{ false };
+
+  // time of the mixer clock the last play starts at, in seconds (-1 = at once)
+  double startTime{ -1.0 };
+  float startFadeTime{ 0.0f };
+
+  FMOD_VECTOR position{ 0.0f, 0.0f, 0.0f };
+  FMOD_VECTOR velocity{ 0.0f, 0.0f, 0.0f };
+  bool has3DAttributes{ false };
+
+  float minDistance{ 1.0f };
+  float maxDistance{ 10000.0f };
+  bool has3DMinMaxDistance{ false };
+
+  FMOD_MODE rolloffMode{ FMOD_3D_INVERSEROLLOFF };
+  std::vector<FMOD_VECTOR> customRolloff;
+  bool has3DRolloff{ false };
+
+  float occlusion{ 0.0f };
+
+  float reverbSend{ 0.0f };
+
+  // filter DSPs of the channels
+  struct ChannelFilter
+  {
+    FMOD::DSP* lowPass{ nullptr };
+    FMOD::DSP* highPass{ nullptr };
+  };
+
+  AudioSystemFilter filter;
+  bool hasFilter{ false };
+  std::map<FMOD::Channel*, ChannelFilter> channelFilters;
+
+  // sync points of the markers, in time order, and of the end of the loop
+  std::vector<FMOD_SYNCPOINT*> markerPoints;
+  FMOD_SYNCPOINT* loopPoint{ nullptr };
 
   friend class AudioSystemFMOD;
 };
 
 FMOD::System* AudioSystemSoundFMOD::s_system = nullptr;
+std::vector<AudioSystemSoundFMOD*> AudioSystemSoundFMOD::s_pendingSounds;
+std::deque<AudioSystemSoundFMOD::SoundEvent> AudioSystemSoundFMOD::s_soundEvents;
 
 #endif // !AUDIO_SYSTEM_SOUND_FMOD_H
-
@@ -7,11 +7,24 @@ class AudioSystemTxikiAudio : public IAudioSystem
 {
 	TxikiAudio txikiAudio;
 
+  bool rightHanded{ false };
+
 public:
 
-	void Initialise() override 
+	void Initialise(const AudioSystemConfig& config) override 
 	{
-    txikiAudio.Init();
+    // Note: TxikiAudio mixes every playing sound, it has no channel budget
+    TxikiAudioConfig txikiAudioConfig;
+    txikiAudioConfig.dopplerScale = config.dopplerScale;
+    txikiAudioConfig.speedOfSound = config.speedOfSound;
+    txikiAudioConfig.hrtfPath = config.hrtfPath;
+    txikiAudioConfig.maxHRTFVoices = config.maxHRTFVoices;
+    txikiAudioConfig.ambisonicOrder = config.ambisonicOrder;
+    txikiAudioConfig.outputLayout = static_cast<TxikiAudioOutputLayout>(config.speakerMode); // same order
+    txikiAudioConfig.masterDynamics = config.masterDynamics;
+    txikiAudio.Init(txikiAudioConfig);
+
+    rightHanded = config.rightHanded;
 	}
 
 	void Deinitialise() override 
@@ -21,12 +34,42 @@ public:
 
 	void Update() override 
 	{
-		// TO-DO
+		TxikiAudioListener txikiAudioListener;
+		txikiAudioListener.position = listener.GetPosition();
+		txikiAudioListener.velocity = listener.GetVelocity();
+		txikiAudioListener.forward = listener.GetForward();
+		txikiAudioListener.up = listener.GetUp();
+		txikiAudioListener.rightHanded = rightHanded;
+		txikiAudio.SetListener(txikiAudioListener);
+
+		txikiAudio.Update();
+	}
+
+	double GetOutputTime() const override
+	{
+		return txikiAudio.GetOutputTime();
+	}
+
+	bool PollSoundEvent(IAudioSystemSound*& outSound, AudioSystemSoundEvent& outEvent) override
+	{
+		TxikiAudioSound* sound = nullptr;
+		if (!txikiAudio.PollSoundEvent(sound, outEvent))
+		{
+			return false;
+		}
+
+		outSound = sound;
+		return true;
 	}
 
   IAudioSystemSound* LoadSound(const std::string& soundName, AudioSystemSoundMode audioSystemSoundMode) final
   {
-    return txikiAudio.LoadSound(soundName);
+    return txikiAudio.LoadSound(soundName, GetSoundMode(audioSystemSoundMode));
+  }
+
+  IAudioSystemSound* LoadSoundFromMemory(const AudioSystemSoundData& soundData, AudioSystemSoundMode audioSystemSoundMode) final
+  {
+    return txikiAudio.LoadSound(soundData, GetSoundMode(audioSystemSoundMode));
   }
 
   bool UnloadSound(IAudioSystemSound* audioSystemSound) final
@@ -34,6 +77,49 @@ public:
     TxikiAudioSound* sound = static_cast<TxikiAudioSound*>(audioSystemSound);
     return txikiAudio.UnloadSound(sound);
   }
+
+  void Set3DAttributes(const AudioSystemEmitterBatch& batch) final
+  {
+    txikiAudio.Set3DAttributes(batch);
+  }
+
+  void SetRoom(const AudioSystemRoom& room) final
+  {
+    txikiAudio.SetRoom(room);
+  }
+
+  void SetReverb(const AudioSystemReverb& reverb) final
+  {
+    txikiAudio.SetReverb(reverb);
+  }
+
+  bool SetReverbImpulseResponse(const std::string& impulseResponsePath) final
+  {
+    return txikiAudio.SetReverbImpulseResponse(impulseResponsePath);
+  }
+
+  void SetMasterDynamics(const AudioSystemMasterDynamics& dynamics) final
+  {
+    txikiAudio.SetMasterDynamics(dynamics);
+  }
+
+  IAudioSystemBus* CreateBus(const std::string& busName, IAudioSystemBus* parentBus) final
+  {
+    return txikiAudio.CreateBus(busName, static_cast<TxikiAudioBus*>(parentBus));
+  }
+
+private:
+
+  TxikiAudioSoundMode GetSoundMode(AudioSystemSoundMode audioSystemSoundMode) const
+  {
+    // Note: TxikiAudio only plays PCM files, so compressed sounds are loaded as any other sound
+    TxikiAudioSoundMode soundMode;
+    soundMode.stream = (audioSystemSoundMode & AudioSystemSoundMode_STREAM) != 0;
+    soundMode.nonBlocking = (audioSystemSoundMode & AudioSystemSoundMode_NONBLOCKING) != 0;
+    soundMode.loop = (audioSystemSoundMode & AudioSystemSoundMode_LOOP) != 0;
+
+    return soundMode;
+  }
 };
 
 #endif // !AUDIO_SYSTEM_TXIKI_AUDIO
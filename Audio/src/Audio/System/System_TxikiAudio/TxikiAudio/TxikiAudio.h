@@ -1,26 +1,171 @@
 #ifndef TXIKI_AUDIO_H
 #define TXIKI_AUDIO_H
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <functional>
+#include <iterator>
 #include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "portaudio/portaudio.h"
 
+#include "TxikiAudioAmbisonics.h"
+#include "TxikiAudioBus.h"
+#include "TxikiAudioConvolutionReverb.h"
+#include "TxikiAudioDynamics.h"
+#include "TxikiAudioEarlyReflections.h"
 #include "TxikiAudioEnums.h"
+#include "TxikiAudioHRTF.h"
+#include "TxikiAudioReverb.h"
 #include "TxikiAudioSound.h"
 #include "TxikiAudioSoundLoader.h"
+#include "TxikiAudioSpeakers.h"
+#include "TxikiAudioSpatializer.h"
+#include "TxikiAudioStream.h"
+#include "TxikiAudioTripleBuffer.h"
+#include "TxikiAudioVoices3D.h"
 
+// TxikiAudio settings
+struct TxikiAudioConfig
+{
+  TxikiAudioStreamConfig streamConfig;
+
+  // sounds loaded and buses created at once. They are allocated by Init, as the audio thread walks them without a lock.
+  size_t maxSounds{ 1024 };
+  size_t maxBuses{ 64 };
+
+  // Doppler shift of the 3D voices (0 = no Doppler)
+  float dopplerScale{ 1.0f };
+  float speedOfSound{ 343.0f };
+
+  // binaural rendering of the loudest 3D voices (no HRIR set = stereo panning only)
+  std::string hrtfPath;
+  size_t maxHRTFVoices{ 16 };
+  size_t hrtfBlockSize{ 128 }; // power of two
+
+  // 3D voices encoded into an ambisonic bus of this order (1 to 3) and decoded once, instead of being spatialised one by one
+  size_t ambisonicOrder{ 0 };
+
+  // speakers of the output (Note: falls back to stereo when the device does not support the layout)
+  TxikiAudioOutputLayout outputLayout{ TxikiAudioOutputLayout::STEREO };
+
+  // early reflections of the room: found again when the emitter or the listener moves further than the threshold, up to the max delay in seconds
+  float reflectionsMoveThreshold{ 0.5f };
+  float maxReflectionsDelay{ 0.25f };
+
+  // longest pre-delay of the reverb, in seconds
+  float maxReverbPreDelay{ 0.2f };
+
+  // convolution reverb: frames of the head and tail partitions (powers of two) and longest impulse response in seconds
+  size_t convolutionHeadBlockSize{ 256 };
+  size_t convolutionTailBlockSize{ 4096 };
+  float maxImpulseResponseLength{ 4.0f };
+
+  // 3D voices lose their highs with distance: low-pass cutoff of 22 kHz / (1 + distance * airAbsorption)
+  float airAbsorption{ 0.01f };
+
+  // compressor and limiter of the master bus. The limiter delays the output by its look-ahead, in seconds.
+  AudioSystemMasterDynamics masterDynamics;
+  float limiterLookAhead{ 0.005f };
+};
+
+// How a sound is loaded and played
+struct TxikiAudioSoundMode
+{
+  bool stream{ false };      // decode from disk while playing
+  bool nonBlocking{ false }; // load in the I/O thread
+  bool loop{ false };
+};
+
+// TxikiAudio statistics
+struct TxikiAudioStats
+{
+  size_t numStreams{ 0 };
+  size_t streamUnderruns{ 0 };
+  size_t reverbUnderruns{ 0 }; // tail blocks of the convolution reverb not convolved in time
 
+  // master dynamics: share of the last buffer's duration spent in them, and their gain reduction in dB
+  float masterDynamicsLoad{ 0.0f };
+  float masterGainReduction{ 0.0f };
+
+  size_t droppedSoundEvents{ 0 }; // sound events not polled in time, lost when their queue was full
+};
 
 class TxikiAudio 
 {
+  TxikiAudioConfig config;
+
   // sound loader
   TxikiAudioSoundLoader soundLoader;
 
-	// sounds
+	// sounds (Note: allocated once, as the audio thread walks them)
 	std::list<TxikiAudioSound> sounds;
+  mutable std::mutex soundsMutex;
+
+  // events raised by the sounds in the audio thread, polled by the game thread
+  TxikiAudioSoundEvents soundEvents;
+
+  // buses (Note: allocated once and never removed, as the audio thread walks them). The first numBuses are in use.
+  std::list<TxikiAudioBus> buses;
+  size_t numBuses{ 0 };
+
+  // 3D voices, handed off to the audio thread once per update
+  TxikiAudioListener listener;
+  TxikiAudioTripleBuffer<TxikiAudioVoices3D> voices3D;
+  const TxikiAudioVoices3D* mixVoices3D{ nullptr };
+
+  // output speakers
+  TxikiAudioSpeakers speakers;
+
+  // binaural rendering
+  TxikiAudioHRTF hrtf;
+
+  // or ambisonic mix of the 3D voices
+  TxikiAudioAmbisonicBus ambisonicBus;
+
+  // reflections of the 3D voices on the walls of the room
+  TxikiAudioEarlyReflections earlyReflections;
+
+  // reverb the voices are sent to, with its settings handed off to the audio thread
+  TxikiAudioReverb reverb;
+  TxikiAudioTripleBuffer<AudioSystemReverb> reverbSettings;
+
+  // or convolution with a measured impulse response (Note: kept until TxikiAudio is destroyed, as the audio thread may be using them)
+  TxikiAudioConvolutionReverb convolutionReverb;
+  std::map<std::string, std::unique_ptr<TxikiAudioImpulseResponse>> impulseResponses;
+
+  // compressor and limiter of the master bus, with their settings handed off to the audio thread
+  TxikiAudioDynamics masterDynamics;
+  TxikiAudioTripleBuffer<AudioSystemMasterDynamics> masterDynamicsSettings;
+
+  // audio thread: sounds are mixed in float and converted to PCM16 at the end
+  std::vector<float> mixBuffer;
+  std::vector<float> voiceBuffer;
+  std::vector<float> sendBuffer;
+  std::vector<float> laneBuffer;
+  bool mixReflections{ false };
+  bool mixReverb{ false };
+
+  // audio thread: filtered sounds waiting for their lanes to be filled
+  TxikiAudioSound* filteredSounds[TxikiAudioBiquads::NUM_LANES];
+  float lowPassCutoffs[TxikiAudioBiquads::NUM_LANES];
+  float highPassCutoffs[TxikiAudioBiquads::NUM_LANES];
+  uint64_t mixCount{ 0 };
+
+  // mixes finished by the audio thread, so the game thread knows when a sound is no longer mixed
+  std::atomic<uint64_t> mixesDone{ 0 };
+
+  // audio thread: stream time the buffer being mixed is heard at
+  double mixTime{ 0.0 };
+
+  // I/O thread for the streamed sounds
+  TxikiAudioStreamer streamer;
 
 	// handle to PortAudio stream
 	PaStream* stream_PCM16{ nullptr }; 
@@ -29,7 +174,7 @@ class TxikiAudio
 
 public:
 
-  bool Init()
+  bool Init(const TxikiAudioConfig& config_ = TxikiAudioConfig())
   {
     assert(!initialised);
     if (initialised)
@@ -37,6 +182,16 @@ public:
       return false;
     }
 
+    config = config_;
+
+    // the pools of sounds and buses are never grown once the audio thread runs
+    sounds.resize(config.maxSounds);
+    for (auto& sound : sounds)
+    {
+      sound.events = &soundEvents;
+    }
+    buses.resize(config.maxBuses);
+
     // initialise portaudio
     auto result = Pa_Initialize();
     if (result != paNoError)
@@ -45,14 +200,44 @@ public:
       return false;
     }
 
+    // the stream decides the speakers the sounds are mixed for
+    OpenStream();
+
+    // binaural rendering is for headphones. In the ambisonic mix the HRIRs are only used to decode the bus.
+    bool stereo = speakers.GetLayout() == TxikiAudioOutputLayout::STEREO;
+    size_t maxHRTFVoices = config.ambisonicOrder > 0 ? 0 : config.maxHRTFVoices;
+    if (!config.hrtfPath.empty() && (!stereo || !hrtf.Load(config.hrtfPath, maxHRTFVoices, config.hrtfBlockSize)))
+    {
+      printf("Warning: TxikiAudio HRTF disabled, 3D sounds are panned\n");
+    }
+
+    ambisonicBus.Init(config.ambisonicOrder, speakers, hrtf.GetHRIRs(), config.hrtfBlockSize);
+
+    earlyReflections.Init(speakers, config.speedOfSound, config.reflectionsMoveThreshold, config.maxReflectionsDelay);
+
+    // no reverb until it is set
+    reverb.Init(config.maxReverbPreDelay);
+    reverbSettings.GetWriteBuffer().wetLevel = 0.0f;
+    reverbSettings.Publish();
+    convolutionReverb.Init(config.convolutionHeadBlockSize, config.convolutionTailBlockSize, size_t(config.maxImpulseResponseLength * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz)));
+
+    size_t mixStride = stereo ? TxikiAudioSound::NUM_CHANNELS : speakers.GetMixStride();
+    masterDynamics.Init(speakers.GetNumChannels(), mixStride, config.limiterLookAhead);
+    SetMasterDynamics(config.masterDynamics);
+
     StartStream();
 
+    streamer.Start();
+
     initialised = true;
     return true;
   }
 
   bool Terminate()
   {
+    // stop the I/O thread before releasing the streams
+    streamer.Stop();
+
     // release the sounds
 		for (auto& sound : sounds)
 		{
@@ -66,6 +251,12 @@ public:
 			stream_PCM16 = nullptr;
 		}
 
+    // the audio thread is done with the buses
+    buses.clear();
+    numBuses = 0;
+
+    convolutionReverb.Terminate();
+
     // terminate portaudio
     auto result = Pa_Terminate();
     if (result != paNoError)
@@ -78,7 +269,7 @@ public:
     return true;
   }
 
-  TxikiAudioSound* LoadSound(const std::string& soundName)
+  TxikiAudioSound* LoadSound(const std::string& soundName, const TxikiAudioSoundMode& mode = TxikiAudioSoundMode())
   {
     if (!initialised)
     {
@@ -86,33 +277,94 @@ public:
       return nullptr;
     }
 
-    TxikiAudioSound* sound = nullptr;
-
-    // reuse a not used sound
-    for (auto& s : sounds)
+    if (mode.nonBlocking)
     {
-      if (!s.samples)
+      // reserve the sound now and load it in the I/O thread
+      TxikiAudioSound* sound = nullptr;
+      uint32_t generation = 0;
       {
-        sound = &s;
-        break;
+        std::lock_guard<std::mutex> lock(soundsMutex);
+        sound = NewSound();
+        if (!sound)
+        {
+          return nullptr;
+        }
+
+        sound->loadState = TxikiAudioSound::LoadState::LOADING;
+        generation = sound->generation;
       }
+
+      streamer.AddJob([this, soundName, mode, sound, generation]()
+      {
+        TxikiAudioSoundDesc soundDesc;
+        std::unique_ptr<TxikiAudioStream> stream;
+        bool loaded = ReadSound(soundName, mode, soundDesc, stream);
+
+        std::lock_guard<std::mutex> lock(soundsMutex);
+        if (sound->generation != generation)
+        {
+          // unloaded while loading: the data read is dropped
+          return;
+        }
+
+        if (loaded)
+        {
+          SetSound(soundDesc, std::move(stream), mode, *sound);
+        }
+        else
+        {
+          sound->loadState = TxikiAudioSound::LoadState::FAILED;
+        }
+      });
+
+      return sound;
     }
 
-    // create a new sound if all sounds are in use
-    if (!sound)
+    // read the sound data first, so several sounds can be loaded at the same time
+    TxikiAudioSoundDesc soundDesc;
+    std::unique_ptr<TxikiAudioStream> stream;
+    if (!ReadSound(soundName, mode, soundDesc, stream))
     {
-      sounds.emplace_back(TxikiAudioSound());
-      sound = &sounds.back();
+      return nullptr;
     }
 
-    if (soundLoader.LoadSound(soundName, *sound))
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    TxikiAudioSound* sound = NewSound();
+    if (sound)
     {
-      return sound;
+      SetSound(soundDesc, std::move(stream), mode, *sound);
     }
 
-    return nullptr;
+    return sound;
 	}
-  
+
+  TxikiAudioSound* LoadSound(const AudioSystemSoundData& soundData, const TxikiAudioSoundMode& mode = TxikiAudioSoundMode())
+  {
+    if (!initialised)
+    {
+      printf("Error: Unable to load sound from memory. TxikiAudio not initialised\n");
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    TxikiAudioSound* sound = NewSound();
+    if (!sound)
+    {
+      return nullptr;
+    }
+
+    if (!soundLoader.SetSoundData(soundData, *sound))
+    {
+      sound->Release();
+      return nullptr;
+    }
+
+    sound->loop = mode.loop;
+    return sound;
+  }
+
   bool UnloadSound(TxikiAudioSound* sound)
   {
     if (!sound)
@@ -120,64 +372,669 @@ public:
       return false;
     }
 
+    // Note: a load still in progress drops its data, as releasing the sound changes its generation
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    // the mixer may be reading its data (a stream, a file in memory or a mounted bank): stop the sound and wait until it is no longer mixed
+    sound->Stop(0.0f);
+    if (sound->played)
+    {
+      WaitForMix();
+    }
+
+    if (sound->stream)
+    {
+      streamer.RemoveStream(sound->stream.get());
+    }
+
     sound->Release();
     return true;
   }
 
+  TxikiAudioBus* CreateBus(const std::string& busName, TxikiAudioBus* parentBus)
+  {
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    if (numBuses == buses.size())
+    {
+      printf("Error: Unable to create bus %s. All the %zu buses are in use\n", busName.c_str(), buses.size());
+      return nullptr;
+    }
+
+    TxikiAudioBus* bus = &*std::next(buses.begin(), numBuses++);
+    bus->name = busName;
+    bus->parent = parentBus;
+
+    return bus;
+  }
+
+  // Game thread: 3D attributes of a batch of sounds
+  void Set3DAttributes(const AudioSystemEmitterBatch& batch)
+  {
+    for (size_t i = 0; i < batch.numEmitters; i++)
+    {
+      TxikiAudioSound* sound = static_cast<TxikiAudioSound*>(batch.sounds[i]);
+      sound->is3D = true;
+      sound->position = { batch.positionX[i], batch.positionY[i], batch.positionZ[i] };
+      sound->velocity = { batch.velocityX[i], batch.velocityY[i], batch.velocityZ[i] };
+    }
+  }
+
+  // Game thread: listener of the 3D sounds
+  void SetListener(const TxikiAudioListener& listener_)
+  {
+    listener = listener_;
+    listener.dopplerScale = config.dopplerScale;
+    listener.speedOfSound = config.speedOfSound;
+    listener.airAbsorption = config.airAbsorption;
+  }
+
+  // Game thread: room the listener is in, for the early reflections (no walls = no reflections)
+  void SetRoom(const AudioSystemRoom& room)
+  {
+    earlyReflections.SetRoom(room);
+  }
+
+  // Game thread: reverb the sounds are sent to (no wet level = off)
+  void SetReverb(const AudioSystemReverb& settings)
+  {
+    reverbSettings.GetWriteBuffer() = settings;
+    reverbSettings.Publish();
+  }
+
+  // Game thread: measured impulse response (WAV file) the reverb sends are convolved with, instead of going through
+  // the feedback delay network ("" = back to it)
+  bool SetReverbImpulseResponse(const std::string& impulseResponseName)
+  {
+    if (impulseResponseName.empty())
+    {
+      convolutionReverb.SetImpulseResponse(nullptr);
+      return true;
+    }
+
+    auto impulseResponseIt = impulseResponses.find(impulseResponseName);
+    if (impulseResponseIt == impulseResponses.end())
+    {
+      TxikiAudioSoundDesc soundDesc;
+      if (!soundLoader.LoadSound(impulseResponseName, soundDesc))
+      {
+        return false;
+      }
+
+      size_t sampleRate = size_t(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+      if (soundDesc.sampleRate != sampleRate)
+      {
+        printf("Error: Impulse response %s not supported. Sample rate %zu\n", impulseResponseName.c_str(), soundDesc.sampleRate);
+        return false;
+      }
+
+      size_t length = soundDesc.samplesBufferSize / TxikiAudioSound::NUM_CHANNELS;
+      size_t maxLength = size_t(config.maxImpulseResponseLength * float(sampleRate));
+      if (length > maxLength)
+      {
+        printf("Warning: Impulse response %s cut to %.1f seconds\n", impulseResponseName.c_str(), config.maxImpulseResponseLength);
+        length = maxLength;
+      }
+
+      std::vector<float> left(length);
+      std::vector<float> right(length);
+      for (size_t i = 0; i < length; i++)
+      {
+        left[i] = float(soundDesc.samples[i * 2]) / 32768.0f;
+        right[i] = float(soundDesc.samples[i * 2 + 1]) / 32768.0f;
+      }
+
+      auto impulseResponse = convolutionReverb.NewImpulseResponse(left.data(), right.data(), length);
+      impulseResponseIt = impulseResponses.insert(std::make_pair(impulseResponseName, std::move(impulseResponse))).first;
+    }
+
+    convolutionReverb.SetImpulseResponse(impulseResponseIt->second.get());
+    return true;
+  }
+
+  // Game thread: compressor and limiter of the master bus
+  void SetMasterDynamics(const AudioSystemMasterDynamics& settings)
+  {
+    masterDynamicsSettings.GetWriteBuffer() = settings;
+    masterDynamicsSettings.Publish();
+  }
+
+  // Game thread
+  void Update()
+  {
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    // play the sounds whose nonblocking load is done
+    for (auto& sound : sounds)
+    {
+      if (sound.pendingPlay && sound.loadState != TxikiAudioSound::LoadState::LOADING)
+      {
+        sound.pendingPlay = false;
+        sound.PlayAt(sound.startTime.load(), sound.pendingPlayFadeTime);
+      }
+    }
+
+    // hand the 3D voices off to the audio thread, all at once
+    TxikiAudioVoices3D& voices = voices3D.GetWriteBuffer();
+    voices.Clear();
+    for (auto& sound : sounds)
+    {
+      if (sound.is3D && sound.IsLoaded())
+      {
+        voices.Add(sound);
+      }
+    }
+    TxikiAudioSpatializer::Process(listener, voices);
+    hrtf.AssignVoices(voices);
+    if (ambisonicBus.IsEnabled())
+    {
+      TxikiAudioSpatializer::EncodeAmbisonics(listener, config.ambisonicOrder, voices);
+    }
+    else if (speakers.GetLayout() != TxikiAudioOutputLayout::STEREO)
+    {
+      speakers.Pan(voices);
+    }
+    earlyReflections.Update(listener, voices);
+    voices3D.Publish();
+  }
+
+  // Stream time at which a sound played now is heard. Sounds played at an earlier time start at once.
+  double GetOutputTime() const
+  {
+    if (!stream_PCM16)
+    {
+      return 0.0;
+    }
+
+    const PaStreamInfo* streamInfo = Pa_GetStreamInfo(stream_PCM16);
+    return Pa_GetStreamTime(stream_PCM16) + (streamInfo ? streamInfo->outputLatency : 0.0);
+  }
+
+  TxikiAudioStats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(soundsMutex);
+
+    TxikiAudioStats stats;
+    for (auto& sound : sounds)
+    {
+      if (sound.stream)
+      {
+        stats.numStreams++;
+        stats.streamUnderruns += sound.stream->underruns;
+      }
+    }
+    stats.reverbUnderruns = convolutionReverb.GetUnderruns();
+    stats.masterDynamicsLoad = masterDynamics.GetLoad();
+    stats.masterGainReduction = masterDynamics.GetGainReduction();
+    stats.droppedSoundEvents = soundEvents.dropped;
+
+    return stats;
+  }
+
+  // Game thread: next event raised by the sounds. Events of the sounds released since they were raised are skipped.
+  bool PollSoundEvent(TxikiAudioSound*& outSound, AudioSystemSoundEvent& outEvent)
+  {
+    TxikiAudioSoundEvent soundEvent;
+    while (soundEvents.Pop(soundEvent))
+    {
+      if (soundEvent.generation == soundEvent.sound->generation.load(std::memory_order_relaxed))
+      {
+        outSound = soundEvent.sound;
+        outEvent = soundEvent.event;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
 	protected:
 
-		void WriteSounds(void* outputBuffer, size_t framesPerBuffer)
+		void WriteSounds(void* outputBuffer, size_t framesPerBuffer, double outputTime)
 		{
-			// reset buffer (Note: We are using PCM16 format!) 
+			mixCount++;
+			mixTime = outputTime;
+
+			bool speakerMix = speakers.GetLayout() != TxikiAudioOutputLayout::STEREO;
+
+			// last 3D voices handed off by the game thread
+			mixVoices3D = &voices3D.Read();
+			bool reflections = mixVoices3D->numReflectionTaps > 0;
+
+			reverb.SetSettings(reverbSettings.Read());
+			bool reverbEnabled = reverb.IsEnabled();
+			mixReflections = reflections;
+			mixReverb = reverbEnabled;
+			size_t paddedSize = TxikiAudioSIMD::PaddedSize(mixVoices3D->Size());
+			for (size_t i = 0; i < mixVoices3D->Size(); i++)
+			{
+				TxikiAudioSound* sound = mixVoices3D->sounds[i];
+				sound->targetGains3D[0] = mixVoices3D->gainLeft[i];
+				sound->targetGains3D[1] = mixVoices3D->gainRight[i];
+				sound->targetDoppler = mixVoices3D->doppler[i];
+				sound->targetLowPassCutoff = mixVoices3D->lowPassCutoff[i];
+				sound->hrtfSlot = mixVoices3D->hrtfSlot[i];
+				sound->voice3D = i;
+				sound->gains3DMix = mixCount;
+
+				if (ambisonicBus.IsEnabled())
+				{
+					// attenuated only, the ambisonic bus places them
+					sound->targetGains3D[0] = mixVoices3D->attenuation[i];
+					sound->targetGains3D[1] = mixVoices3D->attenuation[i];
+
+					for (size_t channel = 0; channel < ambisonicBus.GetNumChannels(); channel++)
+					{
+						sound->targetAmbisonicGains[channel] = mixVoices3D->ambisonicGains[channel * paddedSize + i];
+					}
+				}
+				else if (speakerMix)
+				{
+					// attenuated only, the speaker gains place them
+					sound->targetGains3D[0] = mixVoices3D->attenuation[i];
+					sound->targetGains3D[1] = mixVoices3D->attenuation[i];
+
+					for (size_t channel = 0; channel < speakers.GetMixStride(); channel++)
+					{
+						sound->targetSpeakerGains[channel] = mixVoices3D->speakerGains[channel * paddedSize + i];
+					}
+				}
+				else if (sound->hrtfSlot >= 0)
+				{
+					// binaural voices are attenuated only, the HRIRs place them
+					sound->targetGains3D[0] = mixVoices3D->attenuation[i];
+					sound->targetGains3D[1] = mixVoices3D->attenuation[i];
+					hrtf.SetVoice(sound->hrtfSlot, sound, mixVoices3D->directionX[i], mixVoices3D->directionY[i], mixVoices3D->directionZ[i]);
+				}
+				else if (reflections)
+				{
+					// attenuated only and panned after the reflections are taken
+					float attenuation = mixVoices3D->attenuation[i];
+					float inverseAttenuation = attenuation > 1e-6f ? 1.0f / attenuation : 0.0f;
+					sound->targetGains3D[0] = attenuation;
+					sound->targetGains3D[1] = attenuation;
+					sound->targetSpeakerGains[0] = mixVoices3D->gainLeft[i] * inverseAttenuation;
+					sound->targetSpeakerGains[1] = mixVoices3D->gainRight[i] * inverseAttenuation;
+				}
+			}
+
+			// reset buffers (Note: the buffers only grow, so they stop allocating after the first callbacks)
+			size_t mixStride = speakerMix ? speakers.GetMixStride() : TxikiAudioSound::NUM_CHANNELS;
+			size_t numMixSamples = framesPerBuffer * mixStride;
+			size_t numVoiceSamples = framesPerBuffer * TxikiAudioSound::NUM_CHANNELS;
+			if (mixBuffer.size() < numMixSamples || voiceBuffer.size() < numVoiceSamples)
+			{
+				mixBuffer.resize(numMixSamples);
+				voiceBuffer.resize(numVoiceSamples);
+				sendBuffer.resize(numVoiceSamples);
+				laneBuffer.resize(numVoiceSamples * TxikiAudioBiquads::NUM_LANES);
+			}
+			std::fill(mixBuffer.begin(), mixBuffer.begin() + numMixSamples, 0.0f);
+			if (reverbEnabled)
+			{
+				std::fill(sendBuffer.begin(), sendBuffer.begin() + numVoiceSamples, 0.0f);
+			}
+
+			if (ambisonicBus.IsEnabled())
+			{
+				ambisonicBus.Begin(mixVoices3D->listenerRotation, framesPerBuffer);
+			}
+
+			if (reflections)
+			{
+				earlyReflections.Begin(framesPerBuffer);
+			}
+
+			// sidechain buses of the ducked buses are measured in this mix
+			bool sidechains = false;
+			for (auto& bus : buses)
+			{
+				if (bus.sidechain)
+				{
+					bus.sidechain->sidechainMix = mixCount;
+					bus.sidechain->sidechainPeak = 0.0f;
+					sidechains = true;
+				}
+			}
+
+			// the sounds of the sidechains go first, so the buses they duck follow them in the same buffer
+			if (sidechains)
+			{
+				WriteVoices(true, framesPerBuffer);
+			}
+			for (auto& bus : buses)
+			{
+				bus.UpdateDucking(framesPerBuffer, mixCount);
+			}
+			WriteVoices(false, framesPerBuffer);
+
+			if (ambisonicBus.IsEnabled())
+			{
+				ambisonicBus.Decode(mixBuffer.data(), mixStride, framesPerBuffer);
+			}
+
+			earlyReflections.End(mixBuffer.data(), mixStride, framesPerBuffer);
+
+			if (reverbEnabled)
+			{
+				// the tail is stereo: played on the front pair of the multichannel layouts
+				float* reverbOut = mixBuffer.data();
+				if (speakerMix)
+				{
+					std::fill(voiceBuffer.begin(), voiceBuffer.begin() + numVoiceSamples, 0.0f);
+					reverbOut = voiceBuffer.data();
+				}
+
+				// measured impulse response, or the feedback delay network
+				if (!convolutionReverb.Process(sendBuffer.data(), reverbOut, framesPerBuffer, reverb.GetWetGain()))
+				{
+					reverb.Process(sendBuffer.data(), reverbOut, TxikiAudioSound::NUM_CHANNELS, framesPerBuffer);
+				}
+
+				if (speakerMix)
+				{
+					speakers.MixStereo(voiceBuffer.data(), framesPerBuffer, mixBuffer.data());
+				}
+			}
+
+			// keep the mix under full scale before it is converted
+			masterDynamics.SetSettings(masterDynamicsSettings.Read());
+			masterDynamics.Process(mixBuffer.data(), framesPerBuffer);
+
+			// convert to the output format (Note: We are using PCM16 format! Clamped in case the limiter is off)
 			short* outBuffer = static_cast<short*>(outputBuffer);
-			std::memset(outputBuffer, 0, sizeof(short) * framesPerBuffer * TxikiAudioSound::NUM_CHANNELS);
+			size_t numChannels = speakers.GetNumChannels();
+			for (size_t frame = 0; frame < framesPerBuffer; frame++)
+			{
+				for (size_t channel = 0; channel < numChannels; channel++)
+				{
+					float sample = std::max(-1.0f, std::min(1.0f, mixBuffer[frame * mixStride + channel]));
+					outBuffer[frame * numChannels + channel] = static_cast<short>(sample * 32767.0f);
+				}
+			}
+
+			mixesDone.fetch_add(1, std::memory_order_release);
+		}
+
+		// Audio thread: write the sounds of the sidechain buses, or the rest of them.
+		// The filtered ones are written 4 at a time, so their filters run side by side.
+		void WriteVoices(bool sidechainVoices, size_t framesPerBuffer)
+		{
+			bool speakerMix = speakers.GetLayout() != TxikiAudioOutputLayout::STEREO;
+			size_t numVoiceSamples = framesPerBuffer * TxikiAudioSound::NUM_CHANNELS;
 
-			// write sounds
+			size_t numFiltered = 0;
 			for (auto& sound : sounds)
 			{
-				sound.WriteSound(outBuffer, framesPerBuffer);
+				bool sidechain = sound.bus && sound.bus->IsSidechain(mixCount);
+				if (sidechain != sidechainVoices)
+				{
+					continue;
+				}
+
+				bool is3DMix = sound.is3D && sound.gains3DMix == mixCount;
+				float lowPassCutoff = is3DMix ? std::min(sound.filter.lowPassCutoff, sound.targetLowPassCutoff) : sound.filter.lowPassCutoff;
+				if (sound.state == TxikiAudioSound::State::PLAYING && TxikiAudioBiquads::IsActive(lowPassCutoff, sound.filter.highPassCutoff))
+				{
+					filteredSounds[numFiltered] = &sound;
+					lowPassCutoffs[numFiltered] = lowPassCutoff;
+					highPassCutoffs[numFiltered] = sound.filter.highPassCutoff;
+					if (++numFiltered == TxikiAudioBiquads::NUM_LANES)
+					{
+						WriteFilteredSounds(numFiltered, framesPerBuffer);
+						numFiltered = 0;
+					}
+					continue;
+				}
+
+				bool reverbSend = mixReverb && (sound.reverbSend > 0.0f || sound.mixReverbSend > 0.0f);
+				bool writeAlone = (is3DMix && (ambisonicBus.IsEnabled() || sound.hrtfSlot >= 0 || mixReflections)) || reverbSend || sidechain;
+				if (!speakerMix && !writeAlone)
+				{
+					sound.WriteSound(mixBuffer.data(), framesPerBuffer, mixCount, mixTime);
+					continue;
+				}
+
+				// write the voice alone, then place it in the mix
+				std::fill(voiceBuffer.begin(), voiceBuffer.begin() + numVoiceSamples, 0.0f);
+				sound.WriteSound(voiceBuffer.data(), framesPerBuffer, mixCount, mixTime);
+				MixVoice(sound, voiceBuffer.data(), framesPerBuffer);
+			}
+			WriteFilteredSounds(numFiltered, framesPerBuffer);
+		}
+
+		// Audio thread: place a voice written alone in the mix
+		void MixVoice(TxikiAudioSound& sound, const float* voice, size_t framesPerBuffer)
+		{
+			bool is3DMix = sound.is3D && sound.gains3DMix == mixCount;
+			bool speakerMix = speakers.GetLayout() != TxikiAudioOutputLayout::STEREO;
+			bool reverbSend = mixReverb && (sound.reverbSend > 0.0f || sound.mixReverbSend > 0.0f);
+			size_t numVoiceSamples = framesPerBuffer * TxikiAudioSound::NUM_CHANNELS;
+
+			if (sound.bus && sound.bus->IsSidechain(mixCount))
+			{
+				sound.bus->AddSidechainPeak(TxikiAudioSIMD::Peak(voice, numVoiceSamples), mixCount);
+			}
+
+			if (is3DMix && ambisonicBus.IsEnabled())
+			{
+				if (sound.ambisonicMix + 1 != mixCount)
+				{
+					// not encoded in the last buffer: no ramp
+					std::copy(sound.targetAmbisonicGains, sound.targetAmbisonicGains + ambisonicBus.GetNumChannels(), sound.ambisonicGains);
+				}
+				sound.ambisonicMix = mixCount;
+
+				ambisonicBus.Encode(voice, TxikiAudioSound::NUM_CHANNELS, framesPerBuffer, sound.targetAmbisonicGains, sound.ambisonicGains);
+			}
+			else if (is3DMix && speakerMix)
+			{
+				if (sound.speakerMix + 1 != mixCount)
+				{
+					// not mixed in the last buffer: no ramp
+					std::copy(sound.targetSpeakerGains, sound.targetSpeakerGains + speakers.GetMixStride(), sound.speakerGains);
+				}
+				sound.speakerMix = mixCount;
+
+				speakers.MixMono(voice, TxikiAudioSound::NUM_CHANNELS, framesPerBuffer, sound.targetSpeakerGains, sound.speakerGains, mixBuffer.data());
+			}
+			else if (speakerMix)
+			{
+				speakers.MixStereo(voice, framesPerBuffer, mixBuffer.data());
+			}
+			else if (sound.hrtfSlot >= 0)
+			{
+				// binaural
+				hrtf.Process(sound.hrtfSlot, voice, mixBuffer.data(), framesPerBuffer);
+			}
+			else if (!is3DMix || !mixReflections)
+			{
+				// already panned by its gains
+				for (size_t i = 0; i < numVoiceSamples; i++)
+				{
+					mixBuffer[i] += voice[i];
+				}
+			}
+			else
+			{
+				if (sound.speakerMix + 1 != mixCount)
+				{
+					// not panned in the last buffer: no ramp
+					std::copy(sound.targetSpeakerGains, sound.targetSpeakerGains + TxikiAudioSound::NUM_CHANNELS, sound.speakerGains);
+				}
+				sound.speakerMix = mixCount;
+
+				TxikiAudioSpeakers::PanStereo(voice, TxikiAudioSound::NUM_CHANNELS, framesPerBuffer, sound.targetSpeakerGains, sound.speakerGains, mixBuffer.data());
+			}
+
+			if (is3DMix && mixReflections)
+			{
+				earlyReflections.Mix(sound, *mixVoices3D, sound.voice3D, voice, TxikiAudioSound::NUM_CHANNELS, framesPerBuffer, mixCount);
+			}
+
+			if (reverbSend)
+			{
+				// ramped from the send level of the last buffer
+				float send = sound.mixReverbSend;
+				float step = (sound.reverbSend - send) / float(std::max(framesPerBuffer, size_t(1)));
+				for (size_t frame = 0; frame < framesPerBuffer; frame++)
+				{
+					sendBuffer[frame * 2] += voice[frame * 2] * send;
+					sendBuffer[frame * 2 + 1] += voice[frame * 2 + 1] * send;
+					send += step;
+				}
+				sound.mixReverbSend = sound.reverbSend;
+			}
+		}
+
+		// Audio thread: write the filtered sounds alone, filter them side by side and place them in the mix
+		void WriteFilteredSounds(size_t numSounds, size_t framesPerBuffer)
+		{
+			size_t numVoiceSamples = framesPerBuffer * TxikiAudioSound::NUM_CHANNELS;
+			float* voices[TxikiAudioBiquads::NUM_LANES];
+			TxikiAudioBiquadState* states[TxikiAudioBiquads::NUM_LANES];
+			for (size_t i = 0; i < numSounds; i++)
+			{
+				TxikiAudioSound& sound = *filteredSounds[i];
+				voices[i] = &laneBuffer[i * numVoiceSamples];
+				std::fill(voices[i], voices[i] + numVoiceSamples, 0.0f);
+				sound.WriteSound(voices[i], framesPerBuffer, mixCount, mixTime);
+
+				if (sound.biquadMix + 1 != mixCount)
+				{
+					// not filtered in the last buffer: start from silence
+					sound.biquadState.Reset();
+				}
+				sound.biquadMix = mixCount;
+				states[i] = &sound.biquadState;
+			}
+
+			if (numSounds > 0)
+			{
+				TxikiAudioBiquads::Process(voices, states, lowPassCutoffs, highPassCutoffs, numSounds, framesPerBuffer);
+			}
+
+			for (size_t i = 0; i < numSounds; i++)
+			{
+				MixVoice(*filteredSounds[i], voices[i], framesPerBuffer);
 			}
 		}
 
   private:
 
+    // Note: soundsMutex must be locked
+    TxikiAudioSound* NewSound()
+    {
+      // reuse a not used sound
+      for (auto& s : sounds)
+      {
+        if (!s.IsLoaded())
+        {
+          return &s;
+        }
+      }
+
+      printf("Error: Unable to load sound. All the %zu sounds are in use\n", sounds.size());
+      return nullptr;
+    }
+
+    // Wait until a mix has started and finished after the call, so the sounds stopped before it are no longer mixed
+    void WaitForMix() const
+    {
+      uint64_t mix = mixesDone.load(std::memory_order_acquire);
+      while (mixesDone.load(std::memory_order_acquire) < mix + 2 && stream_PCM16 && Pa_IsStreamActive(stream_PCM16) == 1)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+    // Read the sound file, or open it for streaming. It can be called from several threads at once.
+    bool ReadSound(const std::string& soundName, const TxikiAudioSoundMode& mode, TxikiAudioSoundDesc& outSoundDesc, std::unique_ptr<TxikiAudioStream>& outStream) const
+    {
+      if (mode.stream)
+      {
+        outStream = soundLoader.LoadStream(soundName, config.streamConfig, mode.loop);
+        return outStream != nullptr;
+      }
+
+      return soundLoader.LoadSound(soundName, outSoundDesc);
+    }
+
+    // Note: soundsMutex must be locked
+    void SetSound(TxikiAudioSoundDesc& soundDesc, std::unique_ptr<TxikiAudioStream> stream, const TxikiAudioSoundMode& mode, TxikiAudioSound& outSound)
+    {
+      outSound.loop = mode.loop;
+
+      if (stream)
+      {
+        streamer.AddStream(stream.get());
+        soundLoader.SetSoundData(std::move(stream), outSound);
+      }
+      else
+      {
+        soundLoader.SetSoundData(soundDesc, outSound);
+      }
+    }
+
     static int WriteSoundCallback(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData)
     {
 			TxikiAudio* txikiAudio = static_cast<TxikiAudio*>(userData);
-			txikiAudio->WriteSounds(outputBuffer, framesPerBuffer);
+
+			// Note: some host APIs do not report the DAC time, so it is the stream time plus the output latency, as the game thread sees it
+			double outputTime = timeInfo && timeInfo->outputBufferDacTime > 0.0 ? timeInfo->outputBufferDacTime : txikiAudio->GetOutputTime();
+			txikiAudio->WriteSounds(outputBuffer, framesPerBuffer, outputTime);
 
 			return 0;
     }
 
-		bool StartStream()
+		bool OpenStream()
 		{
 			if (!stream_PCM16)
 			{
+				speakers.Init(config.outputLayout);
+
 				int inputChannels = 0;
-				int outputChannels = TxikiAudioSound::NUM_CHANNELS;
 				PaSampleFormat sampleFormat = static_cast<PaSampleFormat>(TxikiAudioSoundFormat::PCM16);
 				size_t sampleRate = (size_t)TxikiAudioSoundSampleRate::SampleRate_44100Hz;
 				auto framesPerBuffer = paFramesPerBufferUnspecified; // PortAudio will pick the best possible buffer size
 
 				// Open default stream to play the audio
-				PaError result = Pa_OpenDefaultStream(&stream_PCM16, inputChannels, outputChannels, sampleFormat, sampleRate, framesPerBuffer, WriteSoundCallback, this);
-				if (result != paNoError)
+				PaError result = Pa_OpenDefaultStream(&stream_PCM16, inputChannels, int(speakers.GetNumChannels()), sampleFormat, sampleRate, framesPerBuffer, WriteSoundCallback, this);
+				if (result != paNoError && speakers.GetLayout() != TxikiAudioOutputLayout::STEREO)
 				{
-					printf("TxikiAudio unable to open PortAudio stream. PortAudio error: %s\n", Pa_GetErrorText(result));
-					return false;
+					printf("TxikiAudio unable to open a %zu channels stream, using stereo. PortAudio error: %s\n", speakers.GetNumChannels(), Pa_GetErrorText(result));
+
+					speakers.Init(TxikiAudioOutputLayout::STEREO);
+					result = Pa_OpenDefaultStream(&stream_PCM16, inputChannels, int(speakers.GetNumChannels()), sampleFormat, sampleRate, framesPerBuffer, WriteSoundCallback, this);
 				}
 
-				// Start audio stream
-				result = Pa_StartStream(stream_PCM16);
 				if (result != paNoError)
 				{
-					printf("TxikiAudio unable to PlaySound. PortAudio error: %s\n", Pa_GetErrorText(result));
+					printf("TxikiAudio unable to open PortAudio stream. PortAudio error: %s\n", Pa_GetErrorText(result));
 					return false;
 				}
 			}
 
 			return true;
 		}
+
+		bool StartStream()
+		{
+			if (!stream_PCM16)
+			{
+				return false;
+			}
+
+			// Start audio stream
+			PaError result = Pa_StartStream(stream_PCM16);
+			if (result != paNoError)
+			{
+				printf("TxikiAudio unable to PlaySound. PortAudio error: %s\n", Pa_GetErrorText(result));
+				return false;
+			}
+
+			return true;
+		}
 };
 
 #endif // !TXIKI_AUDIO_H
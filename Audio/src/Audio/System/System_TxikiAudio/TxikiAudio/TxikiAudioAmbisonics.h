@@ -0,0 +1,510 @@
+#ifndef TXIKI_AUDIO_AMBISONICS_H
+#define TXIKI_AUDIO_AMBISONICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "TxikiAudioConvolver.h"
+#include "TxikiAudioHRTF.h"
+#include "TxikiAudioSpeakers.h"
+
+// Ambisonics in ACN channel order with SN3D normalisation.
+// Directions are in ambisonic coordinates: +X front, +Y left, +Z up.
+namespace TxikiAudioAmbisonics
+{
+  static const size_t MAX_ORDER = 3;
+  static const size_t MAX_CHANNELS = (MAX_ORDER + 1) * (MAX_ORDER + 1);
+
+  inline size_t GetNumChannels(size_t order)
+  {
+    return (order + 1) * (order + 1);
+  }
+
+  inline size_t GetChannelOrder(size_t channel)
+  {
+    size_t order = 0;
+    while ((order + 1) * (order + 1) <= channel)
+    {
+      order++;
+    }
+
+    return order;
+  }
+
+  // Encoding gains of a unit direction. T is float, or TxikiAudioFloat4 to encode 4 directions at once.
+  template <typename T>
+  void Encode(const T& x, const T& y, const T& z, size_t order, T* out)
+  {
+    out[0] = x * 0.0f + 1.0f;
+    if (order < 1)
+    {
+      return;
+    }
+
+    out[1] = y;
+    out[2] = z;
+    out[3] = x;
+    if (order < 2)
+    {
+      return;
+    }
+
+    const float sqrt3 = 1.7320508f;
+    T xx = x * x;
+    T yy = y * y;
+    T zz = z * z;
+    out[4] = x * y * sqrt3;
+    out[5] = y * z * sqrt3;
+    out[6] = zz * 1.5f - 0.5f;
+    out[7] = x * z * sqrt3;
+    out[8] = (xx - yy) * (sqrt3 * 0.5f);
+    if (order < 3)
+    {
+      return;
+    }
+
+    const float sqrt5_8 = 0.7905694f;
+    const float sqrt15 = 3.8729833f;
+    const float sqrt3_8 = 0.6123724f;
+    out[9] = y * (xx * 3.0f - yy) * sqrt5_8;
+    out[10] = x * y * z * sqrt15;
+    out[11] = y * (zz * 5.0f - 1.0f) * sqrt3_8;
+    out[12] = z * (zz * 5.0f - 3.0f) * 0.5f;
+    out[13] = x * (zz * 5.0f - 1.0f) * sqrt3_8;
+    out[14] = z * (xx - yy) * (sqrt15 * 0.5f);
+    out[15] = x * (xx - yy * 3.0f) * sqrt5_8;
+  }
+
+  // TxikiAudioAmbisonics::Rotation
+  //
+  // Rotation of a sound field, from a 3x3 rotation matrix (Ivanic and Ruedenberg recursion).
+  // The matrix is block diagonal: the channels of an order only mix with each other.
+  class Rotation
+  {
+  public:
+
+    Rotation()
+    {
+      SetIdentity();
+    }
+
+    void SetIdentity()
+    {
+      std::fill(&matrix[0][0], &matrix[0][0] + MAX_CHANNELS * MAX_CHANNELS, 0.0f);
+      for (size_t i = 0; i < MAX_CHANNELS; i++)
+      {
+        matrix[i][i] = 1.0f;
+      }
+    }
+
+    // rotation[row][column] maps ambisonic coordinates (x, y, z)
+    void Set(const float rotation[3][3], size_t order)
+    {
+      SetIdentity();
+      if (order < 1)
+      {
+        return;
+      }
+
+      // order 1 is the rotation itself, in channel order (y, z, x)
+      static const size_t axis[3] = { 1, 2, 0 };
+      for (int m = -1; m <= 1; m++)
+      {
+        for (int n = -1; n <= 1; n++)
+        {
+          At(1, m, n) = rotation[axis[m + 1]][axis[n + 1]];
+        }
+      }
+
+      for (int l = 2; l <= int(order); l++)
+      {
+        for (int m = -l; m <= l; m++)
+        {
+          for (int n = -l; n <= l; n++)
+          {
+            float d = m == 0 ? 1.0f : 0.0f;
+            float denominator = std::abs(n) < l ? float((l + n) * (l - n)) : float((2 * l) * (2 * l - 1));
+            int absM = std::abs(m);
+
+            float u = std::sqrt(float((l + m) * (l - m)) / denominator);
+            float v = 0.5f * std::sqrt((1.0f + d) * float((l + absM - 1) * (l + absM)) / denominator) * (1.0f - 2.0f * d);
+            float w = -0.5f * std::sqrt(float(std::max(0, (l - absM - 1) * (l - absM))) / denominator) * (1.0f - d);
+
+            float value = 0.0f;
+            if (u != 0.0f)
+            {
+              value += u * U(l, m, n);
+            }
+            if (v != 0.0f)
+            {
+              value += v * V(l, m, n);
+            }
+            if (w != 0.0f)
+            {
+              value += w * W(l, m, n);
+            }
+
+            At(l, m, n) = value;
+          }
+        }
+      }
+    }
+
+    float matrix[MAX_CHANNELS][MAX_CHANNELS];
+
+  private:
+
+    float& At(int l, int m, int n)
+    {
+      return matrix[l * l + l + m][l * l + l + n];
+    }
+
+    float P(int i, int l, int a, int b)
+    {
+      float ri1 = At(1, i, 1);
+      float rim1 = At(1, i, -1);
+      float ri0 = At(1, i, 0);
+
+      if (b == -l)
+      {
+        return ri1 * At(l - 1, a, -l + 1) + rim1 * At(l - 1, a, l - 1);
+      }
+
+      if (b == l)
+      {
+        return ri1 * At(l - 1, a, l - 1) - rim1 * At(l - 1, a, -l + 1);
+      }
+
+      return ri0 * At(l - 1, a, b);
+    }
+
+    float U(int l, int m, int n)
+    {
+      return P(0, l, m, n);
+    }
+
+    float V(int l, int m, int n)
+    {
+      if (m == 0)
+      {
+        return P(1, l, 1, n) + P(-1, l, -1, n);
+      }
+
+      if (m > 0)
+      {
+        float d = m == 1 ? 1.0f : 0.0f;
+        return P(1, l, m - 1, n) * std::sqrt(1.0f + d) - P(-1, l, -m + 1, n) * (1.0f - d);
+      }
+
+      float d = m == -1 ? 1.0f : 0.0f;
+      return P(1, l, m + 1, n) * (1.0f - d) + P(-1, l, -m - 1, n) * std::sqrt(1.0f + d);
+    }
+
+    float W(int l, int m, int n)
+    {
+      if (m > 0)
+      {
+        return P(1, l, m + 1, n) + P(-1, l, -m - 1, n);
+      }
+
+      return P(1, l, m - 1, n) - P(-1, l, -m + 1, n);
+    }
+  };
+}
+
+// TxikiAudioAmbisonicBus
+//
+// 3D voices encoded into one sound field, rotated by the listener orientation and decoded once per buffer.
+// The decoding cost does not depend on the number of voices.
+class TxikiAudioAmbisonicBus
+{
+public:
+
+  static_assert(TxikiAudioAmbisonics::MAX_CHANNELS == TxikiAudioSound::MAX_AMBISONIC_CHANNELS, "ambisonic channels mismatch");
+
+  // Decoded to the speakers of multichannel layouts. In stereo, to binaural when there are HRIRs, to stereo otherwise.
+  void Init(size_t order_, const TxikiAudioSpeakers& outputSpeakers, const TxikiAudioHRIRSet& hrirs, size_t blockSize)
+  {
+    order = std::min(order_, TxikiAudioAmbisonics::MAX_ORDER);
+    numChannels = TxikiAudioAmbisonics::GetNumChannels(order);
+
+    if (order == 0)
+    {
+      return;
+    }
+
+    if (outputSpeakers.GetLayout() != TxikiAudioOutputLayout::STEREO)
+    {
+      InitSpeakers(outputSpeakers);
+    }
+    else if (hrirs.IsLoaded())
+    {
+      InitBinaural(hrirs, blockSize);
+    }
+  }
+
+  bool IsEnabled() const { return order > 0; }
+  size_t GetNumChannels() const { return numChannels; }
+
+  // Audio thread: start a buffer with the listener orientation (rotation of ambisonic coordinates)
+  void Begin(const float listenerRotation[3][3], size_t frames)
+  {
+    if (frames > maxFrames)
+    {
+      maxFrames = frames;
+      field.resize(numChannels * maxFrames);
+      rotated.resize(numChannels * maxFrames);
+      previousRotated.resize(numChannels * maxFrames);
+      speakerFeed.resize(maxFrames);
+    }
+    std::fill(field.begin(), field.end(), 0.0f);
+
+    // the rotation is crossfaded when the listener turns
+    rotationChanged = !hasRotation || !std::equal(&listenerRotation[0][0], &listenerRotation[0][0] + 9, &currentListenerRotation[0][0]);
+    if (rotationChanged)
+    {
+      previousRotation = rotation;
+      std::copy(&listenerRotation[0][0], &listenerRotation[0][0] + 9, &currentListenerRotation[0][0]);
+      rotation.Set(currentListenerRotation, order);
+      rotationChanged = hasRotation;
+      hasRotation = true;
+    }
+  }
+
+  // Audio thread: add a voice (one sample every inStride floats), ramping its encoding gains to the target ones
+  void Encode(const float* in, size_t inStride, size_t frames, const float* targetGains, float* gains)
+  {
+    float framesInverse = 1.0f / float(std::max(frames, size_t(1)));
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+      float gain = gains[channel];
+      float step = (targetGains[channel] - gain) * framesInverse;
+      float* out = &field[channel * maxFrames];
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        out[frame] += in[frame * inStride] * gain;
+        gain += step;
+      }
+
+      gains[channel] = targetGains[channel];
+    }
+  }
+
+  // Audio thread: rotate and decode the sound field into the interleaved out (outStride floats per frame)
+  void Decode(float* out, size_t outStride, size_t frames)
+  {
+    Rotate(rotation, rotated, frames);
+    if (rotationChanged)
+    {
+      Rotate(previousRotation, previousRotated, frames);
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        float* to = &rotated[channel * maxFrames];
+        const float* from = &previousRotated[channel * maxFrames];
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+          float t = float(frame + 1) / float(frames);
+          to[frame] = from[frame] + (to[frame] - from[frame]) * t;
+        }
+      }
+    }
+
+    if (!speakerDecodeGains.empty())
+    {
+      // multichannel: one decoding row per speaker
+      size_t numSpeakers = speakerDecodeGains.size() / numChannels;
+      for (size_t speaker = 0; speaker < numSpeakers; speaker++)
+      {
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+          float gain = speakerDecodeGains[speaker * numChannels + channel];
+          if (gain == 0.0f)
+          {
+            continue;
+          }
+
+          const float* in = &rotated[channel * maxFrames];
+          for (size_t frame = 0; frame < frames; frame++)
+          {
+            out[frame * outStride + speaker] += in[frame] * gain;
+          }
+        }
+      }
+      return;
+    }
+
+    if (speakers.empty())
+    {
+      // stereo: virtual cardioids pointing left and right
+      const float* w = &rotated[0];
+      const float* y = &rotated[maxFrames];
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        out[frame * outStride] += 0.5f * (w[frame] + y[frame]);
+        out[frame * outStride + 1] += 0.5f * (w[frame] - y[frame]);
+      }
+      return;
+    }
+
+    // binaural: virtual speakers around the head, each convolved with the HRIRs of its direction
+    for (auto& speaker : speakers)
+    {
+      std::fill(speakerFeed.begin(), speakerFeed.begin() + frames, 0.0f);
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        float gain = speaker.decodeGains[channel];
+        const float* in = &rotated[channel * maxFrames];
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+          speakerFeed[frame] += in[frame] * gain;
+        }
+      }
+
+      speaker.convolver.Process(speakerFeed.data(), 1, out, frames);
+    }
+  }
+
+private:
+
+  // Horizontal layouts: circular harmonics sampled at the speakers, with max rE weights
+  void InitSpeakers(const TxikiAudioSpeakers& outputSpeakers)
+  {
+    size_t numSpeakers = outputSpeakers.GetNumChannels();
+    size_t numRingSpeakers = 0;
+    for (size_t speaker = 0; speaker < numSpeakers; speaker++)
+    {
+      numRingSpeakers += outputSpeakers.GetSpeaker(speaker).lfe ? 0 : 1;
+    }
+
+    // SN3D gain of the sectoral channels on the horizon, squared
+    static const float sectoralNorm[TxikiAudioAmbisonics::MAX_ORDER + 1] = { 1.0f, 1.0f, 0.75f, 0.625f };
+
+    speakerDecodeGains.assign(numSpeakers * numChannels, 0.0f);
+    for (size_t speaker = 0; speaker < numSpeakers; speaker++)
+    {
+      const TxikiAudioSpeakers::Speaker& speakerDesc = outputSpeakers.GetSpeaker(speaker);
+      if (speakerDesc.lfe)
+      {
+        continue;
+      }
+
+      float* gains = &speakerDecodeGains[speaker * numChannels];
+      gains[0] = 1.0f / float(numRingSpeakers);
+      if (numRingSpeakers == 1)
+      {
+        // mono: omnidirectional only
+        continue;
+      }
+
+      float azimuth = speakerDesc.azimuth * 3.14159265f / 180.0f;
+      float encodeGains[TxikiAudioAmbisonics::MAX_CHANNELS];
+      TxikiAudioAmbisonics::Encode(std::cos(azimuth), std::sin(azimuth), 0.0f, order, encodeGains);
+
+      for (size_t l = 1; l <= order; l++)
+      {
+        float weight = std::cos(float(l) * 3.14159265f / float(2 * order + 2));
+        size_t first = l * l;
+        size_t last = (l + 1) * (l + 1) - 1;
+        gains[first] = 2.0f * weight * encodeGains[first] / (sectoralNorm[l] * float(numRingSpeakers));
+        gains[last] = 2.0f * weight * encodeGains[last] / (sectoralNorm[l] * float(numRingSpeakers));
+      }
+    }
+  }
+
+  void InitBinaural(const TxikiAudioHRIRSet& hrirs, size_t blockSize)
+  {
+    size_t length = hrirs.GetLength();
+    std::vector<float> left(length);
+    std::vector<float> right(length);
+
+    // max rE weights, so the energy is focused in the direction of the sound
+    float orderWeights[TxikiAudioAmbisonics::MAX_ORDER + 1];
+    float c = std::cos(2.4066f / (float(order) + 1.51f)); // 137.9 degrees
+    orderWeights[0] = 1.0f;
+    orderWeights[1] = c;
+    orderWeights[2] = 0.5f * (3.0f * c * c - 1.0f);
+    orderWeights[3] = 0.5f * (5.0f * c * c * c - 3.0f * c);
+
+    // speakers spread evenly on a sphere (Fibonacci lattice)
+    size_t numSpeakers = 2 * numChannels;
+    speakers.resize(numSpeakers);
+    for (size_t i = 0; i < numSpeakers; i++)
+    {
+      float z = 1.0f - 2.0f * (float(i) + 0.5f) / float(numSpeakers);
+      float radius = std::sqrt(1.0f - z * z);
+      float angle = 2.3999632f * float(i); // golden angle
+      float x = radius * std::cos(angle);
+      float y = radius * std::sin(angle);
+
+      Speaker& speaker = speakers[i];
+      float encodeGains[TxikiAudioAmbisonics::MAX_CHANNELS];
+      TxikiAudioAmbisonics::Encode(x, y, z, order, encodeGains);
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        size_t channelOrder = TxikiAudioAmbisonics::GetChannelOrder(channel);
+        speaker.decodeGains[channel] = encodeGains[channel] * float(2 * channelOrder + 1) * orderWeights[channelOrder] / float(numSpeakers);
+      }
+
+      // HRIRs in listener space: +X right, +Y up, +Z forward
+      hrirs.Interpolate(-y, z, x, left.data(), right.data());
+      speaker.convolver.Init(blockSize, (length + blockSize - 1) / blockSize);
+      speaker.filter.Set(speaker.convolver.GetFFT(), left.data(), right.data(), length, blockSize);
+      speaker.convolver.SetFilter(&speaker.filter);
+    }
+  }
+
+  void Rotate(const TxikiAudioAmbisonics::Rotation& fieldRotation, std::vector<float>& outField, size_t frames)
+  {
+    // block diagonal: the channels of an order only mix with each other
+    for (size_t l = 0; l <= order; l++)
+    {
+      size_t first = l * l;
+      size_t last = (l + 1) * (l + 1);
+      for (size_t row = first; row < last; row++)
+      {
+        float* out = &outField[row * maxFrames];
+        std::fill(out, out + frames, 0.0f);
+        for (size_t column = first; column < last; column++)
+        {
+          float gain = fieldRotation.matrix[row][column];
+          const float* in = &field[column * maxFrames];
+          for (size_t frame = 0; frame < frames; frame++)
+          {
+            out[frame] += in[frame] * gain;
+          }
+        }
+      }
+    }
+  }
+
+  size_t order{ 0 };
+  size_t numChannels{ 1 };
+
+  // channel after channel, maxFrames each
+  std::vector<float> field;
+  std::vector<float> rotated;
+  std::vector<float> previousRotated;
+  size_t maxFrames{ 0 };
+
+  TxikiAudioAmbisonics::Rotation rotation;
+  TxikiAudioAmbisonics::Rotation previousRotation;
+  float currentListenerRotation[3][3];
+  bool hasRotation{ false };
+  bool rotationChanged{ false };
+
+  struct Speaker
+  {
+    float decodeGains[TxikiAudioAmbisonics::MAX_CHANNELS];
+    TxikiAudioConvolver convolver;
+    TxikiAudioConvolverFilter filter;
+  };
+
+  std::vector<Speaker> speakers;
+  std::vector<float> speakerFeed;
+
+  // or decoding gains of the output speakers, one row per speaker
+  std::vector<float> speakerDecodeGains;
+};
+
+#endif // !TXIKI_AUDIO_AMBISONICS_H
@@ -0,0 +1,179 @@
+#ifndef TXIKI_AUDIO_BIQUADS_H
+#define TXIKI_AUDIO_BIQUADS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioSIMD.h"
+
+// Biquad state of a stereo voice: low-pass then high-pass section, 2 delays per channel
+struct TxikiAudioBiquadState
+{
+  static const size_t NUM_SECTIONS = 2;
+
+  float z[NUM_SECTIONS][2][2];
+
+  void Reset()
+  {
+    std::fill(&z[0][0][0], &z[0][0][0] + NUM_SECTIONS * 2 * 2, 0.0f);
+  }
+};
+
+// TxikiAudioBiquads
+//
+// Low-pass and high-pass filters of the voices, in transposed direct form II.
+// Voices are filtered 4 at a time, one per lane. The coefficients are computed once per buffer.
+class TxikiAudioBiquads
+{
+public:
+
+  static const size_t NUM_LANES = TxikiAudioSIMD::WIDTH;
+
+  // cutoffs out of these limits leave the sound as it is
+  static constexpr float MAX_LOW_PASS_CUTOFF = 20000.0f;
+  static constexpr float MIN_HIGH_PASS_CUTOFF = 20.0f;
+
+  static bool IsActive(float lowPassCutoff, float highPassCutoff)
+  {
+    return lowPassCutoff < MAX_LOW_PASS_CUTOFF || highPassCutoff > MIN_HIGH_PASS_CUTOFF;
+  }
+
+  // Filter up to 4 stereo interleaved voices of frames in place
+  static void Process(float* const* voices, TxikiAudioBiquadState* const* states, const float* lowPassCutoffs, const float* highPassCutoffs, size_t numVoices, size_t frames)
+  {
+    using namespace TxikiAudioSIMD;
+
+    // coefficients b0 b1 b2 a1 a2 of each section, one lane per voice. The lanes left are silent.
+    float coefficients[TxikiAudioBiquadState::NUM_SECTIONS][5][NUM_LANES];
+    bool sectionActive[TxikiAudioBiquadState::NUM_SECTIONS]{ false, false };
+    float* lanes[NUM_LANES];
+    size_t laneStrides[NUM_LANES];
+    float silence[2]{ 0.0f, 0.0f };
+
+    for (size_t lane = 0; lane < NUM_LANES; lane++)
+    {
+      bool used = lane < numVoices;
+      lanes[lane] = used ? voices[lane] : silence;
+      laneStrides[lane] = used ? 2 : 0;
+
+      float section[5];
+      bool lowPass = used && lowPassCutoffs[lane] < MAX_LOW_PASS_CUTOFF;
+      GetCoefficients(lowPass, true, lowPass ? lowPassCutoffs[lane] : 0.0f, section);
+      sectionActive[0] |= lowPass;
+      for (size_t k = 0; k < 5; k++)
+      {
+        coefficients[0][k][lane] = section[k];
+      }
+
+      bool highPass = used && highPassCutoffs[lane] > MIN_HIGH_PASS_CUTOFF;
+      GetCoefficients(highPass, false, highPass ? highPassCutoffs[lane] : 0.0f, section);
+      sectionActive[1] |= highPass;
+      for (size_t k = 0; k < 5; k++)
+      {
+        coefficients[1][k][lane] = section[k];
+      }
+    }
+
+    TxikiAudioFloat4 b0[TxikiAudioBiquadState::NUM_SECTIONS], b1[TxikiAudioBiquadState::NUM_SECTIONS], b2[TxikiAudioBiquadState::NUM_SECTIONS];
+    TxikiAudioFloat4 a1[TxikiAudioBiquadState::NUM_SECTIONS], a2[TxikiAudioBiquadState::NUM_SECTIONS];
+    TxikiAudioFloat4 z1[TxikiAudioBiquadState::NUM_SECTIONS][2], z2[TxikiAudioBiquadState::NUM_SECTIONS][2];
+    for (size_t s = 0; s < TxikiAudioBiquadState::NUM_SECTIONS; s++)
+    {
+      b0[s] = Load(coefficients[s][0]);
+      b1[s] = Load(coefficients[s][1]);
+      b2[s] = Load(coefficients[s][2]);
+      a1[s] = Load(coefficients[s][3]);
+      a2[s] = Load(coefficients[s][4]);
+
+      for (size_t channel = 0; channel < 2; channel++)
+      {
+        float delays[2][NUM_LANES];
+        for (size_t lane = 0; lane < NUM_LANES; lane++)
+        {
+          delays[0][lane] = lane < numVoices ? states[lane]->z[s][channel][0] : 0.0f;
+          delays[1][lane] = lane < numVoices ? states[lane]->z[s][channel][1] : 0.0f;
+        }
+        z1[s][channel] = Load(delays[0]);
+        z2[s][channel] = Load(delays[1]);
+      }
+    }
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      for (size_t channel = 0; channel < 2; channel++)
+      {
+        float* samples[NUM_LANES];
+        for (size_t lane = 0; lane < NUM_LANES; lane++)
+        {
+          samples[lane] = &lanes[lane][frame * laneStrides[lane] + channel];
+        }
+
+        TxikiAudioFloat4 x(*samples[0], *samples[1], *samples[2], *samples[3]);
+        for (size_t s = 0; s < TxikiAudioBiquadState::NUM_SECTIONS; s++)
+        {
+          if (!sectionActive[s])
+          {
+            continue;
+          }
+
+          TxikiAudioFloat4 y = b0[s] * x + z1[s][channel];
+          z1[s][channel] = b1[s] * x - a1[s] * y + z2[s][channel];
+          z2[s][channel] = b2[s] * x - a2[s] * y;
+          x = y;
+        }
+
+        *samples[0] = x.x;
+        *samples[1] = x.y;
+        *samples[2] = x.z;
+        *samples[3] = x.w;
+      }
+    }
+
+    for (size_t s = 0; s < TxikiAudioBiquadState::NUM_SECTIONS; s++)
+    {
+      for (size_t channel = 0; channel < 2; channel++)
+      {
+        float delays[2][NUM_LANES];
+        Store(delays[0], z1[s][channel]);
+        Store(delays[1], z2[s][channel]);
+        for (size_t lane = 0; lane < numVoices; lane++)
+        {
+          states[lane]->z[s][channel][0] = delays[0][lane];
+          states[lane]->z[s][channel][1] = delays[1][lane];
+        }
+      }
+    }
+  }
+
+private:
+
+  // Butterworth low-pass or high-pass section (RBJ cookbook), or a section that lets the sound through
+  static void GetCoefficients(bool active, bool lowPass, float cutoff, float* outCoefficients)
+  {
+    if (!active)
+    {
+      outCoefficients[0] = 1.0f;
+      outCoefficients[1] = outCoefficients[2] = outCoefficients[3] = outCoefficients[4] = 0.0f;
+      return;
+    }
+
+    float sampleRate = float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    cutoff = std::min(std::max(cutoff, 10.0f), sampleRate * 0.45f);
+
+    float w0 = 2.0f * 3.14159265f * cutoff / sampleRate;
+    float cosW0 = std::cos(w0);
+    float alpha = std::sin(w0) * 0.70710678f; // sin(w0) / (2 Q), Q = 1 / sqrt(2)
+    float inverseA0 = 1.0f / (1.0f + alpha);
+
+    float b1 = lowPass ? 1.0f - cosW0 : -(1.0f + cosW0);
+    float b0 = lowPass ? b1 * 0.5f : -b1 * 0.5f;
+    outCoefficients[0] = b0 * inverseA0;
+    outCoefficients[1] = b1 * inverseA0;
+    outCoefficients[2] = b0 * inverseA0;
+    outCoefficients[3] = -2.0f * cosW0 * inverseA0;
+    outCoefficients[4] = (1.0f - alpha) * inverseA0;
+  }
+};
+
+#endif // !TXIKI_AUDIO_BIQUADS_H
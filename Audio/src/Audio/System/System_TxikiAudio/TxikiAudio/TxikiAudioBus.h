@@ -0,0 +1,146 @@
+#ifndef TXIKI_AUDIO_BUS_H
+#define TXIKI_AUDIO_BUS_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "..\..\System_Common\AudioSystemCommon.h"
+#include "TxikiAudioEnums.h"
+
+// TxikiAudioBus
+//
+// Group of sounds sharing a volume, pause and mute, nested in a parent bus.
+// It can be ducked by the level of a sidechain bus: the sounds of the sidechain are mixed first and their peak is
+// measured, then the ducked bus follows the gain that peak asks for with the attack and release, once per buffer.
+class TxikiAudioBus : public IAudioSystemBus
+{
+public:
+
+  std::string name;
+  TxikiAudioBus* parent{ nullptr };
+
+  float volume{ 1.0f };
+  bool paused{ false };
+  bool muted{ false };
+
+  // ducked by the level of the sidechain bus, written by the game thread
+  TxikiAudioBus* sidechain{ nullptr };
+  AudioSystemDucking ducking;
+
+  // audio thread: peak of the sounds of this bus and its children in the mix numbered sidechainMix, when it is a sidechain
+  float sidechainPeak{ 0.0f };
+  uint64_t sidechainMix{ 0 };
+
+  // audio thread: envelope of the ducking gain, in dB and linear
+  float duckingLevel{ 0.0f };
+  float duckingGain{ 1.0f };
+
+  bool SetVolume(float v) final
+  {
+    // set the volume in the range [0.0f, 1.0f]
+    volume = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return true;
+  }
+
+  bool SetPaused(bool p) final
+  {
+    paused = p;
+    return true;
+  }
+
+  bool SetMuted(bool m) final
+  {
+    muted = m;
+    return true;
+  }
+
+  bool SetDucking(IAudioSystemBus* sidechainBus, const AudioSystemDucking& ducking_) final
+  {
+    ducking = ducking_;
+    sidechain = static_cast<TxikiAudioBus*>(sidechainBus);
+    return true;
+  }
+
+  // Audio thread: the sounds of a sidechain bus, or of its children, are measured in the mix
+  bool IsSidechain(uint64_t mix) const
+  {
+    for (const TxikiAudioBus* bus = this; bus; bus = bus->parent)
+    {
+      if (bus->sidechainMix == mix)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // Audio thread: peak of a sound of the bus, measured in the mix
+  void AddSidechainPeak(float peak, uint64_t mix)
+  {
+    for (TxikiAudioBus* bus = this; bus; bus = bus->parent)
+    {
+      if (bus->sidechainMix == mix)
+      {
+        bus->sidechainPeak = std::max(bus->sidechainPeak, peak);
+      }
+    }
+  }
+
+  // Audio thread: follow the peak of the sidechain measured in the mix, once per buffer
+  void UpdateDucking(size_t framesPerBuffer, uint64_t mix)
+  {
+    float peak = sidechain && sidechain->sidechainMix == mix ? sidechain->sidechainPeak : 0.0f;
+    if (peak == 0.0f && duckingLevel == 0.0f)
+    {
+      return;
+    }
+
+    // 1 dB down per dB over the threshold, down to the depth
+    float level = 20.0f * std::log10(std::max(peak, 1e-6f));
+    float target = std::min(std::max(ducking.threshold - level, std::min(ducking.depth, 0.0f)), 0.0f);
+
+    float time = std::max(target < duckingLevel ? ducking.attack : ducking.release, 0.001f);
+    float sampleRate = float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    duckingLevel += (target - duckingLevel) * (1.0f - std::exp(-float(framesPerBuffer) / (time * sampleRate)));
+    if (duckingLevel > -0.01f)
+    {
+      duckingLevel = 0.0f;
+    }
+    duckingGain = std::pow(10.0f, duckingLevel / 20.0f);
+  }
+
+  // Audio thread: gain of the bus and its parents
+  float GetGain() const
+  {
+    float gain = 1.0f;
+    for (const TxikiAudioBus* bus = this; bus; bus = bus->parent)
+    {
+      if (bus->muted)
+      {
+        return 0.0f;
+      }
+
+      gain *= bus->volume * bus->duckingGain;
+    }
+
+    return gain;
+  }
+
+  // Audio thread: sounds do not advance while the bus or any of its parents is paused
+  bool IsPaused() const
+  {
+    for (const TxikiAudioBus* bus = this; bus; bus = bus->parent)
+    {
+      if (bus->paused)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+};
+
+#endif // !TXIKI_AUDIO_BUS_H
@@ -0,0 +1,288 @@
+#ifndef TXIKI_AUDIO_CONVOLUTION_REVERB_H
+#define TXIKI_AUDIO_CONVOLUTION_REVERB_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TxikiAudioConvolver.h"
+
+// Measured stereo impulse response, split in the partitions of TxikiAudioConvolutionReverb
+struct TxikiAudioImpulseResponse
+{
+  TxikiAudioConvolverFilter head;
+  TxikiAudioConvolverFilter tail;
+};
+
+// TxikiAudioConvolutionReverb
+//
+// Convolution of the reverb send with a measured impulse response, in partitions of two sizes:
+// - the head, in small blocks, in the audio thread. Its output is delayed by one small block.
+// - the tail, in big blocks, in a worker thread. A block is convolved while the next one is recorded
+//   and played after it, so the tail starts 2 big blocks minus 1 small block into the impulse response.
+class TxikiAudioConvolutionReverb
+{
+public:
+
+  // Note: the tail block must be bigger than the buffers of the audio callback, so the worker has time to convolve it
+  void Init(size_t headBlockSize_, size_t tailBlockSize_, size_t maxLength)
+  {
+    headBlockSize = headBlockSize_;
+    tailBlockSize = std::max(tailBlockSize_, headBlockSize);
+    headLength = 2 * tailBlockSize - headBlockSize;
+
+    head.Init(headBlockSize, headLength / headBlockSize);
+    tail.Init(tailBlockSize, (std::max(maxLength, headLength + 1) - headLength + tailBlockSize - 1) / tailBlockSize);
+
+    tailAccumulator.assign(tailBlockSize, 0.0f);
+    tailInput.assign(tailBlockSize, 0.0f);
+    for (auto& output : tailOutputs)
+    {
+      output.assign(tailBlockSize * 2, 0.0f);
+    }
+
+    running = true;
+    thread = std::thread(&TxikiAudioConvolutionReverb::Run, this);
+  }
+
+  void Terminate()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    wakeUp.notify_one();
+
+    if (thread.joinable())
+    {
+      thread.join();
+    }
+  }
+
+  // Game thread: partitions of an impulse response of 44100Hz. It is normalised to unit energy, so every room sounds as loud.
+  std::unique_ptr<TxikiAudioImpulseResponse> NewImpulseResponse(const float* left, const float* right, size_t length) const
+  {
+    double energy = 0.0;
+    for (size_t i = 0; i < length; i++)
+    {
+      energy += double(left[i]) * left[i] + double(right[i]) * right[i];
+    }
+    float scale = energy > 0.0 ? float(1.0 / std::sqrt(energy * 0.5)) : 0.0f;
+
+    std::vector<float> scaledLeft(left, left + length);
+    std::vector<float> scaledRight(right, right + length);
+    for (size_t i = 0; i < length; i++)
+    {
+      scaledLeft[i] *= scale;
+      scaledRight[i] *= scale;
+    }
+
+    std::unique_ptr<TxikiAudioImpulseResponse> impulseResponse = std::make_unique<TxikiAudioImpulseResponse>();
+
+    size_t headPartLength = std::min(length, headLength);
+    impulseResponse->head.Set(head.GetFFT(), scaledLeft.data(), scaledRight.data(), headPartLength, headBlockSize);
+
+    size_t tailPartLength = length - headPartLength;
+    impulseResponse->tail.Set(tail.GetFFT(), scaledLeft.data() + headPartLength, scaledRight.data() + headPartLength, tailPartLength, tailBlockSize);
+
+    return impulseResponse;
+  }
+
+  // Game thread: the impulse response is used by reference until it is replaced (null = off)
+  void SetImpulseResponse(const TxikiAudioImpulseResponse* impulseResponse)
+  {
+    pendingImpulseResponse.store(impulseResponse, std::memory_order_release);
+  }
+
+  bool IsEnabled() const { return pendingImpulseResponse.load(std::memory_order_relaxed) != nullptr; }
+
+  // tail blocks the worker could not convolve in time
+  size_t GetUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+
+  // Audio thread: convolve the stereo send buffer and add the result to the interleaved stereo out.
+  // Returns false when there is no impulse response.
+  bool Process(const float* in, float* out, size_t frames, float wetGain)
+  {
+    UpdateImpulseResponse();
+    if (!impulseResponse)
+    {
+      return false;
+    }
+
+    // the impulse response is stereo: the send is convolved in mono
+    if (monoBuffer.size() < frames)
+    {
+      monoBuffer.resize(frames);
+    }
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      monoBuffer[frame] = (in[frame * 2] + in[frame * 2 + 1]) * 0.5f * wetGain;
+    }
+
+    head.Process(monoBuffer.data(), 1, out, frames);
+
+    bool hasTail = impulseResponse->tail.GetNumPartitions() > 0;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      tailAccumulator[tailPosition] = monoBuffer[frame];
+      if (playTail)
+      {
+        out[frame * 2] += tailOutputs[playSlot][tailPosition * 2];
+        out[frame * 2 + 1] += tailOutputs[playSlot][tailPosition * 2 + 1];
+      }
+
+      if (++tailPosition == tailBlockSize)
+      {
+        tailPosition = 0;
+        EndTailBlock(hasTail);
+      }
+    }
+
+    return true;
+  }
+
+private:
+
+  void UpdateImpulseResponse()
+  {
+    const TxikiAudioImpulseResponse* newImpulseResponse = pendingImpulseResponse.load(std::memory_order_acquire);
+    if (newImpulseResponse == impulseResponse)
+    {
+      return;
+    }
+
+    if (!impulseResponse)
+    {
+      // start from silence. The tail blocks of the last time are not played.
+      head.Reset();
+      std::fill(tailAccumulator.begin(), tailAccumulator.end(), 0.0f);
+      tailPosition = 0;
+      playTail = false;
+      tailBlock += 2;
+      resetTail = true;
+    }
+
+    // Note: the head crossfades from the old impulse response, the tail does it in the worker
+    impulseResponse = newImpulseResponse;
+    if (impulseResponse)
+    {
+      head.SetFilter(&impulseResponse->head);
+    }
+  }
+
+  // Audio thread: hand the tail block just recorded to the worker and play the one it convolved
+  void EndTailBlock(bool hasTail)
+  {
+    tailBlock++;
+
+    if (submitted != completed.load(std::memory_order_acquire))
+    {
+      // the worker is late: this block is dropped and the next one is silent
+      underruns.fetch_add(1, std::memory_order_relaxed);
+      playTail = false;
+      return;
+    }
+
+    // output of the previous block, if it was not dropped
+    playSlot = (submitted + 1) % 2;
+    playTail = submitted > 0 && submittedTailBlock == tailBlock - 1;
+
+    if (hasTail)
+    {
+      std::copy(tailAccumulator.begin(), tailAccumulator.end(), tailInput.begin());
+      submittedImpulseResponse = impulseResponse;
+      submittedTailBlock = tailBlock;
+      submittedReset = resetTail;
+      resetTail = false;
+
+      submitted++;
+      pendingBlocks.store(submitted, std::memory_order_release);
+      wakeUp.notify_one();
+    }
+  }
+
+  // Worker thread
+  void Run()
+  {
+    const TxikiAudioImpulseResponse* tailImpulseResponse = nullptr;
+    uint64_t done = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running)
+    {
+      if (pendingBlocks.load(std::memory_order_acquire) == done)
+      {
+        // Note: the audio thread does not lock, a missed wake up is caught by the timeout
+        wakeUp.wait_for(lock, std::chrono::milliseconds(2));
+        continue;
+      }
+
+      lock.unlock();
+
+      if (submittedReset)
+      {
+        tail.Reset();
+        tailImpulseResponse = nullptr;
+      }
+
+      if (submittedImpulseResponse != tailImpulseResponse)
+      {
+        tailImpulseResponse = submittedImpulseResponse;
+        tail.SetFilter(&tailImpulseResponse->tail);
+      }
+
+      std::vector<float>& output = tailOutputs[done % 2];
+      std::fill(output.begin(), output.end(), 0.0f);
+      tail.ProcessBlock(tailInput.data(), output.data());
+
+      done++;
+      completed.store(done, std::memory_order_release);
+
+      lock.lock();
+    }
+  }
+
+  size_t headBlockSize{ 0 };
+  size_t tailBlockSize{ 0 };
+  size_t headLength{ 0 };
+
+  // audio thread
+  TxikiAudioConvolver head;
+  const TxikiAudioImpulseResponse* impulseResponse{ nullptr };
+  std::vector<float> monoBuffer;
+  std::vector<float> tailAccumulator;
+  size_t tailPosition{ 0 };
+  uint64_t tailBlock{ 0 };
+  size_t playSlot{ 0 };
+  bool playTail{ false };
+  bool resetTail{ false };
+  uint64_t submitted{ 0 };
+
+  std::atomic<const TxikiAudioImpulseResponse*> pendingImpulseResponse{ nullptr };
+
+  // block handed to the worker, written by the audio thread while the worker is idle
+  std::vector<float> tailInput;
+  const TxikiAudioImpulseResponse* submittedImpulseResponse{ nullptr };
+  uint64_t submittedTailBlock{ 0 };
+  bool submittedReset{ false };
+  std::atomic<uint64_t> pendingBlocks{ 0 };
+
+  // worker thread: the tail convolution of the last two blocks
+  TxikiAudioConvolver tail;
+  std::vector<float> tailOutputs[2];
+  std::atomic<uint64_t> completed{ 0 };
+  std::atomic<size_t> underruns{ 0 };
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  bool running{ false };
+};
+
+#endif // !TXIKI_AUDIO_CONVOLUTION_REVERB_H
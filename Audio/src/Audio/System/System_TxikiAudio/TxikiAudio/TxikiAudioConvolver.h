@@ -0,0 +1,268 @@
+#ifndef TXIKI_AUDIO_CONVOLVER_H
+#define TXIKI_AUDIO_CONVOLVER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "TxikiAudioFFT.h"
+
+// TxikiAudioConvolverFilter
+//
+// Stereo impulse response split in partitions of blockSize frames, kept as spectra of 2 * blockSize bins
+class TxikiAudioConvolverFilter
+{
+public:
+
+  typedef TxikiAudioFFT::Complex Complex;
+
+  // Note: fft must have a size of 2 * blockSize
+  void Set(const TxikiAudioFFT& fft, const float* left, const float* right, size_t length, size_t blockSize_)
+  {
+    blockSize = blockSize_;
+    numPartitions = (length + blockSize - 1) / blockSize;
+
+    size_t numBins = blockSize + 1;
+    spectra.resize(numPartitions * 2 * numBins);
+    fftBuffer.resize(2 * blockSize);
+
+    for (size_t partition = 0; partition < numPartitions; partition++)
+    {
+      // both ears in one FFT: left in the real part, right in the imaginary part
+      size_t offset = partition * blockSize;
+      size_t partitionLength = std::min(blockSize, length - offset);
+      std::fill(fftBuffer.begin(), fftBuffer.end(), Complex(0.0f, 0.0f));
+      for (size_t i = 0; i < partitionLength; i++)
+      {
+        fftBuffer[i] = Complex(left[offset + i], right[offset + i]);
+      }
+
+      fft.Forward(fftBuffer.data());
+
+      // split the spectra of the two real signals
+      Complex* leftBins = &spectra[partition * 2 * numBins];
+      Complex* rightBins = leftBins + numBins;
+      size_t fftSize = fftBuffer.size();
+      for (size_t k = 0; k < numBins; k++)
+      {
+        Complex z = fftBuffer[k];
+        Complex mirrored = std::conj(fftBuffer[(fftSize - k) % fftSize]);
+        leftBins[k] = (z + mirrored) * 0.5f;
+        rightBins[k] = (z - mirrored) * Complex(0.0f, -0.5f);
+      }
+    }
+  }
+
+  size_t GetNumPartitions() const { return numPartitions; }
+
+  const Complex* GetLeft(size_t partition) const { return &spectra[partition * 2 * (blockSize + 1)]; }
+  const Complex* GetRight(size_t partition) const { return GetLeft(partition) + blockSize + 1; }
+
+private:
+
+  size_t blockSize{ 0 };
+  size_t numPartitions{ 0 };
+  std::vector<Complex> spectra;
+  std::vector<Complex> fftBuffer;
+};
+
+// TxikiAudioConvolver
+//
+// Mono in, stereo out, uniformly partitioned overlap-save convolution.
+// The output is delayed by blockSize frames. A filter change is crossfaded over one block.
+class TxikiAudioConvolver
+{
+public:
+
+  typedef TxikiAudioFFT::Complex Complex;
+
+  void Init(size_t blockSize_, size_t maxPartitions_)
+  {
+    blockSize = blockSize_;
+    maxPartitions = std::max(maxPartitions_, size_t(1));
+
+    fft.Init(2 * blockSize);
+
+    input.resize(2 * blockSize);
+    outputLeft.resize(blockSize);
+    outputRight.resize(blockSize);
+    fftBuffer.resize(2 * blockSize);
+    crossfadeBuffer.resize(2 * blockSize);
+    accumulatorLeft.resize(blockSize + 1);
+    accumulatorRight.resize(blockSize + 1);
+    delayLine.resize(maxPartitions * (blockSize + 1));
+
+    Reset();
+  }
+
+  void Reset()
+  {
+    std::fill(input.begin(), input.end(), 0.0f);
+    std::fill(outputLeft.begin(), outputLeft.end(), 0.0f);
+    std::fill(outputRight.begin(), outputRight.end(), 0.0f);
+    std::fill(delayLine.begin(), delayLine.end(), Complex(0.0f, 0.0f));
+    delayLineIndex = 0;
+    framePosition = 0;
+
+    filter = nullptr;
+    nextFilter = nullptr;
+  }
+
+  const TxikiAudioFFT& GetFFT() const { return fft; }
+  size_t GetBlockSize() const { return blockSize; }
+
+  // The filter is used by reference: it must not change until it is replaced
+  void SetFilter(const TxikiAudioConvolverFilter* newFilter)
+  {
+    if (!filter)
+    {
+      filter = newFilter;
+      return;
+    }
+
+    nextFilter = newFilter;
+  }
+
+  bool IsCrossfading() const { return nextFilter != nullptr; }
+
+  // Convolve a whole block of blockSize frames and add it to the interleaved stereo out, with no delay
+  void ProcessBlock(const float* in, float* out)
+  {
+    std::copy(in, in + blockSize, input.begin() + blockSize);
+    ProcessBlock();
+
+    for (size_t i = 0; i < blockSize; i++)
+    {
+      out[i * 2] += outputLeft[i];
+      out[i * 2 + 1] += outputRight[i];
+    }
+  }
+
+  // Convolve in (one sample every inStride floats) and add the result to the interleaved stereo out
+  void Process(const float* in, size_t inStride, float* out, size_t frames)
+  {
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      input[blockSize + framePosition] = in[frame * inStride];
+      out[frame * 2] += outputLeft[framePosition];
+      out[frame * 2 + 1] += outputRight[framePosition];
+
+      if (++framePosition == blockSize)
+      {
+        ProcessBlock();
+        framePosition = 0;
+      }
+    }
+  }
+
+private:
+
+  void ProcessBlock()
+  {
+    // spectrum of the last two blocks of input, newest partition first in the delay line
+    for (size_t i = 0; i < 2 * blockSize; i++)
+    {
+      fftBuffer[i] = Complex(input[i], 0.0f);
+    }
+    fft.Forward(fftBuffer.data());
+
+    size_t numBins = blockSize + 1;
+    delayLineIndex = (delayLineIndex + maxPartitions - 1) % maxPartitions;
+    std::copy(fftBuffer.begin(), fftBuffer.begin() + numBins, delayLine.begin() + delayLineIndex * numBins);
+
+    std::copy(input.begin() + blockSize, input.end(), input.begin());
+
+    if (!filter)
+    {
+      std::fill(outputLeft.begin(), outputLeft.end(), 0.0f);
+      std::fill(outputRight.begin(), outputRight.end(), 0.0f);
+      return;
+    }
+
+    Convolve(*filter, fftBuffer);
+
+    if (!nextFilter)
+    {
+      for (size_t i = 0; i < blockSize; i++)
+      {
+        outputLeft[i] = fftBuffer[blockSize + i].real();
+        outputRight[i] = fftBuffer[blockSize + i].imag();
+      }
+      return;
+    }
+
+    // crossfade from the old filter to the new one
+    Convolve(*nextFilter, crossfadeBuffer);
+    for (size_t i = 0; i < blockSize; i++)
+    {
+      float t = float(i + 1) / float(blockSize);
+      Complex sample = fftBuffer[blockSize + i] * (1.0f - t) + crossfadeBuffer[blockSize + i] * t;
+      outputLeft[i] = sample.real();
+      outputRight[i] = sample.imag();
+    }
+
+    filter = nextFilter;
+    nextFilter = nullptr;
+  }
+
+  // Multiply-accumulate the delay line with the filter partitions. The output has left in the real part, right in the imaginary part.
+  void Convolve(const TxikiAudioConvolverFilter& convolverFilter, std::vector<Complex>& output)
+  {
+    size_t numBins = blockSize + 1;
+    std::fill(accumulatorLeft.begin(), accumulatorLeft.end(), Complex(0.0f, 0.0f));
+    std::fill(accumulatorRight.begin(), accumulatorRight.end(), Complex(0.0f, 0.0f));
+
+    size_t numPartitions = std::min(convolverFilter.GetNumPartitions(), maxPartitions);
+    for (size_t partition = 0; partition < numPartitions; partition++)
+    {
+      const Complex* x = &delayLine[((delayLineIndex + partition) % maxPartitions) * numBins];
+      const Complex* left = convolverFilter.GetLeft(partition);
+      const Complex* right = convolverFilter.GetRight(partition);
+      for (size_t k = 0; k < numBins; k++)
+      {
+        accumulatorLeft[k] += x[k] * left[k];
+        accumulatorRight[k] += x[k] * right[k];
+      }
+    }
+
+    // both ears in one inverse FFT: the spectra of real signals are conjugate symmetric
+    const Complex i(0.0f, 1.0f);
+    size_t fftSize = 2 * blockSize;
+    for (size_t k = 0; k < numBins; k++)
+    {
+      output[k] = accumulatorLeft[k] + i * accumulatorRight[k];
+    }
+    for (size_t k = 1; k < blockSize; k++)
+    {
+      output[fftSize - k] = std::conj(accumulatorLeft[k]) + i * std::conj(accumulatorRight[k]);
+    }
+
+    fft.Inverse(output.data());
+  }
+
+  size_t blockSize{ 0 };
+  size_t maxPartitions{ 0 };
+
+  TxikiAudioFFT fft;
+
+  // last two blocks of input
+  std::vector<float> input;
+  size_t framePosition{ 0 };
+
+  // block of output being played
+  std::vector<float> outputLeft;
+  std::vector<float> outputRight;
+
+  // spectra of the last input blocks
+  std::vector<Complex> delayLine;
+  size_t delayLineIndex{ 0 };
+
+  std::vector<Complex> fftBuffer;
+  std::vector<Complex> crossfadeBuffer;
+  std::vector<Complex> accumulatorLeft;
+  std::vector<Complex> accumulatorRight;
+
+  const TxikiAudioConvolverFilter* filter{ nullptr };
+  const TxikiAudioConvolverFilter* nextFilter{ nullptr };
+};
+
+#endif // !TXIKI_AUDIO_CONVOLVER_H
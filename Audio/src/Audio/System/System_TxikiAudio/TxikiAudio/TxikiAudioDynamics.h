@@ -0,0 +1,365 @@
+#ifndef TXIKI_AUDIO_DYNAMICS_H
+#define TXIKI_AUDIO_DYNAMICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "..\..\System_Common\AudioSystemDefines.h"
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioSIMD.h"
+
+// TxikiAudioDynamics
+//
+// Compressor and limiter of the master bus, run on the float mix before it is converted.
+// - the compressor is feed-forward with a soft knee, on the peak of each frame over all the channels
+// - the limiter looks ahead: the mix is delayed by the look-ahead, and each frame gets the lowest gain needed in the
+//   look-ahead window, averaged over a window as long, so the gain is already down when the peak comes out
+// Levels and gains are worked out and applied 4 at a time. Only the envelopes run frame by frame, as each frame
+// depends on the one before.
+class TxikiAudioDynamics
+{
+public:
+
+  // Note: the output is delayed by the look-ahead while the limiter is on
+  void Init(size_t numChannels_, size_t stride_, float lookAhead)
+  {
+    numChannels = numChannels_;
+    stride = stride_;
+    lookAheadFrames = std::max(size_t(lookAhead * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz)), size_t(1));
+
+    delayLine.assign(lookAheadFrames * stride, 0.0f);
+    averageWindow.assign(lookAheadFrames, 1.0f);
+    minimumFrames.assign(lookAheadFrames + 2, 0);
+    minimumGains.assign(lookAheadFrames + 2, 1.0f);
+    Reset();
+    compressorEnvelope = 0.0f;
+  }
+
+  // Audio thread: the coefficients are only computed again when the settings change
+  void SetSettings(const AudioSystemMasterDynamics& settings_)
+  {
+    if (hasSettings && IsSame(settings_, settings))
+    {
+      return;
+    }
+
+    // the envelope and delayed frames of a stage turned on are stale
+    if (hasSettings && settings_.compressor != settings.compressor)
+    {
+      compressorEnvelope = 0.0f;
+    }
+    if (hasSettings && settings_.limiter != settings.limiter)
+    {
+      Reset();
+    }
+
+    settings = settings_;
+    hasSettings = true;
+
+    float sampleRate = float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    attackCoefficient = std::exp(-1.0f / (std::max(settings.attack, 1e-4f) * sampleRate));
+    releaseCoefficient = std::exp(-1.0f / (std::max(settings.release, 1e-3f) * sampleRate));
+    limiterReleaseStep = 1.0f - std::exp(-1.0f / (std::max(settings.limiterRelease, 1e-3f) * sampleRate));
+    ceilingGain = std::pow(10.0f, std::min(settings.ceiling, 0.0f) / 20.0f);
+  }
+
+  bool IsEnabled() const { return settings.limiter || settings.compressor; }
+
+  // gain reduction of the last buffer in dB, and share of its duration spent processing it
+  float GetGainReduction() const { return gainReduction.load(std::memory_order_relaxed); }
+  float GetLoad() const { return load.load(std::memory_order_relaxed); }
+
+  // Audio thread: compress and limit the interleaved mix in place
+  void Process(float* mix, size_t frames)
+  {
+    if (!IsEnabled() || frames == 0)
+    {
+      gainReduction.store(0.0f, std::memory_order_relaxed);
+      load.store(0.0f, std::memory_order_relaxed);
+      return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the buffers only grow, so they stop allocating after the first callbacks
+    size_t paddedFrames = TxikiAudioSIMD::PaddedSize(frames);
+    if (peaks.size() < paddedFrames)
+    {
+      peaks.resize(paddedFrames);
+      compressorGains.resize(paddedFrames);
+      limiterGains.resize(paddedFrames);
+    }
+    std::fill(peaks.begin() + frames, peaks.begin() + paddedFrames, 0.0f);
+
+    FindPeaks(mix, frames);
+
+    float minGain = 1.0f;
+    if (settings.compressor)
+    {
+      Compress(paddedFrames, frames);
+      ApplyGains(compressorGains.data(), mix, frames);
+      minGain = *std::min_element(compressorGains.begin(), compressorGains.begin() + frames);
+    }
+
+    if (settings.limiter)
+    {
+      Limit(mix, paddedFrames, frames);
+      ApplyGains(limiterGains.data(), mix, frames);
+      minGain = std::min(minGain, *std::min_element(limiterGains.begin(), limiterGains.begin() + frames));
+    }
+
+    gainReduction.store(20.0f * std::log10(std::max(minGain, 1e-6f)), std::memory_order_relaxed);
+
+    std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+    float duration = float(frames) / float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    load.store(elapsed.count() / duration, std::memory_order_relaxed);
+  }
+
+private:
+
+  static bool IsSame(const AudioSystemMasterDynamics& a, const AudioSystemMasterDynamics& b)
+  {
+    return a.compressor == b.compressor && a.threshold == b.threshold && a.ratio == b.ratio && a.knee == b.knee && a.attack == b.attack && a.release == b.release
+      && a.makeupGain == b.makeupGain && a.limiter == b.limiter && a.ceiling == b.ceiling && a.limiterRelease == b.limiterRelease;
+  }
+
+  void Reset()
+  {
+    std::fill(delayLine.begin(), delayLine.end(), 0.0f);
+    std::fill(averageWindow.begin(), averageWindow.end(), 1.0f);
+    position = 0;
+    minimumStart = 0;
+    minimumCount = 0;
+    limiterEnvelope = 1.0f;
+  }
+
+  // peak of each frame over its channels
+  void FindPeaks(const float* mix, size_t frames)
+  {
+    using namespace TxikiAudioSIMD;
+
+    if (stride % WIDTH == 0)
+    {
+      // speaker layouts: the padding channels are silent
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        TxikiAudioFloat4 peak = Splat(0.0f);
+        for (size_t channel = 0; channel < stride; channel += WIDTH)
+        {
+          peak = glm::max(peak, glm::abs(Load(&mix[frame * stride + channel])));
+        }
+        peaks[frame] = std::max(std::max(peak.x, peak.y), std::max(peak.z, peak.w));
+      }
+    }
+    else if (stride == 2)
+    {
+      // stereo: 2 frames at a time
+      size_t pairs = frames / 2;
+      for (size_t pair = 0; pair < pairs; pair++)
+      {
+        TxikiAudioFloat4 peak = glm::abs(Load(&mix[pair * WIDTH]));
+        peaks[pair * 2] = std::max(peak.x, peak.y);
+        peaks[pair * 2 + 1] = std::max(peak.z, peak.w);
+      }
+      if (frames % 2)
+      {
+        peaks[frames - 1] = std::max(std::abs(mix[(frames - 1) * 2]), std::abs(mix[(frames - 1) * 2 + 1]));
+      }
+    }
+    else
+    {
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        float peak = 0.0f;
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+          peak = std::max(peak, std::abs(mix[frame * stride + channel]));
+        }
+        peaks[frame] = peak;
+      }
+    }
+  }
+
+  // compressor gains of the frames, and the peaks they leave for the limiter
+  void Compress(size_t paddedFrames, size_t frames)
+  {
+    using namespace TxikiAudioSIMD;
+
+    // level over the threshold to gain in dB: none below the knee, the ratio above it and a parabola in between
+    const TxikiAudioFloat4 decibelsPerOctave = Splat(6.0205999f); // 20 log10(2)
+    float knee = std::max(settings.knee, 1e-3f);
+    float slope = 1.0f / std::max(settings.ratio, 1.0f) - 1.0f;
+    TxikiAudioFloat4 threshold = Splat(settings.threshold);
+    TxikiAudioFloat4 halfKnee = Splat(knee * 0.5f);
+    TxikiAudioFloat4 kneeScale = Splat(slope / (2.0f * knee));
+    TxikiAudioFloat4 slopes = Splat(slope);
+    TxikiAudioFloat4 zero = Splat(0.0f);
+
+    for (size_t i = 0; i < paddedFrames; i += WIDTH)
+    {
+      TxikiAudioFloat4 level = glm::log2(glm::max(Load(&peaks[i]), Splat(1e-6f))) * decibelsPerOctave;
+      TxikiAudioFloat4 over = level - threshold;
+      TxikiAudioFloat4 inKnee = over + halfKnee;
+      TxikiAudioFloat4 gain = glm::mix(zero, kneeScale * inKnee * inKnee, glm::greaterThan(over, -halfKnee));
+      gain = glm::mix(gain, slopes * over, glm::greaterThan(over, halfKnee));
+      Store(&compressorGains[i], gain);
+    }
+
+    // the envelope follows the gain down with the attack and back up with the release
+    float envelope = compressorEnvelope;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      float target = compressorGains[frame];
+      float coefficient = target < envelope ? attackCoefficient : releaseCoefficient;
+      envelope = target + coefficient * (envelope - target);
+      compressorGains[frame] = envelope;
+    }
+    compressorEnvelope = envelope;
+
+    TxikiAudioFloat4 makeupGain = Splat(settings.makeupGain);
+    for (size_t i = 0; i < paddedFrames; i += WIDTH)
+    {
+      TxikiAudioFloat4 gain = glm::exp2((Load(&compressorGains[i]) + makeupGain) / decibelsPerOctave);
+      Store(&compressorGains[i], gain);
+      Store(&peaks[i], Load(&peaks[i]) * gain);
+    }
+  }
+
+  // limiter gains of the delayed frames. The mix goes through the look-ahead delay.
+  void Limit(float* mix, size_t paddedFrames, size_t frames)
+  {
+    using namespace TxikiAudioSIMD;
+
+    // gain that takes each frame down to the ceiling
+    TxikiAudioFloat4 ceiling = Splat(ceilingGain);
+    for (size_t i = 0; i < paddedFrames; i += WIDTH)
+    {
+      Store(&limiterGains[i], glm::min(Splat(1.0f), ceiling / glm::max(Load(&peaks[i]), Splat(1e-9f))));
+    }
+
+    // Note: summed again each buffer, so the rounding errors of the running sum do not pile up
+    float sum = 0.0f;
+    for (float gain : averageWindow)
+    {
+      sum += gain;
+    }
+    float inverseLength = 1.0f / float(lookAheadFrames);
+    size_t capacity = minimumGains.size();
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      // lowest gain of the last look-ahead + 1 frames: a queue of increasing gains
+      float gain = limiterGains[frame];
+      while (minimumCount > 0 && minimumGains[(minimumStart + minimumCount - 1) % capacity] >= gain)
+      {
+        minimumCount--;
+      }
+      size_t back = (minimumStart + minimumCount) % capacity;
+      minimumGains[back] = gain;
+      minimumFrames[back] = frameCount;
+      minimumCount++;
+      while (minimumFrames[minimumStart] + lookAheadFrames < frameCount)
+      {
+        minimumStart = (minimumStart + 1) % capacity;
+        minimumCount--;
+      }
+      float hold = minimumGains[minimumStart];
+      frameCount++;
+
+      // down at once, up with the release
+      limiterEnvelope = hold < limiterEnvelope ? hold : limiterEnvelope + (hold - limiterEnvelope) * limiterReleaseStep;
+
+      // average over the window: every gain in it is low enough for the frame coming out of the delay
+      sum += limiterEnvelope - averageWindow[position];
+      averageWindow[position] = limiterEnvelope;
+      limiterGains[frame] = sum * inverseLength;
+
+      float* delayed = &delayLine[position * stride];
+      std::swap_ranges(delayed, delayed + stride, &mix[frame * stride]);
+      position = (position + 1) % lookAheadFrames;
+    }
+  }
+
+  void ApplyGains(const float* gains, float* mix, size_t frames) const
+  {
+    using namespace TxikiAudioSIMD;
+
+    if (stride % WIDTH == 0)
+    {
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        TxikiAudioFloat4 gain = Splat(gains[frame]);
+        for (size_t channel = 0; channel < stride; channel += WIDTH)
+        {
+          float* samples = &mix[frame * stride + channel];
+          Store(samples, Load(samples) * gain);
+        }
+      }
+    }
+    else if (stride == 2)
+    {
+      size_t pairs = frames / 2;
+      for (size_t pair = 0; pair < pairs; pair++)
+      {
+        float* samples = &mix[pair * WIDTH];
+        TxikiAudioFloat4 gain(gains[pair * 2], gains[pair * 2], gains[pair * 2 + 1], gains[pair * 2 + 1]);
+        Store(samples, Load(samples) * gain);
+      }
+      if (frames % 2)
+      {
+        mix[(frames - 1) * 2] *= gains[frames - 1];
+        mix[(frames - 1) * 2 + 1] *= gains[frames - 1];
+      }
+    }
+    else
+    {
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+          mix[frame * stride + channel] *= gains[frame];
+        }
+      }
+    }
+  }
+
+  size_t numChannels{ 2 };
+  size_t stride{ 2 };
+
+  AudioSystemMasterDynamics settings;
+  bool hasSettings{ false };
+  float attackCoefficient{ 0.0f };
+  float releaseCoefficient{ 0.0f };
+  float limiterReleaseStep{ 0.0f };
+  float ceilingGain{ 1.0f };
+
+  // per frame of the buffer
+  std::vector<float> peaks;
+  std::vector<float> compressorGains;
+  std::vector<float> limiterGains;
+
+  // compressor envelope, gain in dB
+  float compressorEnvelope{ 0.0f };
+
+  // limiter: look-ahead delay of the mix and window of the average gain, lookAheadFrames each
+  size_t lookAheadFrames{ 1 };
+  std::vector<float> delayLine;
+  std::vector<float> averageWindow;
+  size_t position{ 0 };
+  float limiterEnvelope{ 1.0f };
+
+  // queue of the lowest gains, as a ring
+  std::vector<uint64_t> minimumFrames;
+  std::vector<float> minimumGains;
+  size_t minimumStart{ 0 };
+  size_t minimumCount{ 0 };
+  uint64_t frameCount{ 0 };
+
+  std::atomic<float> gainReduction{ 0.0f };
+  std::atomic<float> load{ 0.0f };
+};
+
+#endif // !TXIKI_AUDIO_DYNAMICS_H
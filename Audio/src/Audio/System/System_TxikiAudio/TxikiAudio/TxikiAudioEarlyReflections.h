@@ -0,0 +1,442 @@
+#ifndef TXIKI_AUDIO_EARLY_REFLECTIONS_H
+#define TXIKI_AUDIO_EARLY_REFLECTIONS_H
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "..\..\System_Common\AudioSystemDefines.h"
+#include "TxikiAudioSIMD.h"
+#include "TxikiAudioSound.h"
+#include "TxikiAudioSpatializer.h"
+#include "TxikiAudioSpeakers.h"
+#include "TxikiAudioVoices3D.h"
+
+// TxikiAudioEarlyReflections
+//
+// First and second order reflections of the 3D voices on the walls of a convex room, found with the image-source method.
+// Every voice has one tap per image source (invalid ones are silent), so a tap keeps its index while the voice moves.
+// The taps of all the voices are written into one shared multi-tap delay line, which is added to the mix once per buffer.
+class TxikiAudioEarlyReflections
+{
+public:
+
+  void Init(const TxikiAudioSpeakers& speakers_, float speedOfSound_, float moveThreshold_, float maxDelay)
+  {
+    speakers = &speakers_;
+    speedOfSound = std::max(speedOfSound_, 1.0f);
+    moveThreshold = moveThreshold_;
+    maxDelayFrames = size_t(maxDelay * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz));
+
+    // stereo taps are panned like the voices, multichannel ones on the speakers
+    numChannels = speakers->GetLayout() == TxikiAudioOutputLayout::STEREO ? 2 : speakers->GetNumChannels();
+
+    // each order of reflections is duller than the previous one
+    const float cutoffs[MAX_ORDER] = { 8000.0f, 5000.0f };
+    for (size_t order = 0; order < MAX_ORDER; order++)
+    {
+      lowPass[order] = 1.0f - std::exp(-2.0f * 3.14159265f * cutoffs[order] / float(TxikiAudioSoundSampleRate::SampleRate_44100Hz));
+    }
+  }
+
+  // Game thread
+  void SetRoom(const AudioSystemRoom& room)
+  {
+    walls = room.walls;
+    for (auto& wall : walls)
+    {
+      float length = std::sqrt(wall.normal.x * wall.normal.x + wall.normal.y * wall.normal.y + wall.normal.z * wall.normal.z);
+      if (length > 1e-6f)
+      {
+        wall.normal = { wall.normal.x / length, wall.normal.y / length, wall.normal.z / length };
+        wall.offset /= length;
+      }
+    }
+
+    // image sources: one per wall, then one per pair of different walls
+    imageWalls.clear();
+    for (size_t wall = 0; wall < walls.size(); wall++)
+    {
+      imageWalls.push_back({ wall, NO_WALL });
+    }
+    for (size_t first = 0; first < walls.size(); first++)
+    {
+      for (size_t second = 0; second < walls.size(); second++)
+      {
+        if (second != first)
+        {
+          imageWalls.push_back({ first, second });
+        }
+      }
+    }
+
+    images.clear();
+  }
+
+  // Game thread: taps of the voices. The image sources of a voice are only found again when it or the listener moves further than the threshold.
+  void Update(const TxikiAudioListener& listener, TxikiAudioVoices3D& voices)
+  {
+    size_t numVoices = voices.Size();
+    size_t numTaps = imageWalls.size();
+    voices.numReflectionTaps = numTaps;
+    voices.numFirstOrderReflections = walls.size();
+    if (numTaps == 0)
+    {
+      return;
+    }
+
+    size_t paddedTaps = TxikiAudioSIMD::PaddedSize(numVoices * numTaps);
+    voices.reflectionDelays.assign(numVoices * numTaps, 0);
+    voices.reflectionGains.assign(numChannels * paddedTaps, 0.0f);
+    tapGains.assign(paddedTaps, 0.0f);
+    tapX.assign(paddedTaps, 0.0f);
+    tapZ.assign(paddedTaps, 0.0f);
+
+    glm::vec3 right, up, forward;
+    TxikiAudioSpatializer::GetListenerAxes(listener, right, up, forward);
+
+    for (size_t i = 0; i < numVoices; i++)
+    {
+      AudioSystemVector emitter{ voices.positionX[i], voices.positionY[i], voices.positionZ[i] };
+
+      Images& voiceImages = images[voices.sounds[i]];
+      if (voiceImages.positions.size() != numTaps || Distance(voiceImages.emitter, emitter) > moveThreshold || Distance(voiceImages.listener, listener.position) > moveThreshold)
+      {
+        FindImages(emitter, listener.position, voiceImages);
+      }
+
+      // the voice is heard at the distance it is attenuated for: taps are relative to it
+      float minDistance = std::max(voices.minDistance[i], 1e-4f);
+      float directDistance = Distance(voiceImages.emitter, voiceImages.listener);
+      for (size_t image = 0; image < numTaps; image++)
+      {
+        float reflection = voiceImages.reflections[image];
+        if (reflection <= 0.0f)
+        {
+          continue;
+        }
+
+        const AudioSystemVector& position = voiceImages.positions[image];
+        float distance = Distance(position, voiceImages.listener);
+        size_t delay = size_t((distance - directDistance) / speedOfSound * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz));
+        if (delay > maxDelayFrames)
+        {
+          continue;
+        }
+
+        size_t tap = i * numTaps + image;
+        voices.reflectionDelays[tap] = uint32_t(delay);
+        tapGains[tap] = reflection * std::max(directDistance, minDistance) / std::max(distance, minDistance);
+
+        // horizontal direction of the image in listener space
+        glm::vec3 direction(position.x - listener.position.x, position.y - listener.position.y, position.z - listener.position.z);
+        float x = glm::dot(direction, right);
+        float z = glm::dot(direction, forward);
+        float length = std::sqrt(x * x + z * z);
+        tapX[tap] = length > 1e-4f ? x / length : 0.0f;
+        tapZ[tap] = length > 1e-4f ? z / length : 0.0f;
+      }
+    }
+
+    Pan(paddedTaps, voices.reflectionGains.data());
+  }
+
+  // Audio thread: make room in the delay line for a buffer
+  void Begin(size_t frames)
+  {
+    size_t size = 1;
+    while (size < maxDelayFrames + frames)
+    {
+      size <<= 1;
+    }
+
+    if (delayLine.size() < size * numChannels)
+    {
+      delayLine.assign(size * numChannels, 0.0f);
+      mask = size - 1;
+      writePosition = 0;
+    }
+
+    if (filtered.size() < MAX_ORDER * frames)
+    {
+      filtered.resize(MAX_ORDER * frames);
+    }
+  }
+
+  // Audio thread: write the taps of a voice (one sample every inStride floats, as heard directly) into the delay line
+  void Mix(TxikiAudioSound& sound, const TxikiAudioVoices3D& voices, size_t voice, const float* in, size_t inStride, size_t frames, uint64_t mix)
+  {
+    size_t numTaps = voices.numReflectionTaps;
+    size_t paddedTaps = TxikiAudioSIMD::PaddedSize(voices.Size() * numTaps);
+    if (numTaps == 0)
+    {
+      return;
+    }
+
+    if (sound.reflectionMix + 1 != mix || sound.reflectionDelays.size() != numTaps)
+    {
+      // not mixed in the last buffer: no ramp
+      sound.reflectionDelays.assign(&voices.reflectionDelays[voice * numTaps], &voices.reflectionDelays[voice * numTaps] + numTaps);
+      sound.reflectionGains.resize(numTaps * MAX_CHANNELS);
+      for (size_t tap = 0; tap < numTaps; tap++)
+      {
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+          sound.reflectionGains[tap * MAX_CHANNELS + channel] = voices.reflectionGains[channel * paddedTaps + voice * numTaps + tap];
+        }
+      }
+      std::fill(std::begin(sound.reflectionLowPass), std::end(sound.reflectionLowPass), 0.0f);
+    }
+    sound.reflectionMix = mix;
+
+    // the voice filtered for each order
+    for (size_t order = 0; order < MAX_ORDER; order++)
+    {
+      float state = sound.reflectionLowPass[order];
+      float* out = &filtered[order * frames];
+      const float* source = order == 0 ? in : &filtered[(order - 1) * frames];
+      size_t stride = order == 0 ? inStride : 1;
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        state += (source[frame * stride] - state) * lowPass[order];
+        out[frame] = state;
+      }
+      sound.reflectionLowPass[order] = state;
+    }
+
+    float target[MAX_CHANNELS];
+    float zero[MAX_CHANNELS] = {};
+    for (size_t tap = 0; tap < numTaps; tap++)
+    {
+      size_t order = tap < voices.numFirstOrderReflections ? 0 : 1;
+      const float* signal = &filtered[order * frames];
+
+      bool silent = true;
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        target[channel] = voices.reflectionGains[channel * paddedTaps + voice * numTaps + tap];
+        silent = silent && target[channel] == 0.0f;
+      }
+
+      float* gains = &sound.reflectionGains[tap * MAX_CHANNELS];
+      uint32_t delay = voices.reflectionDelays[voice * numTaps + tap];
+      uint32_t& lastDelay = sound.reflectionDelays[tap];
+      if (delay == lastDelay)
+      {
+        if (!silent || std::any_of(gains, gains + numChannels, [](float gain) { return gain != 0.0f; }))
+        {
+          WriteTap(signal, frames, delay, gains, target);
+        }
+      }
+      else
+      {
+        // the tap moved: fade it out where it was and in where it is
+        WriteTap(signal, frames, lastDelay, gains, zero);
+        std::fill(gains, gains + numChannels, 0.0f);
+        WriteTap(signal, frames, delay, gains, target);
+        lastDelay = delay;
+      }
+    }
+  }
+
+  // Audio thread: add the reflections of the buffer to the mix
+  void End(float* out, size_t outStride, size_t frames)
+  {
+    if (delayLine.empty())
+    {
+      return;
+    }
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      float* tap = &delayLine[((writePosition + frame) & mask) * numChannels];
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        out[frame * outStride + channel] += tap[channel];
+        tap[channel] = 0.0f;
+      }
+    }
+
+    writePosition = (writePosition + frames) & mask;
+  }
+
+private:
+
+  static const size_t MAX_ORDER = 2;
+  static const size_t MAX_CHANNELS = TxikiAudioSound::MAX_OUTPUT_CHANNELS;
+  static const size_t NO_WALL = size_t(-1);
+
+  // image sources of a voice, for the emitter and listener positions they were found for
+  struct Images
+  {
+    AudioSystemVector emitter{ 0.0f, 0.0f, 0.0f };
+    AudioSystemVector listener{ 0.0f, 0.0f, 0.0f };
+    std::vector<AudioSystemVector> positions;
+    std::vector<float> reflections; // gain of the walls on the path, 0 = no valid path
+  };
+
+  struct ImageWalls
+  {
+    size_t first;
+    size_t second; // NO_WALL for first order
+  };
+
+  void FindImages(const AudioSystemVector& emitter, const AudioSystemVector& listenerPosition, Images& outImages) const
+  {
+    outImages.emitter = emitter;
+    outImages.listener = listenerPosition;
+    outImages.positions.resize(imageWalls.size());
+    outImages.reflections.assign(imageWalls.size(), 0.0f);
+
+    // no reflections unless both are in the room
+    if (!IsInside(emitter, NO_WALL) || !IsInside(listenerPosition, NO_WALL))
+    {
+      return;
+    }
+
+    for (size_t image = 0; image < imageWalls.size(); image++)
+    {
+      const ImageWalls& path = imageWalls[image];
+      AudioSystemVector firstImage = Mirror(emitter, walls[path.first]);
+      if (path.second == NO_WALL)
+      {
+        // first order: always valid in a convex room
+        outImages.positions[image] = firstImage;
+        outImages.reflections[image] = walls[path.first].reflection;
+        continue;
+      }
+
+      AudioSystemVector secondImage = Mirror(firstImage, walls[path.second]);
+      outImages.positions[image] = secondImage;
+
+      // the path from the listener must hit the second wall, then the first one, inside the room
+      AudioSystemVector secondHit;
+      AudioSystemVector firstHit;
+      if (Hit(listenerPosition, secondImage, path.second, secondHit) && Hit(secondHit, firstImage, path.first, firstHit))
+      {
+        outImages.reflections[image] = walls[path.first].reflection * walls[path.second].reflection;
+      }
+    }
+  }
+
+  // Point where the segment crosses the wall, if it is on the wall side of the room
+  bool Hit(const AudioSystemVector& from, const AudioSystemVector& to, size_t wall, AudioSystemVector& outHit) const
+  {
+    float fromDistance = PlaneDistance(from, walls[wall]);
+    float toDistance = PlaneDistance(to, walls[wall]);
+    if (fromDistance < 0.0f || toDistance >= 0.0f)
+    {
+      return false;
+    }
+
+    float t = fromDistance / (fromDistance - toDistance);
+    outHit = { from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t, from.z + (to.z - from.z) * t };
+
+    return IsInside(outHit, wall);
+  }
+
+  // Inside the room, ignoring a wall
+  bool IsInside(const AudioSystemVector& point, size_t ignoredWall) const
+  {
+    for (size_t wall = 0; wall < walls.size(); wall++)
+    {
+      if (wall != ignoredWall && PlaneDistance(point, walls[wall]) < -1e-3f)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  static float PlaneDistance(const AudioSystemVector& point, const AudioSystemRoomWall& wall)
+  {
+    return point.x * wall.normal.x + point.y * wall.normal.y + point.z * wall.normal.z - wall.offset;
+  }
+
+  static AudioSystemVector Mirror(const AudioSystemVector& point, const AudioSystemRoomWall& wall)
+  {
+    float distance = 2.0f * PlaneDistance(point, wall);
+    return { point.x - wall.normal.x * distance, point.y - wall.normal.y * distance, point.z - wall.normal.z * distance };
+  }
+
+  static float Distance(const AudioSystemVector& a, const AudioSystemVector& b)
+  {
+    float x = a.x - b.x;
+    float y = a.y - b.y;
+    float z = a.z - b.z;
+    return std::sqrt(x * x + y * y + z * z);
+  }
+
+  // Channel gains of the taps, one channel after another
+  void Pan(size_t paddedTaps, float* outGains) const
+  {
+    using namespace TxikiAudioSIMD;
+
+    if (numChannels == 2)
+    {
+      // equal-power, as the stereo voices
+      const TxikiAudioFloat4 quarterPi = Splat(0.785398163f);
+      for (size_t i = 0; i < paddedTaps; i += WIDTH)
+      {
+        TxikiAudioFloat4 gain = Load(&tapGains[i]);
+        TxikiAudioFloat4 angle = (Load(&tapX[i]) + Splat(1.0f)) * quarterPi;
+        Store(&outGains[i], gain * glm::max(glm::cos(angle), Splat(0.0f)));
+        Store(&outGains[paddedTaps + i], gain * glm::max(glm::sin(angle), Splat(0.0f)));
+      }
+      return;
+    }
+
+    speakers->Pan(tapX.data(), tapZ.data(), paddedTaps, outGains);
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+      for (size_t i = 0; i < paddedTaps; i += WIDTH)
+      {
+        Store(&outGains[channel * paddedTaps + i], Load(&outGains[channel * paddedTaps + i]) * Load(&tapGains[i]));
+      }
+    }
+  }
+
+  // Add a tap to the delay line, ramping its gains to the target ones
+  void WriteTap(const float* signal, size_t frames, uint32_t delay, float* gains, const float* targetGains)
+  {
+    float framesInverse = 1.0f / float(std::max(frames, size_t(1)));
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+      float gain = gains[channel];
+      float step = (targetGains[channel] - gain) * framesInverse;
+      size_t position = writePosition + delay;
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        delayLine[((position + frame) & mask) * numChannels + channel] += signal[frame] * gain;
+        gain += step;
+      }
+
+      gains[channel] = targetGains[channel];
+    }
+  }
+
+  const TxikiAudioSpeakers* speakers{ nullptr };
+  size_t numChannels{ 2 };
+  float speedOfSound{ 343.0f };
+  float moveThreshold{ 0.5f };
+  size_t maxDelayFrames{ 0 };
+  float lowPass[MAX_ORDER];
+
+  // game thread
+  std::vector<AudioSystemRoomWall> walls;
+  std::vector<ImageWalls> imageWalls;
+  std::unordered_map<const TxikiAudioSound*, Images> images;
+  std::vector<float> tapGains;
+  std::vector<float> tapX;
+  std::vector<float> tapZ;
+
+  // audio thread
+  std::vector<float> delayLine;
+  size_t mask{ 0 };
+  size_t writePosition{ 0 };
+  std::vector<float> filtered;
+};
+
+#endif // !TXIKI_AUDIO_EARLY_REFLECTIONS_H
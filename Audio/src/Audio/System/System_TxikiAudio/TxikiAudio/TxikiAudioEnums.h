@@ -1,6 +1,8 @@
 #ifndef TXIKI_AUDIO_ENUMS_H
 #define TXIKI_AUDIO_ENUMS_H
 
+#include "portaudio/portaudio.h"
+
 enum class TxikiAudioFileFormat
 {
   NONE = -1,
@@ -24,5 +26,14 @@ enum class TxikiAudioSoundSampleRate
   SampleRate_44100Hz = 44100
 };
 
+enum class TxikiAudioOutputLayout
+{
+  MONO,
+  STEREO,
+  QUAD,
+  SURROUND_5_1,
+  SURROUND_7_1
+};
+
 #endif // !TXIKI_AUDIO_ENUMS_H
 
@@ -0,0 +1,100 @@
+#ifndef TXIKI_AUDIO_FFT_H
+#define TXIKI_AUDIO_FFT_H
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+// TxikiAudioFFT
+//
+// Radix-2 complex FFT with precomputed twiddles, for power of two sizes
+class TxikiAudioFFT
+{
+public:
+
+  typedef std::complex<float> Complex;
+
+  void Init(size_t size_)
+  {
+    size = size_;
+
+    twiddles.resize(size / 2);
+    for (size_t k = 0; k < twiddles.size(); k++)
+    {
+      twiddles[k] = std::polar(1.0f, -2.0f * 3.14159265f * float(k) / float(size));
+    }
+
+    bitReverse.resize(size);
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size)
+    {
+      bits++;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+      size_t reversed = 0;
+      for (size_t bit = 0; bit < bits; bit++)
+      {
+        reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+      }
+      bitReverse[i] = reversed;
+    }
+  }
+
+  size_t GetSize() const { return size; }
+
+  void Forward(Complex* data) const
+  {
+    Transform(data, false);
+  }
+
+  // Note: scaled by 1 / size, so Inverse(Forward(x)) == x
+  void Inverse(Complex* data) const
+  {
+    Transform(data, true);
+
+    float scale = 1.0f / float(size);
+    for (size_t i = 0; i < size; i++)
+    {
+      data[i] *= scale;
+    }
+  }
+
+private:
+
+  void Transform(Complex* data, bool inverse) const
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      size_t j = bitReverse[i];
+      if (i < j)
+      {
+        std::swap(data[i], data[j]);
+      }
+    }
+
+    for (size_t length = 2; length <= size; length <<= 1)
+    {
+      size_t half = length / 2;
+      size_t step = size / length;
+      for (size_t start = 0; start < size; start += length)
+      {
+        for (size_t k = 0; k < half; k++)
+        {
+          Complex twiddle = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+          Complex u = data[start + k];
+          Complex v = data[start + k + half] * twiddle;
+          data[start + k] = u + v;
+          data[start + k + half] = u - v;
+        }
+      }
+    }
+  }
+
+  size_t size{ 0 };
+  std::vector<Complex> twiddles;
+  std::vector<size_t> bitReverse;
+};
+
+#endif // !TXIKI_AUDIO_FFT_H
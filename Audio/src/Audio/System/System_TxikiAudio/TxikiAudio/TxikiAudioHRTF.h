@@ -0,0 +1,322 @@
+#ifndef TXIKI_AUDIO_HRTF_H
+#define TXIKI_AUDIO_HRTF_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TxikiAudioConvolver.h"
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioVoices3D.h"
+
+// TxikiAudioHRIRSet
+//
+// Head related impulse responses measured in several directions.
+// File format (little endian):
+//   char     magic[4]       "TXHR"
+//   uint32_t version        1
+//   uint32_t sampleRate     must be the output sample rate
+//   uint32_t numDirections
+//   uint32_t length         frames of each impulse response
+//   numDirections times:
+//     float azimuth         degrees, 0 = front, 90 = left
+//     float elevation       degrees, 0 = horizon, 90 = up
+//     float left[length]
+//     float right[length]
+class TxikiAudioHRIRSet
+{
+public:
+
+  bool Load(const std::string& path)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+      printf("Error: Unable to open HRIR set %s\n", path.c_str());
+      return false;
+    }
+
+    char magic[4];
+    uint32_t header[4];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::string(magic, 4) != "TXHR" || header[0] != 1)
+    {
+      printf("Error: %s is not a HRIR set\n", path.c_str());
+      return false;
+    }
+
+    uint32_t sampleRate = header[1];
+    uint32_t numDirections = header[2];
+    length = header[3];
+    if (sampleRate != uint32_t(TxikiAudioSoundSampleRate::SampleRate_44100Hz) || numDirections == 0 || length == 0)
+    {
+      printf("Error: HRIR set %s not supported. Sample rate %u, %u directions of %zu frames\n", path.c_str(), sampleRate, numDirections, length);
+      return false;
+    }
+
+    directions.resize(numDirections * 3);
+    responses.resize(size_t(numDirections) * 2 * length);
+    for (uint32_t i = 0; i < numDirections; i++)
+    {
+      float angles[2];
+      file.read(reinterpret_cast<char*>(angles), sizeof(angles));
+      file.read(reinterpret_cast<char*>(&responses[size_t(i) * 2 * length]), sizeof(float) * 2 * length);
+
+      // in listener space: +X right, +Y up, +Z forward
+      float azimuth = angles[0] * DEGREES_TO_RADIANS;
+      float elevation = angles[1] * DEGREES_TO_RADIANS;
+      directions[i * 3] = -std::sin(azimuth) * std::cos(elevation);
+      directions[i * 3 + 1] = std::sin(elevation);
+      directions[i * 3 + 2] = std::cos(azimuth) * std::cos(elevation);
+    }
+
+    if (!file)
+    {
+      printf("Error: HRIR set %s is truncated\n", path.c_str());
+      directions.clear();
+      responses.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool IsLoaded() const { return !directions.empty(); }
+
+  size_t GetLength() const { return length; }
+
+  // Impulse responses of a direction in listener space, blended from the 3 closest measured directions
+  void Interpolate(float x, float y, float z, float* outLeft, float* outRight) const
+  {
+    float norm = std::sqrt(x * x + y * y + z * z);
+    if (norm < 1e-6f)
+    {
+      // on the listener: front
+      x = 0.0f;
+      y = 0.0f;
+      z = 1.0f;
+      norm = 1.0f;
+    }
+
+    size_t closest[3] = { 0, 0, 0 };
+    float closestDot[3] = { -2.0f, -2.0f, -2.0f };
+    size_t numDirections = directions.size() / 3;
+    for (size_t i = 0; i < numDirections; i++)
+    {
+      float dot = (x * directions[i * 3] + y * directions[i * 3 + 1] + z * directions[i * 3 + 2]) / norm;
+      for (size_t slot = 0; slot < 3; slot++)
+      {
+        if (dot > closestDot[slot])
+        {
+          for (size_t j = 2; j > slot; j--)
+          {
+            closest[j] = closest[j - 1];
+            closestDot[j] = closestDot[j - 1];
+          }
+          closest[slot] = i;
+          closestDot[slot] = dot;
+          break;
+        }
+      }
+    }
+
+    // weights by inverse angular distance
+    float weights[3];
+    float totalWeight = 0.0f;
+    size_t numClosest = std::min(numDirections, size_t(3));
+    for (size_t slot = 0; slot < numClosest; slot++)
+    {
+      float angle = std::acos(std::max(-1.0f, std::min(1.0f, closestDot[slot])));
+      weights[slot] = 1.0f / (angle + 1e-3f);
+      totalWeight += weights[slot];
+    }
+
+    std::fill(outLeft, outLeft + length, 0.0f);
+    std::fill(outRight, outRight + length, 0.0f);
+    for (size_t slot = 0; slot < numClosest; slot++)
+    {
+      float weight = weights[slot] / totalWeight;
+      const float* left = &responses[closest[slot] * 2 * length];
+      const float* right = left + length;
+      for (size_t i = 0; i < length; i++)
+      {
+        outLeft[i] += left[i] * weight;
+        outRight[i] += right[i] * weight;
+      }
+    }
+  }
+
+private:
+
+  static constexpr float DEGREES_TO_RADIANS = 3.14159265f / 180.0f;
+
+  size_t length{ 0 };
+  std::vector<float> directions;
+  std::vector<float> responses;
+};
+
+// TxikiAudioHRTF
+//
+// Binaural rendering of the loudest 3D voices. The other voices keep the cheaper stereo panning.
+class TxikiAudioHRTF
+{
+public:
+
+  bool Load(const std::string& path, size_t maxVoices, size_t blockSize)
+  {
+    if (!hrirs.Load(path))
+    {
+      return false;
+    }
+
+    size_t length = hrirs.GetLength();
+    size_t maxPartitions = (length + blockSize - 1) / blockSize;
+
+    voices.resize(maxVoices);
+    for (auto& voice : voices)
+    {
+      voice.convolver.Init(blockSize, maxPartitions);
+    }
+    slotSounds.assign(maxVoices, nullptr);
+
+    responseLeft.resize(length);
+    responseRight.resize(length);
+
+    return true;
+  }
+
+  bool IsLoaded() const { return hrirs.IsLoaded(); }
+
+  const TxikiAudioHRIRSet& GetHRIRs() const { return hrirs; }
+
+  // Game thread: choose the voices rendered binaurally. Voices keep their slot while they are chosen.
+  void AssignVoices(TxikiAudioVoices3D& voices3D)
+  {
+    voices3D.hrtfSlot.assign(voices3D.Size(), -1);
+    if (!IsLoaded())
+    {
+      return;
+    }
+
+    // the loudest playing voices
+    candidates.clear();
+    for (size_t i = 0; i < voices3D.Size(); i++)
+    {
+      if (voices3D.sounds[i]->state == TxikiAudioSound::State::PLAYING && voices3D.attenuation[i] > 0.0f)
+      {
+        candidates.push_back(i);
+      }
+    }
+
+    size_t numChosen = std::min(candidates.size(), slotSounds.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + numChosen, candidates.end(), [&voices3D](size_t a, size_t b)
+    {
+      return voices3D.attenuation[a] * voices3D.sounds[a]->volume > voices3D.attenuation[b] * voices3D.sounds[b]->volume;
+    });
+    candidates.resize(numChosen);
+
+    // keep the slots of the voices still chosen
+    for (size_t slot = 0; slot < slotSounds.size(); slot++)
+    {
+      bool chosen = false;
+      for (size_t candidate : candidates)
+      {
+        if (voices3D.sounds[candidate] == slotSounds[slot])
+        {
+          voices3D.hrtfSlot[candidate] = int(slot);
+          chosen = true;
+          break;
+        }
+      }
+
+      if (!chosen)
+      {
+        slotSounds[slot] = nullptr;
+      }
+    }
+
+    // and give the free slots to the new ones
+    size_t freeSlot = 0;
+    for (size_t candidate : candidates)
+    {
+      if (voices3D.hrtfSlot[candidate] >= 0)
+      {
+        continue;
+      }
+
+      while (slotSounds[freeSlot])
+      {
+        freeSlot++;
+      }
+
+      slotSounds[freeSlot] = voices3D.sounds[candidate];
+      voices3D.hrtfSlot[candidate] = int(freeSlot);
+    }
+  }
+
+  // Audio thread: sound and direction of a slot
+  void SetVoice(int slot, const TxikiAudioSound* sound, float x, float y, float z)
+  {
+    Voice& voice = voices[slot];
+    if (voice.sound != sound)
+    {
+      voice.sound = sound;
+      voice.convolver.Reset();
+      voice.hasFilter = false;
+    }
+
+    // new impulse responses when the direction changes by more than ~2 degrees
+    float dot = x * voice.direction[0] + y * voice.direction[1] + z * voice.direction[2];
+    if (voice.hasFilter && (dot > 0.9994f || voice.convolver.IsCrossfading()))
+    {
+      return;
+    }
+
+    voice.direction[0] = x;
+    voice.direction[1] = y;
+    voice.direction[2] = z;
+
+    hrirs.Interpolate(x, y, z, responseLeft.data(), responseRight.data());
+
+    voice.currentFilter = voice.hasFilter ? 1 - voice.currentFilter : 0;
+    TxikiAudioConvolverFilter& filter = voice.filters[voice.currentFilter];
+    filter.Set(voice.convolver.GetFFT(), responseLeft.data(), responseRight.data(), responseLeft.size(), voice.convolver.GetBlockSize());
+    voice.convolver.SetFilter(&filter);
+    voice.hasFilter = true;
+  }
+
+  // Audio thread: convolve the voice of a slot (interleaved stereo, both channels hold the same mono signal) into out
+  void Process(int slot, const float* in, float* out, size_t frames)
+  {
+    voices[slot].convolver.Process(in, TxikiAudioSound::NUM_CHANNELS, out, frames);
+  }
+
+private:
+
+  TxikiAudioHRIRSet hrirs;
+
+  // audio thread
+  struct Voice
+  {
+    const TxikiAudioSound* sound{ nullptr };
+    TxikiAudioConvolver convolver;
+    TxikiAudioConvolverFilter filters[2];
+    int currentFilter{ 0 };
+    bool hasFilter{ false };
+    float direction[3]{ 0.0f, 0.0f, 0.0f };
+  };
+
+  std::vector<Voice> voices;
+  std::vector<float> responseLeft;
+  std::vector<float> responseRight;
+
+  // game thread
+  std::vector<const TxikiAudioSound*> slotSounds;
+  std::vector<size_t> candidates;
+};
+
+#endif // !TXIKI_AUDIO_HRTF_H
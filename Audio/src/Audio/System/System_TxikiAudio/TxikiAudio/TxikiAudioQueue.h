@@ -0,0 +1,58 @@
+#ifndef TXIKI_AUDIO_QUEUE_H
+#define TXIKI_AUDIO_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// TxikiAudioQueue
+//
+// Lock-free queue of values from one writer thread to one reader thread, in a ring of CAPACITY values (a power of two).
+// Neither of them waits for the other: values pushed to a full queue are dropped.
+template <typename T, size_t CAPACITY>
+class TxikiAudioQueue
+{
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "TxikiAudioQueue capacity must be a power of two");
+
+public:
+
+  // Writer: false when the queue is full
+  bool Push(const T& value)
+  {
+    size_t write = writeCount.load(std::memory_order_relaxed);
+    if (write - readCount.load(std::memory_order_acquire) == CAPACITY)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    values[write & (CAPACITY - 1)] = value;
+    writeCount.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Reader: false when the queue is empty
+  bool Pop(T& outValue)
+  {
+    size_t read = readCount.load(std::memory_order_relaxed);
+    if (read == writeCount.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    outValue = values[read & (CAPACITY - 1)];
+    readCount.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+  // values dropped because the queue was full
+  std::atomic<size_t> dropped{ 0 };
+
+private:
+
+  T values[CAPACITY];
+
+  std::atomic<size_t> writeCount{ 0 };
+  std::atomic<size_t> readCount{ 0 };
+};
+
+#endif // !TXIKI_AUDIO_QUEUE_H
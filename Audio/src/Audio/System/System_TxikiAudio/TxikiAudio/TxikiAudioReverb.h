@@ -0,0 +1,206 @@
+#ifndef TXIKI_AUDIO_REVERB_H
+#define TXIKI_AUDIO_REVERB_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "..\..\System_Common\AudioSystemDefines.h"
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioSIMD.h"
+
+// TxikiAudioReverb
+//
+// Feedback delay network of 8 lines shared by all the voices: they are sent to it and it is run once per buffer.
+// The lines are processed 4 at a time, fed back through a Householder matrix, damped by a one-pole low-pass
+// and attenuated so the tail falls 60 dB in the decay time.
+class TxikiAudioReverb
+{
+public:
+
+  static const size_t NUM_LINES = 8;
+
+  // Note: off (no wet level) until the settings are set
+  void Init(float maxPreDelay)
+  {
+    // lengths in ms, rounded to prime numbers of frames so they are mutually prime and the echoes do not pile up
+    const float lineLengths[NUM_LINES] = { 29.7f, 37.1f, 41.1f, 43.7f, 53.3f, 59.9f, 67.7f, 73.1f };
+
+    float sampleRate = float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    size_t maxLength = 0;
+    for (size_t line = 0; line < NUM_LINES; line++)
+    {
+      lengths[line] = NearestPrime(size_t(lineLengths[line] * 0.001f * sampleRate));
+      maxLength = std::max(maxLength, lengths[line]);
+    }
+
+    lineSize = RoundUpToPowerOfTwo(maxLength + 1);
+    lines.assign(lineSize * NUM_LINES, 0.0f);
+
+    preDelaySize = RoundUpToPowerOfTwo(size_t(maxPreDelay * sampleRate) + 1);
+    preDelayBuffer.assign(preDelaySize * 2, 0.0f);
+
+    AudioSystemReverb off;
+    off.wetLevel = 0.0f;
+    SetSettings(off);
+  }
+
+  // Audio thread: the coefficients are only computed again when the settings change
+  void SetSettings(const AudioSystemReverb& settings_)
+  {
+    if (settings_.decayTime == settings.decayTime && settings_.damping == settings.damping && settings_.preDelay == settings.preDelay && settings_.wetLevel == settings.wetLevel)
+    {
+      return;
+    }
+    settings = settings_;
+
+    float sampleRate = float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    float decayFrames = std::max(settings.decayTime, 0.01f) * sampleRate;
+
+    float gains[NUM_LINES];
+    for (size_t line = 0; line < NUM_LINES; line++)
+    {
+      // -60 dB after decayFrames: 10^(-3 length / decayFrames) per trip through the line
+      gains[line] = std::pow(10.0f, -3.0f * float(lengths[line]) / decayFrames);
+    }
+    decayGains[0] = TxikiAudioSIMD::Load(&gains[0]);
+    decayGains[1] = TxikiAudioSIMD::Load(&gains[4]);
+
+    // damping 0 = 20 kHz cutoff, 1 = 1 kHz cutoff
+    float damping = std::min(std::max(settings.damping, 0.0f), 1.0f);
+    float cutoff = 20000.0f * std::pow(1000.0f / 20000.0f, damping);
+    damp = TxikiAudioSIMD::Splat(1.0f - std::exp(-2.0f * 3.14159265f * cutoff / sampleRate));
+
+    preDelay = std::min(size_t(std::max(settings.preDelay, 0.0f) * sampleRate), preDelaySize - 1);
+    wetGain = std::max(settings.wetLevel, 0.0f);
+  }
+
+  bool IsEnabled() const { return !lines.empty() && wetGain > 0.0f; }
+  float GetWetGain() const { return wetGain; }
+
+  // Audio thread: run the network over the stereo send buffer and add the tail to the stereo output
+  void Process(const float* in, float* out, size_t outStride, size_t frames)
+  {
+    // the left input feeds lines 0-3 and the right one lines 4-7. Each output takes every other line.
+    static const float INPUT_SCALE = 0.5f;
+    static const float OUTPUT_SCALE = 0.5f;
+    static const float HOUSEHOLDER = 2.0f / float(NUM_LINES);
+
+    size_t mask = lineSize - 1;
+    size_t preDelayMask = preDelaySize - 1;
+    float* l = lines.data();
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      // pre-delay
+      preDelayBuffer[preDelayPosition * 2] = in[frame * 2];
+      preDelayBuffer[preDelayPosition * 2 + 1] = in[frame * 2 + 1];
+      size_t delayed = (preDelayPosition - preDelay) & preDelayMask;
+      float inLeft = preDelayBuffer[delayed * 2] * INPUT_SCALE;
+      float inRight = preDelayBuffer[delayed * 2 + 1] * INPUT_SCALE;
+      preDelayPosition = (preDelayPosition + 1) & preDelayMask;
+
+      // read the end of the lines
+      TxikiAudioFloat4 a(
+        l[0 * lineSize + ((position - lengths[0]) & mask)],
+        l[1 * lineSize + ((position - lengths[1]) & mask)],
+        l[2 * lineSize + ((position - lengths[2]) & mask)],
+        l[3 * lineSize + ((position - lengths[3]) & mask)]);
+      TxikiAudioFloat4 b(
+        l[4 * lineSize + ((position - lengths[4]) & mask)],
+        l[5 * lineSize + ((position - lengths[5]) & mask)],
+        l[6 * lineSize + ((position - lengths[6]) & mask)],
+        l[7 * lineSize + ((position - lengths[7]) & mask)]);
+
+      // damping and decay
+      lowPass[0] += (a - lowPass[0]) * damp;
+      lowPass[1] += (b - lowPass[1]) * damp;
+      a = lowPass[0] * decayGains[0];
+      b = lowPass[1] * decayGains[1];
+
+      out[frame * outStride] += (a.x + a.z + b.x + b.z) * OUTPUT_SCALE * wetGain;
+      out[frame * outStride + 1] += (a.y + a.w + b.y + b.w) * OUTPUT_SCALE * wetGain;
+
+      // Householder feedback: x - 2/N sum(x)
+      TxikiAudioFloat4 sum = a + b;
+      TxikiAudioFloat4 reflection = TxikiAudioSIMD::Splat((sum.x + sum.y + sum.z + sum.w) * HOUSEHOLDER);
+      a = a - reflection + TxikiAudioSIMD::Splat(inLeft);
+      b = b - reflection + TxikiAudioSIMD::Splat(inRight);
+
+      l[0 * lineSize + position] = a.x;
+      l[1 * lineSize + position] = a.y;
+      l[2 * lineSize + position] = a.z;
+      l[3 * lineSize + position] = a.w;
+      l[4 * lineSize + position] = b.x;
+      l[5 * lineSize + position] = b.y;
+      l[6 * lineSize + position] = b.z;
+      l[7 * lineSize + position] = b.w;
+      position = (position + 1) & mask;
+    }
+  }
+
+private:
+
+  static size_t RoundUpToPowerOfTwo(size_t value)
+  {
+    size_t size = 1;
+    while (size < value)
+    {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  static bool IsPrime(size_t value)
+  {
+    if (value < 2)
+    {
+      return false;
+    }
+
+    for (size_t divisor = 2; divisor * divisor <= value; divisor++)
+    {
+      if (value % divisor == 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static size_t NearestPrime(size_t value)
+  {
+    for (size_t offset = 0; ; offset++)
+    {
+      if (IsPrime(value + offset))
+      {
+        return value + offset;
+      }
+
+      if (offset < value && IsPrime(value - offset))
+      {
+        return value - offset;
+      }
+    }
+  }
+
+  // lines one after another, lineSize frames each
+  std::vector<float> lines;
+  size_t lineSize{ 0 };
+  size_t lengths[NUM_LINES];
+  size_t position{ 0 };
+
+  // stereo ring of the pre-delay
+  std::vector<float> preDelayBuffer;
+  size_t preDelaySize{ 0 };
+  size_t preDelayPosition{ 0 };
+  size_t preDelay{ 0 };
+
+  AudioSystemReverb settings{ -1.0f, -1.0f, -1.0f, -1.0f };
+  TxikiAudioFloat4 decayGains[2];
+  TxikiAudioFloat4 damp;
+  TxikiAudioFloat4 lowPass[2]{ TxikiAudioSIMD::Splat(0.0f), TxikiAudioSIMD::Splat(0.0f) };
+  float wetGain{ 0.0f };
+};
+
+#endif // !TXIKI_AUDIO_REVERB_H
@@ -0,0 +1,59 @@
+#ifndef TXIKI_AUDIO_SIMD_H
+#define TXIKI_AUDIO_SIMD_H
+
+// Note: glm.hpp must be included before type_aligned.hpp
+#include "glm/glm.hpp"
+#include "glm/gtc/type_aligned.hpp"
+
+// 4 floats processed at once (SSE when glm supports it for the target)
+typedef glm::aligned_vec4 TxikiAudioFloat4;
+
+namespace TxikiAudioSIMD
+{
+  static const size_t WIDTH = 4;
+
+  // Number of lanes needed for count values
+  inline size_t PaddedSize(size_t count)
+  {
+    return (count + WIDTH - 1) & ~(WIDTH - 1);
+  }
+
+  // Note: always build the lanes from floats. glm reinterprets the bits of int arguments for aligned types.
+  inline TxikiAudioFloat4 Splat(float value)
+  {
+    return TxikiAudioFloat4(value, value, value, value);
+  }
+
+  inline TxikiAudioFloat4 Load(const float* values)
+  {
+    return TxikiAudioFloat4(values[0], values[1], values[2], values[3]);
+  }
+
+  inline void Store(float* values, const TxikiAudioFloat4& lanes)
+  {
+    values[0] = lanes.x;
+    values[1] = lanes.y;
+    values[2] = lanes.z;
+    values[3] = lanes.w;
+  }
+
+  // Highest absolute value of count values
+  inline float Peak(const float* values, size_t count)
+  {
+    TxikiAudioFloat4 peaks = Splat(0.0f);
+    size_t i = 0;
+    for (; i + WIDTH <= count; i += WIDTH)
+    {
+      peaks = glm::max(peaks, glm::abs(Load(&values[i])));
+    }
+
+    float peak = glm::max(glm::max(peaks.x, peaks.y), glm::max(peaks.z, peaks.w));
+    for (; i < count; i++)
+    {
+      peak = glm::max(peak, glm::abs(values[i]));
+    }
+    return peak;
+  }
+}
+
+#endif // !TXIKI_AUDIO_SIMD_H
@@ -1,21 +1,51 @@
 #ifndef TXIKI_AUDIO_SOUND_H
 #define TXIKI_AUDIO_SOUND_H
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <memory>
+#include <vector>
 
 #include "..\..\System_Common\AudioSystemCommon.h"
+#include "TxikiAudioBiquads.h"
+#include "TxikiAudioBus.h"
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioQueue.h"
+#include "TxikiAudioStream.h"
+#include "TxikiAudioTripleBuffer.h"
+
+class TxikiAudioSound;
+
+// Event raised by a sound in the audio thread. The generation tells events of a released sound from the ones of the sound reusing it.
+struct TxikiAudioSoundEvent
+{
+  TxikiAudioSound* sound{ nullptr };
+  uint32_t generation{ 0 };
+  AudioSystemSoundEvent event;
+};
+
+using TxikiAudioSoundEvents = TxikiAudioQueue<TxikiAudioSoundEvent, 256>;
 
 class TxikiAudioSound : public IAudioSystemSound
 {
 public:
 
-  static const size_t NUM_CHANNELS = 2;
+  static const size_t NUM_CHANNELS = TxikiAudioSoundDesc::NUM_CHANNELS;
+  static const size_t MAX_AMBISONIC_CHANNELS = 16; // third order
+  static const size_t MAX_OUTPUT_CHANNELS = 8;     // 7.1
 
   size_t numSamples{ 0 };
 
-  std::unique_ptr< short[] > samples;
+  // samples played, owned by samplesBuffer or by a mounted sound bank
+  const short* samples{ nullptr };
+  std::unique_ptr< short[] > samplesBuffer;
+
+  // or samples streamed from disk
+  std::unique_ptr<TxikiAudioStream> stream;
 
-  size_t sampleIndex{ 0 };
+  // position in frames (Note: it is fractional when the pitch is not 1.0f)
+  double framePosition{ 0.0 };
 
   enum class State
   {
@@ -26,49 +56,229 @@ public:
 
   State state{ State::STOPPED };
 
+  // stream time the sound starts at, written by the game thread before the state (negative = at the next buffer)
+  std::atomic<double> startTime{ -1.0 };
+
   float volume{ 1.0f };
   float pitch{ 1.0f };
 
+  // fade of the volume, written by the game thread and published by fadeRequest. The audio thread ramps it.
+  struct Fade
+  {
+    float from{ 1.0f }; // negative = from the gain the sound is at
+    float to{ 1.0f };
+    float time{ 0.0f }; // seconds
+    State endState{ State::PLAYING }; // state of the sound once faded
+  };
+
+  Fade fade;
+  std::atomic<uint32_t> fadeRequest{ 0 };
+
   float basePitch{ 1.0f };
 
+  // bus the sound is mixed in (null = master)
+  TxikiAudioBus* bus{ nullptr };
+
+  // low-pass and high-pass filter, written by the game thread
+  AudioSystemFilter filter;
+
+  // 3D attributes, written by the game thread. The audio thread gets them through TxikiAudioVoices3D.
+  bool is3D{ false };
+  AudioSystemVector position{ 0.0f, 0.0f, 0.0f };
+  AudioSystemVector velocity{ 0.0f, 0.0f, 0.0f };
+  float minDistance{ 1.0f };
+  float maxDistance{ 10000.0f };
+  AudioSystemRolloff rolloff;
+  float occlusionGain{ 1.0f };
+  float occlusionLowPassCutoff{ 22000.0f };
+
+  // level of the sound sent to the reverb, written by the game thread, and the level the audio thread ramps it from
+  float reverbSend{ 0.0f };
+  float mixReverbSend{ 0.0f };
+
+  // 3D gains and Doppler pitch factor, written by the audio thread for the mix numbered gains3DMix
+  float targetGains3D[NUM_CHANNELS]{ 0.0f, 0.0f };
+  float targetDoppler{ 1.0f };
+  float targetLowPassCutoff{ 22000.0f }; // occlusion and air absorption
+  int hrtfSlot{ -1 };
+
+  // ambisonic encoding gains, written and ramped by the audio thread
+  float targetAmbisonicGains[MAX_AMBISONIC_CHANNELS]{};
+  float ambisonicGains[MAX_AMBISONIC_CHANNELS]{};
+  uint64_t ambisonicMix{ 0 };
+
+  // speaker gains of the multichannel layouts, written and ramped by the audio thread
+  float targetSpeakerGains[MAX_OUTPUT_CHANNELS]{};
+  float speakerGains[MAX_OUTPUT_CHANNELS]{};
+  uint64_t speakerMix{ 0 };
+
+  // early reflections: tap gains and delays of the last buffer, and the filters of each order, written by the audio thread
+  std::vector<float> reflectionGains;
+  std::vector<uint32_t> reflectionDelays;
+  float reflectionLowPass[2]{ 0.0f, 0.0f };
+  uint64_t reflectionMix{ 0 };
+
+  // filter state of the last buffer filtered, written by the audio thread
+  TxikiAudioBiquadState biquadState;
+  uint64_t biquadMix{ 0 };
+
+  // index of the sound in the 3D voices of the mix numbered gains3DMix
+  size_t voice3D{ 0 };
+  uint64_t gains3DMix{ 0 };
+
+  bool loop{ false };
+
+  // loop points in frames read from the file (end 0 = none)
+  size_t fileLoopStart{ 0 };
+  size_t fileLoopEnd{ 0 };
+
+  // loop region and crossfade at its seam in frames, written by the game thread (end 0 = end of the sound)
+  size_t loopStart{ 0 };
+  size_t loopEnd{ 0 };
+  size_t loopCrossfade{ 0 };
+
+  // frames raising marker events, sorted, handed off to the audio thread
+  TxikiAudioTripleBuffer<std::vector<uint64_t>> markers;
+
+  // queue the audio thread posts the events to, and the times the sound was released
+  TxikiAudioSoundEvents* events{ nullptr };
+  std::atomic<uint32_t> generation{ 0 };
+
+  // nonblocking loads are done in the I/O thread
+  enum class LoadState
+  {
+    UNLOADED,
+    LOADING,
+    LOADED,
+    FAILED
+  };
+
+  std::atomic<LoadState> loadState{ LoadState::UNLOADED };
+
+  // played once its nonblocking load is done
+  bool pendingPlay{ false };
+  float pendingPlayFadeTime{ 0.0f };
+
+  // game thread: played since it was loaded, as the mixer only reads the sounds played
+  bool played{ false };
+
   bool Release() final
   {
-    Stop();
+    Stop(0.0f);
 
     numSamples = 0;
 
-    samples.reset();
-
-    sampleIndex = 0;
+    samples = nullptr;
+    samplesBuffer.reset();
+    stream.reset();
+
+    framePosition = 0.0;
+
+    loop = false;
+    fileLoopStart = fileLoopEnd = 0;
+    loopStart = loopEnd = loopCrossfade = 0;
+    SetMarkers(std::vector<float>());
+    generation++;
+    bus = nullptr;
+    filter = AudioSystemFilter();
+    is3D = false;
+    minDistance = 1.0f;
+    maxDistance = 10000.0f;
+    rolloff = AudioSystemRolloff();
+    occlusionGain = 1.0f;
+    occlusionLowPassCutoff = 22000.0f;
+    reverbSend = 0.0f;
+    loadState = LoadState::UNLOADED;
+    played = false;
 
     return true;
   }
 
-  bool Play() final
+  // in use, even if it is still loading or it failed to load
+  bool IsLoaded() const
+  {
+    return loadState != LoadState::UNLOADED;
+  }
+
+  bool IsReady() final
+  {
+    return loadState == LoadState::LOADED;
+  }
+
+  bool Play(float fadeTime) final
+  {
+    return PlayAt(-1.0, fadeTime);
+  }
+
+  bool PlayAt(double time, float fadeTime) final
   {
+    startTime.store(time, std::memory_order_release);
+
+    if (loadState == LoadState::LOADING)
+    {
+      // played by TxikiAudio::Update once loaded
+      pendingPlay = true;
+      pendingPlayFadeTime = fadeTime;
+      return true;
+    }
+
+    if (loadState != LoadState::LOADED)
+    {
+      printf("Error: Unable to play sound. Sound not loaded\n");
+      return false;
+    }
+
+    // fade in from silence, or from the gain of a sound still playing
+    bool fading = fadeTime > 0.0f;
+    RequestFade(fading ? (state == State::PLAYING ? -1.0f : 0.0f) : 1.0f, 1.0f, fadeTime, State::PLAYING);
+
+    played = true;
     state = State::PLAYING;
     return true;
   }
 
-  bool Stop() final
+  bool Stop(float fadeTime) final
   {
-    // reset
-    sampleIndex = 0;
-    state = State::STOPPED;
-    volume = 1.0f;
-    pitch = basePitch;
+    pendingPlay = false;
+
+    if (fadeTime > 0.0f && state == State::PLAYING && startTime.load(std::memory_order_relaxed) < 0.0)
+    {
+      // stopped by the audio thread once faded out
+      RequestFade(-1.0f, 0.0f, fadeTime, State::STOPPED);
+      return true;
+    }
+
+    RequestFade(1.0f, 1.0f, 0.0f, State::PLAYING);
+    StopNow();
 
     return true;
   }
 
-  bool Pause(bool pause) final
+  bool Pause(bool pause, float fadeTime) final
   {
     if (state == State::STOPPED)
     {
       return false;
     }
 
-    state = pause ? State::PAUSED : State::PLAYING;
+    bool fading = fadeTime > 0.0f;
+    if (pause)
+    {
+      if (fading && state == State::PLAYING)
+      {
+        // paused by the audio thread once faded out
+        RequestFade(-1.0f, 0.0f, fadeTime, State::PAUSED);
+        return true;
+      }
+
+      state = State::PAUSED;
+      return true;
+    }
+
+    // fade in from silence, or from the gain of a fade out in progress
+    RequestFade(fading ? (state == State::PAUSED ? 0.0f : -1.0f) : 1.0f, 1.0f, fadeTime, State::PLAYING);
+
+    state = State::PLAYING;
     return true;
   }
 
@@ -86,50 +296,515 @@ public:
     return true;
   }
 
-  void WriteSound(short* outBuffer, size_t framesPerBuffer)
+  bool SetBus(IAudioSystemBus* b) final
+  {
+    bus = static_cast<TxikiAudioBus*>(b);
+    return true;
+  }
+
+  // Audio thread: mix the sound into the float buffer of the mix numbered mix, heard from the stream time mixTime
+  void WriteSound(float* outBuffer, size_t framesPerBuffer, uint64_t mix, double mixTime)
   {
-    if (state != TxikiAudioSound::State::PLAYING)
+    if (state != TxikiAudioSound::State::PLAYING || (bus && bus->IsPaused()))
     {
       // do not write data when not playing
       return;
     }
 
-    if (sampleIndex >= numSamples)
+    // a scheduled sound starts at its frame of the buffer (late ones at the first frame)
+    double start = startTime.load(std::memory_order_acquire);
+    if (start >= 0.0)
+    {
+      double startFrame = std::round((start - mixTime) * double(TxikiAudioSoundSampleRate::SampleRate_44100Hz));
+      if (startFrame >= double(framesPerBuffer))
+      {
+        return;
+      }
+
+      // Note: a new start time set by the game thread meanwhile is kept
+      startTime.compare_exchange_strong(start, -1.0, std::memory_order_relaxed);
+      if (startFrame > 0.0)
+      {
+        outBuffer += size_t(startFrame) * NUM_CHANNELS;
+        framesPerBuffer -= size_t(startFrame);
+      }
+    }
+
+    float gain = bus ? volume * bus->GetGain() : volume;
+
+    // the fade is ramped by the gains of the buffer
+    float fadeStart = 1.0f;
+    float fadeEnd = UpdateFade(framesPerBuffer, fadeStart);
+
+    MixGains gains = GetMixGains(gain, fadeStart, fadeEnd, framesPerBuffer, mix);
+
+    // frames advanced per frame written
+    double step = double(pitch * GetMixDoppler(gains.mono, framesPerBuffer));
+
+    mixMarkers = &markers.Read();
+
+    if (stream)
+    {
+      WriteStream(outBuffer, framesPerBuffer, gains, step);
+    }
+    else
+    {
+      WriteSamples(outBuffer, framesPerBuffer, gains, step);
+    }
+
+    if (state == State::PLAYING && mixFadeEndState != State::PLAYING && mixFadeGain == mixFadeTarget)
+    {
+      // faded out: the sound is stopped or paused now it is silent
+      if (mixFadeEndState == State::STOPPED)
+      {
+        Finish();
+      }
+      else
+      {
+        state = mixFadeEndState;
+      }
+
+      mixFadeEndState = State::PLAYING;
+    }
+  }
+
+  void Set3DAttributes(const AudioSystemVector& position_, const AudioSystemVector& velocity_) final
+  {
+    is3D = true;
+    position = position_;
+    velocity = velocity_;
+  }
+
+  void Set3DMinMaxDistance(float minDistance_, float maxDistance_) final
+  {
+    // negative distances keep the defaults
+    if (minDistance_ < 0.0f || maxDistance_ < minDistance_)
     {
-      // no more audio data to write
-      Stop();
       return;
     }
 
-    size_t samplesPerBuffer = framesPerBuffer * NUM_CHANNELS;
-    size_t audioLength = size_t((float(numSamples - sampleIndex)) / pitch);
-    auto length = samplesPerBuffer > audioLength ? audioLength : samplesPerBuffer;
+    minDistance = minDistance_;
+    maxDistance = maxDistance_;
+  }
 
-    // copy the samples into the buffer (Note: We are only using PCM16 format!)
-    float fsampleIndex = (float)sampleIndex;
-    for (size_t i = 0; i < length; i++)
+  void Set3DRolloff(const AudioSystemRolloff& rolloff_) final
+  {
+    rolloff = rolloff_;
+  }
+
+  void Set3DOcclusion(float gain, float lowPassCutoff) final
+  {
+    occlusionGain = gain < 0.0f ? 0.0f : (gain > 1.0f ? 1.0f : gain);
+    occlusionLowPassCutoff = lowPassCutoff;
+  }
+
+  bool SetLoop(const AudioSystemLoop& loop_) final
+  {
+    if (loadState != LoadState::LOADED)
     {
-      float value = float(samples[(size_t)fsampleIndex]) * volume;
-      outBuffer[i] += (short)value;
+      printf("Error: Unable to set loop of sound. Sound not loaded\n");
+      return false;
+    }
 
-      fsampleIndex += pitch;
+    if (stream)
+    {
+      // streams loop the whole sound, as opened
+      if (loop_.enabled != stream->IsLooping() || loop_.start >= 0.0f || loop_.end >= 0.0f || loop_.crossfade > 0.0f)
+      {
+        printf("Error: Unable to set loop of sound. Streamed sounds loop the whole sound when loaded with AudioSystemSoundMode_LOOP\n");
+        return false;
+      }
+
+      return true;
     }
 
-    sampleIndex = audioLength > 1 ? (size_t)fsampleIndex : numSamples;
+    // frames of the sound per second
+    double frameRate = double(basePitch) * double(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    size_t numFrames = numSamples / NUM_CHANNELS;
+
+    size_t start = loop_.start >= 0.0f ? size_t(double(loop_.start) * frameRate) : fileLoopStart;
+    size_t end = loop_.end >= 0.0f ? size_t(double(loop_.end) * frameRate) : fileLoopEnd;
+    if (start >= numFrames || (end > 0 && end <= start))
+    {
+      printf("Error: Unable to set loop of sound. Loop start %f and end %f out of the sound\n", loop_.start, loop_.end);
+      return false;
+    }
+
+    loopStart = start;
+    loopEnd = end;
+    loopCrossfade = loop_.crossfade > 0.0f ? size_t(double(loop_.crossfade) * frameRate) : 0;
+    loop = loop_.enabled;
+
+    return true;
+  }
+
+  bool SetMarkers(const std::vector<float>& times) final
+  {
+    // frames of the sound per second
+    double frameRate = double(basePitch) * double(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
 
-    return;
+    std::vector<uint64_t>& frames = markers.GetWriteBuffer();
+    frames.clear();
+    for (float time : times)
+    {
+      frames.push_back(uint64_t(std::round(double(std::max(time, 0.0f)) * frameRate)));
+    }
+    std::sort(frames.begin(), frames.end());
+
+    markers.Publish();
+    return true;
   }
 
-  void Set3DAttributes(const AudioSystemVector& position, const AudioSystemVector& velocity) final
+  bool SetFilter(const AudioSystemFilter& filter_) final
   {
-    // TO-DO
+    filter = filter_;
+    return true;
   }
 
-  void Set3DMinMaxDistance(float minDistance, float maxDistance) final
+  bool SetReverbSend(float level) final
   {
-    // TO-DO
+    reverbSend = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+    return true;
   }
+
+private:
+
+  // Gains of a buffer, ramped from the gains of the previous buffer to avoid clicks
+  struct MixGains
+  {
+    float left;
+    float right;
+    float stepLeft;
+    float stepRight;
+    bool mono; // 3D sounds are downmixed to mono before being panned
+  };
+
+  void StopNow()
+  {
+    // reset
+    startTime.store(-1.0, std::memory_order_relaxed);
+    framePosition = 0.0;
+    state = State::STOPPED;
+
+    if (stream)
+    {
+      stream->RequestRewind();
+    }
+
+    volume = 1.0f;
+    pitch = basePitch;
+  }
+
+  // Audio thread: the sound reached its end
+  void Finish()
+  {
+    StopNow();
+    PostEvent(AudioSystemSoundEventType::FINISHED);
+  }
+
+  void PostEvent(AudioSystemSoundEventType type, size_t marker = 0)
+  {
+    if (events)
+    {
+      TxikiAudioSoundEvent soundEvent;
+      soundEvent.sound = this;
+      soundEvent.generation = generation.load(std::memory_order_relaxed);
+      soundEvent.event.type = type;
+      soundEvent.event.marker = marker;
+      events->Push(soundEvent);
+    }
+  }
+
+  // Audio thread: post the markers in the frames [from, to) of the sound
+  void PostMarkers(double from, double to)
+  {
+    const std::vector<uint64_t>& frames = *mixMarkers;
+    for (size_t marker = 0; marker < frames.size() && double(frames[marker]) < to; marker++)
+    {
+      if (double(frames[marker]) >= from)
+      {
+        PostEvent(AudioSystemSoundEventType::MARKER, marker);
+      }
+    }
+  }
+
+  // Audio thread: frames of a looping stream keep counting after its end, so its markers are posted loop by loop
+  void PostStreamEvents(double from, double to)
+  {
+    double numFrames = double(stream->GetNumFrames());
+    if (!stream->IsLooping() || numFrames <= 0.0)
+    {
+      PostMarkers(from, to);
+      return;
+    }
+
+    double loopStartFrame = std::floor(from / numFrames) * numFrames;
+    while (from < to)
+    {
+      double loopEndFrame = loopStartFrame + numFrames;
+      PostMarkers(from - loopStartFrame, std::min(to, loopEndFrame) - loopStartFrame);
+      if (to >= loopEndFrame)
+      {
+        PostEvent(AudioSystemSoundEventType::LOOPED);
+      }
+
+      from = loopStartFrame = loopEndFrame;
+    }
+  }
+
+  void RequestFade(float from, float to, float time, State endState)
+  {
+    fade.from = from;
+    fade.to = to;
+    fade.time = time;
+    fade.endState = endState;
+    fadeRequest.fetch_add(1, std::memory_order_release);
+  }
+
+  // Audio thread: gain of the fade at the end of the buffer, and at its start
+  float UpdateFade(size_t framesPerBuffer, float& outStartGain)
+  {
+    uint32_t request = fadeRequest.load(std::memory_order_acquire);
+    if (request != mixFadeRequest)
+    {
+      mixFadeRequest = request;
+      mixFadeGain = fade.from >= 0.0f ? fade.from : mixFadeGain;
+      mixFadeTarget = fade.to;
+      mixFadeEndState = fade.endState;
+
+      // fades from the gain the sound is at take the same time, whatever the gain
+      float fadeFrames = fade.time * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+      mixFadeStep = fadeFrames >= 1.0f ? std::abs(mixFadeTarget - mixFadeGain) / fadeFrames : 1.0f;
+    }
+
+    outStartGain = mixFadeGain;
+
+    float delta = mixFadeStep * float(framesPerBuffer);
+    mixFadeGain = mixFadeGain < mixFadeTarget ? std::min(mixFadeGain + delta, mixFadeTarget) : std::max(mixFadeGain - delta, mixFadeTarget);
+
+    return mixFadeGain;
+  }
+
+  // Note: the fade is not kept in mixGains, as a fade may start from another gain than the one it ended at
+  MixGains GetMixGains(float gain, float fadeStart, float fadeEnd, size_t framesPerBuffer, uint64_t mix)
+  {
+    MixGains gains;
+
+    // 3D gains are only valid for the mix they were computed for
+    gains.mono = is3D && gains3DMix == mix;
+
+    float targetLeft = gains.mono ? gain * targetGains3D[0] : gain;
+    float targetRight = gains.mono ? gain * targetGains3D[1] : gain;
+
+    if (gains.mono != mixedMono)
+    {
+      // no ramp when switching between 2D and 3D
+      mixGains[0] = targetLeft;
+      mixGains[1] = targetRight;
+      mixedMono = gains.mono;
+    }
+
+    float frames = float(std::max(framesPerBuffer, size_t(1)));
+    gains.left = mixGains[0] * fadeStart;
+    gains.right = mixGains[1] * fadeStart;
+    gains.stepLeft = (targetLeft * fadeEnd - gains.left) / frames;
+    gains.stepRight = (targetRight * fadeEnd - gains.right) / frames;
+
+    mixGains[0] = targetLeft;
+    mixGains[1] = targetRight;
+
+    return gains;
+  }
+
+  // Doppler factor of the buffer, smoothed across buffers so the pitch does not jump
+  float GetMixDoppler(bool is3DMix, size_t framesPerBuffer)
+  {
+    if (!is3DMix)
+    {
+      mixDoppler = 1.0f;
+      return mixDoppler;
+    }
+
+    // about 50ms to reach the target
+    static const float SMOOTHING_FRAMES = 0.05f * float(TxikiAudioSoundSampleRate::SampleRate_44100Hz);
+    float smoothing = 1.0f - std::exp(-float(framesPerBuffer) / SMOOTHING_FRAMES);
+    mixDoppler += (targetDoppler - mixDoppler) * smoothing;
+
+    return mixDoppler;
+  }
+
+  void MixFrame(float* out, const short* frame, MixGains& gains)
+  {
+    MixFrame(out, float(frame[0]), float(frame[1]), gains);
+  }
+
+  // frame of the end of the loop faded by fade in [0, 1) into the frame before the start of the loop
+  void MixFrame(float* out, const short* frame, const short* fadeInFrame, float fade, MixGains& gains)
+  {
+    float left = float(frame[0]) + (float(fadeInFrame[0]) - float(frame[0])) * fade;
+    float right = float(frame[1]) + (float(fadeInFrame[1]) - float(frame[1])) * fade;
+    MixFrame(out, left, right, gains);
+  }
+
+  void MixFrame(float* out, float left, float right, MixGains& gains)
+  {
+    static const float SAMPLE_SCALE = 1.0f / 32768.0f;
+
+    left *= SAMPLE_SCALE;
+    right *= SAMPLE_SCALE;
+    if (gains.mono)
+    {
+      left = right = (left + right) * 0.5f;
+    }
+
+    out[0] += left * gains.left;
+    out[1] += right * gains.right;
+
+    gains.left += gains.stepLeft;
+    gains.right += gains.stepRight;
+  }
+
+  // Mix the samples in memory, looping between the loop points
+  void WriteSamples(float* outBuffer, size_t framesPerBuffer, MixGains& gains, double step)
+  {
+    size_t numFrames = numSamples / NUM_CHANNELS;
+
+    // loop region, checked here as the game thread may be changing it
+    size_t loopEndFrame = loopEnd > 0 ? std::min(loopEnd, numFrames) : numFrames;
+    size_t loopStartFrame = loopStart < loopEndFrame ? loopStart : 0;
+    size_t loopLength = loopEndFrame - loopStartFrame;
+    bool looping = loop && loopLength > 0;
+
+    // the end of the loop fades into the frames before its start. Without enough of them (e.g. a loop starting at frame 0)
+    // it fades into the first frames of the loop too, and the loop wraps past them: it is shorter by wrapOffset frames.
+    size_t crossfade = looping ? std::min(loopCrossfade, loopLength / 2) : 0;
+    size_t wrapOffset = crossfade - std::min(crossfade, loopStartFrame);
+    size_t endFrame = looping ? loopEndFrame : numFrames;
+    size_t fadeFrame = endFrame - crossfade;
+
+    size_t frame = 0;
+    while (frame < framesPerBuffer)
+    {
+      if (framePosition >= double(endFrame))
+      {
+        if (!looping)
+        {
+          // no more audio data to write
+          Finish();
+          return;
+        }
+
+        // loop back to the start of the loop, past the frames already faded in
+        double wrapFrame = double(loopStartFrame + wrapOffset);
+        framePosition = wrapFrame + std::fmod(framePosition - double(endFrame), double(loopLength - wrapOffset));
+        PostEvent(AudioSystemSoundEventType::LOOPED);
+        continue;
+      }
+
+      // runs end at the crossfade and at the end, so the frames are mixed without checks
+      bool fading = framePosition >= double(fadeFrame);
+      double runEnd = double(fading ? endFrame : fadeFrame);
+      size_t framesLeft = size_t(std::ceil((runEnd - framePosition) / step));
+      size_t length = std::min(framesPerBuffer - frame, framesLeft);
+
+      // mix the frames into the buffer (Note: We are only using PCM16 format!)
+      float* out = &outBuffer[frame * NUM_CHANNELS];
+      double position = framePosition;
+      if (!fading)
+      {
+        for (size_t i = 0; i < length; i++)
+        {
+          MixFrame(&out[i * NUM_CHANNELS], &samples[size_t(position) * NUM_CHANNELS], gains);
+
+          position += step;
+        }
+      }
+      else
+      {
+        float fadeScale = 1.0f / float(crossfade);
+        for (size_t i = 0; i < length; i++)
+        {
+          size_t index = size_t(position);
+          float fade = float(position - double(fadeFrame)) * fadeScale;
+          MixFrame(&out[i * NUM_CHANNELS], &samples[index * NUM_CHANNELS], &samples[(index + wrapOffset - loopLength) * NUM_CHANNELS], fade, gains);
+
+          position += step;
+        }
+      }
+
+      PostMarkers(framePosition, position);
+
+      framePosition = position;
+      frame += length;
+    }
+  }
+
+  void WriteStream(float* outBuffer, size_t framesPerBuffer, MixGains& gains, double step)
+  {
+    if (!stream->TryLockRead())
+    {
+      // the stream is being rewound
+      return;
+    }
+
+    // a looping stream never ends
+    size_t length = framesPerBuffer;
+    if (!stream->IsLooping())
+    {
+      size_t numFrames = stream->GetNumFrames();
+      if (framePosition >= double(numFrames))
+      {
+        // no more audio data to write
+        stream->UnlockRead();
+        Finish();
+        return;
+      }
+
+      size_t framesLeft = size_t(std::ceil((double(numFrames) - framePosition) / step));
+      length = std::min(framesPerBuffer, framesLeft);
+    }
+
+    // frames that can be written with the blocks already decoded
+    uint64_t firstFrame = uint64_t(framePosition);
+    double decodedEnd = double(firstFrame + stream->GetAvailableFrames(firstFrame));
+    size_t decodedLength = decodedEnd > framePosition ? size_t(std::ceil((decodedEnd - framePosition) / step)) : 0;
+    if (decodedLength < length)
+    {
+      // the I/O thread is late: play what is decoded and leave the rest silent
+      stream->underruns++;
+      length = decodedLength;
+    }
+
+    double position = framePosition;
+    for (size_t i = 0; i < length; i++)
+    {
+      MixFrame(&outBuffer[i * NUM_CHANNELS], stream->GetFrame(uint64_t(position)), gains);
+
+      position += step;
+    }
+
+    PostStreamEvents(framePosition, position);
+
+    framePosition = position;
+
+    stream->Consume(uint64_t(framePosition));
+    stream->UnlockRead();
+  }
+
+  // Audio thread: gains at the end of the last buffer mixed
+  float mixGains[NUM_CHANNELS]{ 1.0f, 1.0f };
+  bool mixedMono{ false };
+  float mixDoppler{ 1.0f };
+
+  // Audio thread: markers of the buffer being mixed
+  const std::vector<uint64_t>* mixMarkers{ nullptr };
+
+  // Audio thread: fade being ramped, and the request it comes from
+  uint32_t mixFadeRequest{ 0 };
+  float mixFadeGain{ 1.0f };
+  float mixFadeTarget{ 1.0f };
+  float mixFadeStep{ 0.0f };
+  State mixFadeEndState{ State::PLAYING };
 };
 
 #endif // !TXIKI_AUDIO_SOUND_H
-
@@ -0,0 +1,319 @@
+#ifndef TXIKI_AUDIO_SOUND_FILE_READER_H
+#define TXIKI_AUDIO_SOUND_FILE_READER_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+#include "TxikiAudioEnums.h"
+
+struct TxikiAudioSoundDesc
+{
+  // channels of the samples played (mono sounds are expanded to stereo)
+  static const size_t NUM_CHANNELS = 2;
+
+  TxikiAudioSoundFormat format; 
+
+  std::unique_ptr<short[] > samples;
+  size_t samplesBufferSize{ 0 };
+  size_t sampleRate{ 0 };
+  size_t numChannels{ 0 }; // interleaved channels in samples (mono sounds are expanded to stereo)
+
+  // sound file layout, set when reading the header
+  size_t fileNumChannels{ 0 };
+  size_t numFrames{ 0 };
+  std::streampos samplesStart{ 0 };
+
+  // loop points in frames, read from the file (end 0 = no loop points)
+  size_t loopStart{ 0 };
+  size_t loopEnd{ 0 };
+};
+
+class ISoundFileReader
+{
+public:
+  // read the whole sound
+  virtual bool Read(std::ifstream& soundFile, TxikiAudioSoundDesc& outTxikiAudioSoundDesc) = 0;
+
+  // read the sound format, leaving the file at the start of the samples
+  virtual bool ReadHeader(std::ifstream& soundFile, TxikiAudioSoundDesc& outTxikiAudioSoundDesc) = 0;
+
+  // read up to numFrames frames with the layout of TxikiAudioSoundDesc::numChannels. Returns the number of frames read.
+  virtual size_t ReadFrames(std::ifstream& soundFile, const TxikiAudioSoundDesc& soundDesc, short* outSamples, size_t numFrames) = 0;
+};
+
+class SoundFileReader_WAVE : public ISoundFileReader
+{
+  // Wave file format
+  struct WaveFileFormat_
+  {
+    // 1st chunk
+    // DESCRIPTOR: RIFF file type
+    struct DESCRIPTOR_
+    {
+      std::streamsize chunkID{ 4 }; // "FFIR" = 0x46464952 = 1179011410 ("RIFF" in Big Endian)
+      std::streamsize chunkSize{ 4 };
+      std::streamsize format{ 4 }; // "EVAW" = 0x45564157 = 1163280727 ("WAVE" in Big Endian)
+    }DESCRIPTOR;
+
+
+    // 2nd chunk
+    // FORMAT: data format
+    struct FORMAT_
+    {
+      std::streamsize subchunk1ID{ 4 }; // "tmf" = 0x20746D66 = 544501094 ("fmt" in Big Endian)
+      std::streamsize subchunk1Size{ 4 }; // 16 = audioFormat(2) + numChannels(2) + sampleRate(4) + byteRate(4) + blockAlign(2) + bitsPerSample(2)
+      std::streamsize audioFormat{ 2 }; // PCM = 0x0001 = 1
+      std::streamsize numChannels{ 2 };
+      std::streamsize sampleRate{ 4 };
+      std::streamsize byteRate{ 4 };
+      std::streamsize blockAlign{ 2 };
+      std::streamsize bitsPerSample{ 2 };
+    }FORMAT;
+
+
+    // 3rd chunk
+    // DATA: sound data
+    struct DATA_
+    {
+      std::streamsize subchunk2ID{ 4 }; //  "atad" = 0x61746164 = 1635017060 ("data in Big Endian")
+      std::streamsize subchunk2Size{ 4 };
+      // std::streamsize data { X }
+    }DATA;
+
+  } WavFileFormat;
+
+public:
+
+  bool Read(std::ifstream& soundFile, TxikiAudioSoundDesc& outTxikiAudioSoundDesc) final
+  {
+    if (!ReadHeader(soundFile, outTxikiAudioSoundDesc))
+    {
+      return false;
+    }
+
+    // start reading all the samples
+    std::unique_ptr<short[] > samples(new short[outTxikiAudioSoundDesc.samplesBufferSize]);
+    size_t framesRead = ReadFrames(soundFile, outTxikiAudioSoundDesc, samples.get(), outTxikiAudioSoundDesc.numFrames);
+    outTxikiAudioSoundDesc.samples = std::move(samples);
+
+    if (framesRead != outTxikiAudioSoundDesc.numFrames)
+    {
+      soundFile.close();
+      printf("Error: Samples in chunk WavFileFormat.DATA not read properly.\n");
+      return false;
+    }
+
+    ReadTrailingChunks(soundFile, outTxikiAudioSoundDesc);
+
+    return true;
+  }
+
+  bool ReadHeader(std::ifstream& soundFile, TxikiAudioSoundDesc& outTxikiAudioSoundDesc) final
+  {
+    size_t value = 0;
+
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.DESCRIPTOR.chunkID);
+    //printf("WavFileFormat.DESCRIPTOR.chunkID: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.DESCRIPTOR.chunkSize);
+    //printf("WavFileFormat.DESCRIPTOR.chunkSize: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.DESCRIPTOR.format);
+    //printf("WavFileFormat.DESCRIPTOR.format: %d\n", value);
+
+    if (!soundFile.good())
+    {
+      printf("Error: Chunk WavFileFormat.DESCRIPTOR not read properly.\n");
+      return false;
+    }
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.subchunk1ID);
+    //printf("WavFileFormat.FORMAT.subchunk1ID: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.subchunk1Size);
+    //printf("WavFileFormat.FORMAT.subchunk1Size: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.audioFormat);
+    //printf("WavFileFormat.FORMAT.audioFormat: %d\n", value);
+
+    switch (value)
+    {
+    case 1:
+      outTxikiAudioSoundDesc.format = TxikiAudioSoundFormat::PCM16;
+      break;
+    default:
+      outTxikiAudioSoundDesc.format = TxikiAudioSoundFormat::NONE;
+      printf("Error: WavFileFormat.FORMAT.audioFormat: %d not supported. Only PCM16 is supported.\n", value);
+      return false;
+    }
+
+    size_t numChannels = 0;
+    soundFile.read(reinterpret_cast<char*>(&numChannels), WavFileFormat.FORMAT.numChannels);
+    //printf("WavFileFormat.FORMAT.numChannels: %d\n", numChannels);
+
+    size_t sampleRate = 0;
+    soundFile.read(reinterpret_cast<char*>(&sampleRate), WavFileFormat.FORMAT.sampleRate);
+    outTxikiAudioSoundDesc.sampleRate = sampleRate;
+    //printf("WavFileFormat.FORMAT.sampleRate: %d\n", sampleRate);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.byteRate);
+    //printf("WavFileFormat.FORMAT.byteRate: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.blockAlign);
+    // printf("WavFileFormat.FORMAT.blockAlign: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.FORMAT.bitsPerSample);
+    //printf("WavFileFormat.FORMAT.bitsPerSample: %d\n", value);
+    size_t bitsPerSample = value;
+
+    switch (outTxikiAudioSoundDesc.format)
+    {
+    case TxikiAudioSoundFormat::PCM16:
+      if (bitsPerSample != 16)
+      {
+        printf("Error: WavFileFormat.FORMAT.bitsPerSample is %d with format PCM16\n", bitsPerSample);
+        return false;
+      }
+      break;
+    default:
+      printf("Error: audioFormat not handled when reading WavFileFormat.FORMAT.bitsPerSample %d\n", bitsPerSample);
+      return false;
+    }
+
+    if (!soundFile.good())
+    {
+      printf("Error: Chunk WavFileFormat.FORMAT not read properly.\n");
+      return false;
+    }
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.DATA.subchunk2ID);
+    //printf("WavFileFormat.DATA.subchunk2ID: %d\n", value);
+
+    value = 0;
+    soundFile.read(reinterpret_cast<char*>(&value), WavFileFormat.DATA.subchunk2Size);
+    //printf("WavFileFormat.DATA.subchunk2Size: %d\n", value);
+
+    if (!soundFile.good())
+    {
+      printf("Error: Chunk WavFileFormat.DATA not read properly.\n");
+      return false;
+    }
+
+    size_t soundDataSize = value;
+    size_t bitsPerByte = 8;
+
+    size_t numSamples = (soundDataSize * bitsPerByte) / bitsPerSample;
+    //printf("numSamples : %d\n", numSamples);
+
+    size_t samplesBufferSize = numChannels == 1 ? numSamples * TxikiAudioSoundDesc::NUM_CHANNELS : numSamples;
+    outTxikiAudioSoundDesc.samplesBufferSize = samplesBufferSize;
+    outTxikiAudioSoundDesc.numChannels = numChannels == 1 ? TxikiAudioSoundDesc::NUM_CHANNELS : numChannels;
+
+    outTxikiAudioSoundDesc.fileNumChannels = numChannels;
+    outTxikiAudioSoundDesc.numFrames = numChannels ? numSamples / numChannels : 0;
+    outTxikiAudioSoundDesc.samplesStart = soundFile.tellg();
+
+    return true;
+  }
+
+  size_t ReadFrames(std::ifstream& soundFile, const TxikiAudioSoundDesc& soundDesc, short* outSamples, size_t numFrames) final
+  {
+    // read the samples in bulk (Note: We are using PCM16 format!)
+    size_t fileNumChannels = soundDesc.fileNumChannels;
+    soundFile.read(reinterpret_cast<char*>(outSamples), numFrames * fileNumChannels * sizeof(short));
+    size_t framesRead = size_t(soundFile.gcount()) / (fileNumChannels * sizeof(short));
+
+    if (fileNumChannels == 1)
+    {
+      // expand mono to stereo in place, from the end so samples are not overwritten before being moved
+      for (size_t i = framesRead; i-- > 0; )
+      {
+        outSamples[i * 2] = outSamples[i];
+        outSamples[i * 2 + 1] = outSamples[i];
+      }
+    }
+
+    return framesRead;
+  }
+
+private:
+
+  // Chunks after the samples: the loop points are read from "smpl", the rest are skipped. They are optional, so a broken tail only ends the scan.
+  void ReadTrailingChunks(std::ifstream& soundFile, TxikiAudioSoundDesc& outTxikiAudioSoundDesc)
+  {
+    static const uint32_t SMPL_ID = 0x6C706D73; // "lpms" ("smpl" in Big Endian)
+    static const uint32_t SMPL_HEADER_SIZE = 36;
+    static const uint32_t SMPL_LOOP_SIZE = 24;
+
+    while (soundFile.peek() != std::ifstream::traits_type::eof())
+    {
+      uint32_t chunkID = 0;
+      uint32_t chunkSize = 0;
+      soundFile.read(reinterpret_cast<char*>(&chunkID), sizeof(chunkID));
+      soundFile.read(reinterpret_cast<char*>(&chunkSize), sizeof(chunkSize));
+      if (!soundFile.good())
+      {
+        // a short or padded tail is not a chunk
+        return;
+      }
+
+      // chunks are padded to an even size
+      std::streampos chunkEnd = soundFile.tellg() + std::streamoff(chunkSize + (chunkSize & 1));
+
+      if (chunkID == SMPL_ID && chunkSize >= SMPL_HEADER_SIZE + SMPL_LOOP_SIZE)
+      {
+        // manufacturer, product, sample period, MIDI unity note and pitch fraction, SMPTE format and offset, number of loops, sampler data
+        uint32_t header[SMPL_HEADER_SIZE / 4];
+        soundFile.read(reinterpret_cast<char*>(header), SMPL_HEADER_SIZE);
+
+        // first loop: cue point ID, type, start, end (inclusive), fraction, play count
+        uint32_t loop[SMPL_LOOP_SIZE / 4];
+        soundFile.read(reinterpret_cast<char*>(loop), SMPL_LOOP_SIZE);
+
+        if (soundFile.good() && header[7] > 0 && loop[2] <= loop[3] && loop[3] < outTxikiAudioSoundDesc.numFrames)
+        {
+          outTxikiAudioSoundDesc.loopStart = loop[2];
+          outTxikiAudioSoundDesc.loopEnd = size_t(loop[3]) + 1;
+        }
+      }
+
+      soundFile.seekg(chunkEnd);
+      if (!soundFile.good())
+      {
+        return;
+      }
+    }
+  }
+};
+
+class SoundFileReaderFactory
+{
+  public:
+    static std::unique_ptr<ISoundFileReader> NewSoundFileReader(TxikiAudioFileFormat format)
+    {
+      switch (format)
+      {
+      case TxikiAudioFileFormat::WAVE:
+        return std::make_unique<SoundFileReader_WAVE>();
+
+      case TxikiAudioFileFormat::NONE:
+      case TxikiAudioFileFormat::NUM_FILE_FORMATS:
+      default:
+        return nullptr;
+      }
+
+      return nullptr;
+    }
+};
+
+#endif // !TXIKI_AUDIO_SOUND_FILE_READER_H
@@ -0,0 +1,228 @@
+#ifndef TXIKI_AUDIO_SPATIALIZER_H
+#define TXIKI_AUDIO_SPATIALIZER_H
+
+#include <algorithm>
+
+#include "..\..\System_Common\AudioSystemDefines.h"
+#include "TxikiAudioAmbisonics.h"
+#include "TxikiAudioSIMD.h"
+#include "TxikiAudioVoices3D.h"
+
+// Listener the 3D voices are heard from
+struct TxikiAudioListener
+{
+  AudioSystemVector position{ 0.0f, 0.0f, 0.0f };
+  AudioSystemVector velocity{ 0.0f, 0.0f, 0.0f };
+  AudioSystemVector forward{ 0.0f, 0.0f, 1.0f };
+  AudioSystemVector up{ 0.0f, 1.0f, 0.0f };
+
+  bool rightHanded{ false };
+
+  // set by TxikiAudio from its config
+  float dopplerScale{ 1.0f };
+  float speedOfSound{ 343.0f };
+  float airAbsorption{ 0.0f };
+};
+
+// TxikiAudioSpatializer
+//
+// Distance attenuation, occlusion, air absorption, equal-power stereo panning and Doppler shift of the 3D voices.
+// The voices are processed 4 at a time, except for the custom rolloff curves.
+class TxikiAudioSpatializer
+{
+public:
+
+  static void Process(const TxikiAudioListener& listener, TxikiAudioVoices3D& voices)
+  {
+    size_t numVoices = voices.Size();
+    if (numVoices == 0)
+    {
+      return;
+    }
+
+    voices.Pad();
+    size_t paddedSize = TxikiAudioSIMD::PaddedSize(numVoices);
+
+    glm::vec3 position(listener.position.x, listener.position.y, listener.position.z);
+    glm::vec3 right, up, forward;
+    GetListenerAxes(listener, right, up, forward);
+
+    using namespace TxikiAudioSIMD;
+
+    const TxikiAudioFloat4 zero = Splat(0.0f);
+    const TxikiAudioFloat4 epsilon = Splat(1e-4f);
+
+    // Doppler: velocities are limited below the speed of sound, so the pitch factor stays finite
+    float speedOfSound = std::max(listener.speedOfSound, 1.0f);
+    const TxikiAudioFloat4 speedOfSoundLanes = Splat(speedOfSound);
+    const TxikiAudioFloat4 maxSpeed = Splat(speedOfSound * 0.9f);
+    const TxikiAudioFloat4 dopplerScale = Splat(listener.dopplerScale);
+    const TxikiAudioFloat4 listenerVelocityX = Splat(listener.velocity.x);
+    const TxikiAudioFloat4 listenerVelocityY = Splat(listener.velocity.y);
+    const TxikiAudioFloat4 listenerVelocityZ = Splat(listener.velocity.z);
+
+    for (size_t i = 0; i < paddedSize; i += WIDTH)
+    {
+      // position relative to the listener
+      TxikiAudioFloat4 x = Load(&voices.positionX[i]) - Splat(position.x);
+      TxikiAudioFloat4 y = Load(&voices.positionY[i]) - Splat(position.y);
+      TxikiAudioFloat4 z = Load(&voices.positionZ[i]) - Splat(position.z);
+
+      // in listener space
+      TxikiAudioFloat4 localX = x * Splat(right.x) + y * Splat(right.y) + z * Splat(right.z);
+      TxikiAudioFloat4 localY = x * Splat(up.x) + y * Splat(up.y) + z * Splat(up.z);
+      TxikiAudioFloat4 localZ = x * Splat(forward.x) + y * Splat(forward.y) + z * Splat(forward.z);
+
+      TxikiAudioFloat4 distance = glm::sqrt(localX * localX + localY * localY + localZ * localZ);
+
+      // voices on the listener have no direction
+      TxikiAudioFloat4 inverseDistance = glm::mix(zero, Splat(1.0f) / glm::max(distance, epsilon), glm::greaterThan(distance, epsilon));
+
+      Store(&voices.distance[i], distance);
+      Store(&voices.directionX[i], localX * inverseDistance);
+      Store(&voices.directionY[i], localY * inverseDistance);
+      Store(&voices.directionZ[i], localZ * inverseDistance);
+
+      // rolloff between min and max distance
+      TxikiAudioFloat4 minDistance = glm::max(Load(&voices.minDistance[i]), epsilon);
+      TxikiAudioFloat4 maxDistance = glm::max(Load(&voices.maxDistance[i]), minDistance);
+      TxikiAudioFloat4 clampedDistance = glm::clamp(distance, minDistance, maxDistance);
+
+      TxikiAudioFloat4 inverseGain = minDistance / clampedDistance;
+      TxikiAudioFloat4 linearGain = (maxDistance - clampedDistance) / glm::max(maxDistance - minDistance, epsilon);
+
+      Store(&voices.attenuation[i], glm::mix(inverseGain, linearGain, Load(&voices.linearRolloff[i])));
+
+      // speeds along the line from the sound to the listener (positive = towards the listener)
+      TxikiAudioFloat4 toListenerX = -x * inverseDistance;
+      TxikiAudioFloat4 toListenerY = -y * inverseDistance;
+      TxikiAudioFloat4 toListenerZ = -z * inverseDistance;
+
+      TxikiAudioFloat4 soundSpeed = Load(&voices.velocityX[i]) * toListenerX + Load(&voices.velocityY[i]) * toListenerY + Load(&voices.velocityZ[i]) * toListenerZ;
+      TxikiAudioFloat4 listenerSpeed = -(listenerVelocityX * toListenerX + listenerVelocityY * toListenerY + listenerVelocityZ * toListenerZ);
+      soundSpeed = glm::clamp(soundSpeed * dopplerScale, -maxSpeed, maxSpeed);
+      listenerSpeed = glm::clamp(listenerSpeed * dopplerScale, -maxSpeed, maxSpeed);
+
+      Store(&voices.doppler[i], (speedOfSoundLanes + listenerSpeed) / (speedOfSoundLanes - soundSpeed));
+    }
+
+    // custom curves
+    for (size_t i = 0; i < numVoices; i++)
+    {
+      const AudioSystemRolloff& rolloff = voices.sounds[i]->rolloff;
+      if (rolloff.type == AudioSystemRolloffType::CUSTOM)
+      {
+        voices.attenuation[i] = EvaluateCurve(rolloff, voices.distance[i]);
+      }
+    }
+
+    // occlusion, then equal-power panning from the left/right direction
+    const TxikiAudioFloat4 quarterPi = Splat(0.785398163f);
+    const TxikiAudioFloat4 maxCutoff = Splat(22000.0f);
+    const TxikiAudioFloat4 airAbsorption = Splat(std::max(listener.airAbsorption, 0.0f));
+    for (size_t i = 0; i < paddedSize; i += WIDTH)
+    {
+      TxikiAudioFloat4 attenuation = Load(&voices.attenuation[i]) * Load(&voices.occlusionGain[i]);
+      Store(&voices.attenuation[i], attenuation);
+      TxikiAudioFloat4 airCutoff = maxCutoff / (Splat(1.0f) + Load(&voices.distance[i]) * airAbsorption);
+      Store(&voices.lowPassCutoff[i], glm::min(Load(&voices.occlusionLowPassCutoff[i]), airCutoff));
+      TxikiAudioFloat4 angle = (Load(&voices.directionX[i]) + Splat(1.0f)) * quarterPi;
+
+      Store(&voices.gainLeft[i], attenuation * glm::max(glm::cos(angle), zero));
+      Store(&voices.gainRight[i], attenuation * glm::max(glm::sin(angle), zero));
+    }
+  }
+
+  // Ambisonic encoding gains of the voices in world space, and the rotation of the sound field to the listener orientation.
+  // Note: call it after Process.
+  static void EncodeAmbisonics(const TxikiAudioListener& listener, size_t order, TxikiAudioVoices3D& voices)
+  {
+    glm::vec3 right, up, forward;
+    GetListenerAxes(listener, right, up, forward);
+
+    // ambisonic coordinates (+X front, +Y left, +Z up) of a left-handed vector (+X right, +Y up, +Z forward) are (z, -x, y).
+    // Right-handed world vectors have their z flipped first.
+    float flip = listener.rightHanded ? -1.0f : 1.0f;
+    const glm::vec3 axes[3] = { forward, -right, up };
+    for (size_t row = 0; row < 3; row++)
+    {
+      voices.listenerRotation[row][0] = axes[row].z * flip;
+      voices.listenerRotation[row][1] = -axes[row].x;
+      voices.listenerRotation[row][2] = axes[row].y;
+    }
+
+    size_t numVoices = voices.Size();
+    size_t paddedSize = TxikiAudioSIMD::PaddedSize(numVoices);
+    size_t numChannels = TxikiAudioAmbisonics::GetNumChannels(order);
+    voices.ambisonicGains.resize(numChannels * paddedSize);
+
+    using namespace TxikiAudioSIMD;
+
+    const TxikiAudioFloat4 epsilon = Splat(1e-4f);
+    for (size_t i = 0; i < paddedSize; i += WIDTH)
+    {
+      TxikiAudioFloat4 x = Load(&voices.positionX[i]) - Splat(listener.position.x);
+      TxikiAudioFloat4 y = Load(&voices.positionY[i]) - Splat(listener.position.y);
+      TxikiAudioFloat4 z = Load(&voices.positionZ[i]) - Splat(listener.position.z);
+
+      // voices on the listener have no direction: omnidirectional
+      TxikiAudioFloat4 distance = glm::sqrt(x * x + y * y + z * z);
+      TxikiAudioFloat4 inverseDistance = glm::mix(Splat(0.0f), Splat(1.0f) / glm::max(distance, epsilon), glm::greaterThan(distance, epsilon));
+
+      TxikiAudioFloat4 gains[TxikiAudioAmbisonics::MAX_CHANNELS];
+      TxikiAudioAmbisonics::Encode<TxikiAudioFloat4>(z * inverseDistance * flip, -x * inverseDistance, y * inverseDistance, order, gains);
+
+      for (size_t channel = 0; channel < numChannels; channel++)
+      {
+        Store(&voices.ambisonicGains[channel * paddedSize + i], gains[channel]);
+      }
+    }
+  }
+
+  // Listener axes in world space, orthonormal
+  static void GetListenerAxes(const TxikiAudioListener& listener, glm::vec3& right, glm::vec3& up, glm::vec3& forward)
+  {
+    forward = Normalize(glm::vec3(listener.forward.x, listener.forward.y, listener.forward.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    up = glm::vec3(listener.up.x, listener.up.y, listener.up.z);
+    right = Normalize(listener.rightHanded ? glm::cross(forward, up) : glm::cross(up, forward), glm::vec3(1.0f, 0.0f, 0.0f));
+    up = listener.rightHanded ? glm::cross(right, forward) : glm::cross(forward, right);
+  }
+
+private:
+
+  static glm::vec3 Normalize(const glm::vec3& v, const glm::vec3& fallback)
+  {
+    float length = glm::length(v);
+    return length > 1e-6f ? v / length : fallback;
+  }
+
+  // Piecewise linear curve, held flat before the first point and after the last one
+  static float EvaluateCurve(const AudioSystemRolloff& rolloff, float distance)
+  {
+    const auto& curve = rolloff.curve;
+    if (curve.empty())
+    {
+      return 1.0f;
+    }
+
+    if (distance <= curve.front().distance)
+    {
+      return curve.front().gain;
+    }
+
+    for (size_t i = 1; i < curve.size(); i++)
+    {
+      if (distance < curve[i].distance)
+      {
+        const AudioSystemRolloffPoint& a = curve[i - 1];
+        const AudioSystemRolloffPoint& b = curve[i];
+        float t = (distance - a.distance) / (b.distance - a.distance);
+        return a.gain + (b.gain - a.gain) * t;
+      }
+    }
+
+    return curve.back().gain;
+  }
+};
+
+#endif // !TXIKI_AUDIO_SPATIALIZER_H
@@ -0,0 +1,272 @@
+#ifndef TXIKI_AUDIO_SPEAKERS_H
+#define TXIKI_AUDIO_SPEAKERS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "TxikiAudioEnums.h"
+#include "TxikiAudioSIMD.h"
+#include "TxikiAudioVoices3D.h"
+
+// TxikiAudioSpeakers
+//
+// Speakers of the output layout and the kernels mixing the voices into them.
+// The speaker mix is interleaved with a stride padded to 4 channels, so every frame is mixed 4 channels at a time.
+// 3D voices are panned with VBAP between the pair of speakers around them; stereo voices play on the front pair.
+class TxikiAudioSpeakers
+{
+public:
+
+  static const size_t MAX_CHANNELS = 8;
+  static_assert(MAX_CHANNELS == TxikiAudioSound::MAX_OUTPUT_CHANNELS, "output channels mismatch");
+
+  struct Speaker
+  {
+    float azimuth; // degrees, 0 = front, 90 = left
+    bool lfe;
+  };
+
+  void Init(TxikiAudioOutputLayout layout_)
+  {
+    layout = layout_;
+
+    // channel order of WAVE files: FL FR FC LFE BL BR SL SR
+    switch (layout)
+    {
+    case TxikiAudioOutputLayout::MONO:
+      speakers = { { 0.0f, false } };
+      break;
+    case TxikiAudioOutputLayout::STEREO:
+      speakers = { { 30.0f, false }, { -30.0f, false } };
+      break;
+    case TxikiAudioOutputLayout::QUAD:
+      speakers = { { 45.0f, false }, { -45.0f, false }, { 135.0f, false }, { -135.0f, false } };
+      break;
+    case TxikiAudioOutputLayout::SURROUND_5_1:
+      speakers = { { 30.0f, false }, { -30.0f, false }, { 0.0f, false }, { 0.0f, true }, { 110.0f, false }, { -110.0f, false } };
+      break;
+    case TxikiAudioOutputLayout::SURROUND_7_1:
+      speakers = { { 30.0f, false }, { -30.0f, false }, { 0.0f, false }, { 0.0f, true }, { 150.0f, false }, { -150.0f, false }, { 90.0f, false }, { -90.0f, false } };
+      break;
+    }
+
+    mixStride = TxikiAudioSIMD::PaddedSize(speakers.size());
+
+    // stereo voices: front pair, or both channels on a single speaker
+    std::fill(std::begin(stereoLeft), std::end(stereoLeft), 0.0f);
+    std::fill(std::begin(stereoRight), std::end(stereoRight), 0.0f);
+    if (speakers.size() == 1)
+    {
+      stereoLeft[0] = 0.5f;
+      stereoRight[0] = 0.5f;
+    }
+    else
+    {
+      stereoLeft[0] = 1.0f;
+      stereoRight[1] = 1.0f;
+    }
+
+    InitPairs();
+  }
+
+  TxikiAudioOutputLayout GetLayout() const { return layout; }
+  size_t GetNumChannels() const { return speakers.size(); }
+  size_t GetMixStride() const { return mixStride; }
+  const Speaker& GetSpeaker(size_t channel) const { return speakers[channel]; }
+
+  // Game thread: VBAP gains of the 3D voices, from their direction in listener space
+  void Pan(TxikiAudioVoices3D& voices) const
+  {
+    size_t paddedSize = TxikiAudioSIMD::PaddedSize(voices.Size());
+    voices.speakerGains.assign(mixStride * paddedSize, 0.0f);
+
+    Pan(voices.directionX.data(), voices.directionZ.data(), paddedSize, voices.speakerGains.data());
+  }
+
+  // VBAP gains of directions in listener space (count is a multiple of 4), one speaker after another (count each)
+  void Pan(const float* directionX, const float* directionZ, size_t count, float* outGains) const
+  {
+    using namespace TxikiAudioSIMD;
+
+    const TxikiAudioFloat4 zero = Splat(0.0f);
+    const TxikiAudioFloat4 tolerance = Splat(-1e-4f);
+    size_t numSpeakers = speakers.size() - (HasLFE() ? 1 : 0);
+    const TxikiAudioFloat4 spread = Splat(1.0f / std::sqrt(float(numSpeakers)));
+
+    for (size_t i = 0; i < count; i += WIDTH)
+    {
+      // horizontal direction: x forward, y left
+      TxikiAudioFloat4 x = Load(&directionZ[i]);
+      TxikiAudioFloat4 y = -Load(&directionX[i]);
+      TxikiAudioFloat4 length = glm::sqrt(x * x + y * y);
+      auto hasDirection = glm::greaterThan(length, Splat(1e-4f));
+      TxikiAudioFloat4 inverseLength = Splat(1.0f) / glm::max(length, Splat(1e-4f));
+      x *= inverseLength;
+      y *= inverseLength;
+
+      TxikiAudioFloat4 gains[MAX_CHANNELS];
+      std::fill(std::begin(gains), std::end(gains), zero);
+
+      // gains of the pairs the direction is between
+      for (auto& pair : pairs)
+      {
+        TxikiAudioFloat4 gain1 = x * pair.inverse[0][0] + y * pair.inverse[0][1];
+        TxikiAudioFloat4 gain2 = x * pair.inverse[1][0] + y * pair.inverse[1][1];
+        auto inside = glm::greaterThanEqual(glm::min(gain1, gain2), tolerance);
+        gains[pair.channel1] += glm::mix(zero, glm::max(gain1, zero), inside);
+        gains[pair.channel2] += glm::mix(zero, glm::max(gain2, zero), inside);
+      }
+
+      // constant power. Voices without a direction (above, below or on the listener) play on every speaker.
+      TxikiAudioFloat4 power = zero;
+      for (size_t channel = 0; channel < speakers.size(); channel++)
+      {
+        power += gains[channel] * gains[channel];
+      }
+      TxikiAudioFloat4 normalise = Splat(1.0f) / glm::sqrt(glm::max(power, Splat(1e-12f)));
+
+      for (size_t channel = 0; channel < speakers.size(); channel++)
+      {
+        TxikiAudioFloat4 gain = spread;
+        if (speakers[channel].lfe)
+        {
+          gain = zero;
+        }
+        else if (!pairs.empty())
+        {
+          gain = glm::mix(spread, gains[channel] * normalise, hasDirection);
+        }
+        Store(&outGains[channel * count + i], gain);
+      }
+    }
+  }
+
+  // Audio thread: add a mono voice (one sample every inStride floats) to the speaker mix, ramping its gains to the target ones
+  void MixMono(const float* in, size_t inStride, size_t frames, const float* targetGains, float* gains, float* out) const
+  {
+    using namespace TxikiAudioSIMD;
+
+    TxikiAudioFloat4 framesInverse = Splat(1.0f / float(std::max(frames, size_t(1))));
+    for (size_t group = 0; group < mixStride; group += WIDTH)
+    {
+      TxikiAudioFloat4 gain = Load(&gains[group]);
+      TxikiAudioFloat4 target = Load(&targetGains[group]);
+      TxikiAudioFloat4 step = (target - gain) * framesInverse;
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        float* mix = &out[frame * mixStride + group];
+        Store(mix, Load(mix) + gain * in[frame * inStride]);
+        gain += step;
+      }
+
+      Store(&gains[group], target);
+    }
+  }
+
+  // Audio thread: add a mono voice (one sample every inStride floats) to an interleaved stereo mix, ramping its gains to the target ones
+  static void PanStereo(const float* in, size_t inStride, size_t frames, const float* targetGains, float* gains, float* out)
+  {
+    float framesInverse = 1.0f / float(std::max(frames, size_t(1)));
+    float stepLeft = (targetGains[0] - gains[0]) * framesInverse;
+    float stepRight = (targetGains[1] - gains[1]) * framesInverse;
+    float left = gains[0];
+    float right = gains[1];
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+      out[frame * 2] += in[frame * inStride] * left;
+      out[frame * 2 + 1] += in[frame * inStride] * right;
+      left += stepLeft;
+      right += stepRight;
+    }
+
+    gains[0] = targetGains[0];
+    gains[1] = targetGains[1];
+  }
+
+  // Audio thread: add an interleaved stereo voice to the speaker mix through the stereo matrix
+  void MixStereo(const float* in, size_t frames, float* out) const
+  {
+    using namespace TxikiAudioSIMD;
+
+    for (size_t group = 0; group < mixStride; group += WIDTH)
+    {
+      TxikiAudioFloat4 left = Load(&stereoLeft[group]);
+      TxikiAudioFloat4 right = Load(&stereoRight[group]);
+      for (size_t frame = 0; frame < frames; frame++)
+      {
+        float* mix = &out[frame * mixStride + group];
+        Store(mix, Load(mix) + left * in[frame * 2] + right * in[frame * 2 + 1]);
+      }
+    }
+  }
+
+private:
+
+  bool HasLFE() const
+  {
+    return std::any_of(speakers.begin(), speakers.end(), [](const Speaker& speaker) { return speaker.lfe; });
+  }
+
+  // Adjacent speakers around the listener, with the inverse of their direction matrix
+  void InitPairs()
+  {
+    pairs.clear();
+
+    std::vector<size_t> ring;
+    for (size_t channel = 0; channel < speakers.size(); channel++)
+    {
+      if (!speakers[channel].lfe)
+      {
+        ring.push_back(channel);
+      }
+    }
+
+    std::sort(ring.begin(), ring.end(), [this](size_t a, size_t b) { return speakers[a].azimuth < speakers[b].azimuth; });
+
+    // the last pair closes the ring behind the listener (Note: not for stereo, a pair more than 180 degrees wide has no inside)
+    size_t numPairs = ring.size() > 2 ? ring.size() : (ring.empty() ? 0 : ring.size() - 1);
+    for (size_t i = 0; i < numPairs; i++)
+    {
+      Pair pair;
+      pair.channel1 = ring[i];
+      pair.channel2 = ring[(i + 1) % ring.size()];
+
+      float azimuth1 = speakers[pair.channel1].azimuth * 3.14159265f / 180.0f;
+      float azimuth2 = speakers[pair.channel2].azimuth * 3.14159265f / 180.0f;
+      float x1 = std::cos(azimuth1);
+      float y1 = std::sin(azimuth1);
+      float x2 = std::cos(azimuth2);
+      float y2 = std::sin(azimuth2);
+      float determinant = x1 * y2 - x2 * y1;
+      if (std::abs(determinant) < 1e-6f)
+      {
+        continue;
+      }
+
+      pair.inverse[0][0] = y2 / determinant;
+      pair.inverse[0][1] = -x2 / determinant;
+      pair.inverse[1][0] = -y1 / determinant;
+      pair.inverse[1][1] = x1 / determinant;
+      pairs.push_back(pair);
+    }
+  }
+
+  TxikiAudioOutputLayout layout{ TxikiAudioOutputLayout::STEREO };
+  std::vector<Speaker> speakers;
+  size_t mixStride{ 4 };
+
+  float stereoLeft[MAX_CHANNELS];
+  float stereoRight[MAX_CHANNELS];
+
+  struct Pair
+  {
+    size_t channel1;
+    size_t channel2;
+    float inverse[2][2];
+  };
+
+  std::vector<Pair> pairs;
+};
+
+#endif // !TXIKI_AUDIO_SPEAKERS_H
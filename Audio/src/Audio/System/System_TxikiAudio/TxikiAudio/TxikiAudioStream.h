@@ -0,0 +1,360 @@
+#ifndef TXIKI_AUDIO_STREAM_H
+#define TXIKI_AUDIO_STREAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TxikiAudioSoundFileReader.h"
+
+// Stream settings
+struct TxikiAudioStreamConfig
+{
+  size_t blockFrames{ 4096 };   // frames decoded at once by the I/O thread
+  size_t numBlocks{ 8 };        // ring size in blocks, rounded up to a power of two
+  size_t prebufferBlocks{ 2 };  // blocks decoded before the stream can play
+};
+
+// TxikiAudioStream
+//
+// Sound decoded from disk on the fly into a ring of blocks.
+// The I/O thread writes the ring ahead of the mixer, the audio thread reads it.
+class TxikiAudioStream
+{
+public:
+
+  bool Open(const std::string& soundName, ISoundFileReader* soundFileReader, const TxikiAudioStreamConfig& config, bool loop_)
+  {
+    reader = soundFileReader;
+    loop = loop_;
+
+    file.open(soundName.c_str(), std::ios_base::binary);
+    if (!file.is_open())
+    {
+      printf("Error: Unable to open stream %s\n", soundName.c_str());
+      return false;
+    }
+
+    if (!reader->ReadHeader(file, soundDesc))
+    {
+      printf("Error: Unable to read stream header %s\n", soundName.c_str());
+      return false;
+    }
+
+    if (soundDesc.numChannels != NUM_CHANNELS)
+    {
+      printf("Error: Unable to stream %s with %d channels. Only %d channels are supported.\n", soundName.c_str(), (int)soundDesc.numChannels, (int)NUM_CHANNELS);
+      return false;
+    }
+
+    blockFrames = config.blockFrames;
+
+    size_t ringFrames = 1;
+    while (ringFrames < config.numBlocks * blockFrames)
+    {
+      ringFrames <<= 1;
+    }
+    ringMask = ringFrames - 1;
+    ring.reset(new short[ringFrames * NUM_CHANNELS]);
+
+    // prebuffer, so the stream starts playing on the next callback
+    size_t prebufferFrames = std::min(config.prebufferBlocks * blockFrames, ringFrames);
+    while (writeFrame < prebufferFrames && Refill())
+    {
+    }
+
+    return true;
+  }
+
+  // I/O thread: decode the next block if there is room for it. Returns false when there was nothing to do.
+  bool Refill()
+  {
+    size_t capacity = ringMask + 1;
+    uint64_t write = writeFrame.load(std::memory_order_relaxed);
+    uint64_t read = readFrame.load(std::memory_order_acquire);
+
+    if (write - read + blockFrames > capacity)
+    {
+      return false;
+    }
+
+    if (fileFrame >= soundDesc.numFrames)
+    {
+      if (!loop || soundDesc.numFrames == 0)
+      {
+        return false;
+      }
+
+      // looping: keep decoding from the start of the sound
+      file.clear();
+      file.seekg(soundDesc.samplesStart);
+      fileFrame = 0;
+    }
+
+    size_t numFrames = std::min(blockFrames, soundDesc.numFrames - fileFrame);
+
+    // decode into the ring, in two parts when the block wraps around
+    size_t framesRead = 0;
+    while (framesRead < numFrames)
+    {
+      size_t ringIndex = size_t((write + framesRead) & ringMask);
+      size_t count = std::min(numFrames - framesRead, capacity - ringIndex);
+
+      size_t n = reader->ReadFrames(file, soundDesc, &ring[ringIndex * NUM_CHANNELS], count);
+      framesRead += n;
+      if (n < count)
+      {
+        // truncated file
+        soundDesc.numFrames = fileFrame + framesRead;
+        break;
+      }
+    }
+
+    fileFrame += framesRead;
+    writeFrame.store(write + framesRead, std::memory_order_release);
+
+    return framesRead > 0;
+  }
+
+  // I/O thread: go back to the start of the sound
+  void Rewind()
+  {
+    std::lock_guard<std::mutex> lock(readMutex);
+
+    file.clear();
+    file.seekg(soundDesc.samplesStart);
+    fileFrame = 0;
+
+    readFrame.store(0, std::memory_order_relaxed);
+    writeFrame.store(0, std::memory_order_release);
+
+    rewindRequested.store(false, std::memory_order_release);
+  }
+
+  // Game thread: the stream is rewound by the I/O thread
+  void RequestRewind()
+  {
+    rewindRequested.store(true, std::memory_order_release);
+  }
+
+  bool IsRewindRequested() const
+  {
+    return rewindRequested.load(std::memory_order_acquire);
+  }
+
+  // Audio thread: lock the stream for reading. Fails while the I/O thread rewinds it.
+  bool TryLockRead()
+  {
+    if (IsRewindRequested())
+    {
+      return false;
+    }
+
+    return readMutex.try_lock();
+  }
+
+  void UnlockRead()
+  {
+    readMutex.unlock();
+  }
+
+  // Audio thread: frames decoded and not consumed yet, from the given frame
+  size_t GetAvailableFrames(uint64_t frame) const
+  {
+    uint64_t write = writeFrame.load(std::memory_order_acquire);
+    return write > frame ? size_t(write - frame) : 0;
+  }
+
+  const short* GetFrame(uint64_t frame) const
+  {
+    return &ring[size_t(frame & ringMask) * NUM_CHANNELS];
+  }
+
+  // Audio thread: frames before the given one can be overwritten
+  void Consume(uint64_t frame)
+  {
+    // a high pitch can step past the frames decoded
+    uint64_t write = writeFrame.load(std::memory_order_acquire);
+    readFrame.store(std::min(frame, write), std::memory_order_release);
+  }
+
+  size_t GetNumFrames() const { return soundDesc.numFrames; }
+
+  size_t GetSampleRate() const { return soundDesc.sampleRate; }
+
+  // a looping stream has no end: its frames keep counting after the last frame of the sound
+  bool IsLooping() const { return loop; }
+
+  // times the mixer needed frames not decoded yet
+  std::atomic<size_t> underruns{ 0 };
+
+private:
+
+  static const size_t NUM_CHANNELS = TxikiAudioSoundDesc::NUM_CHANNELS;
+
+  ISoundFileReader* reader{ nullptr };
+  std::ifstream file;
+  TxikiAudioSoundDesc soundDesc;
+  size_t fileFrame{ 0 };
+  bool loop{ false };
+
+  // ring of decoded frames, indexed by stream frame
+  std::unique_ptr<short[]> ring;
+  size_t ringMask{ 0 };
+  size_t blockFrames{ 0 };
+
+  std::atomic<uint64_t> writeFrame{ 0 };
+  std::atomic<uint64_t> readFrame{ 0 };
+
+  std::atomic<bool> rewindRequested{ false };
+  std::mutex readMutex;
+};
+
+// TxikiAudioStreamer
+//
+// I/O thread keeping all the streams filled ahead of the mixer
+class TxikiAudioStreamer
+{
+public:
+
+  void Start()
+  {
+    running = true;
+    thread = std::thread(&TxikiAudioStreamer::Run, this);
+  }
+
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    wakeUp.notify_one();
+
+    if (thread.joinable())
+    {
+      thread.join();
+    }
+
+    // jobs not started are dropped
+    jobs.clear();
+    jobsDone.notify_all();
+  }
+
+  void AddStream(TxikiAudioStream* stream)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    streams.push_back(stream);
+  }
+
+  // Once it returns, the I/O thread no longer uses the stream
+  void RemoveStream(TxikiAudioStream* stream)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      streams.erase(std::remove(streams.begin(), streams.end(), stream), streams.end());
+    }
+
+    // wait for the refill in progress, it may be using the stream
+    std::lock_guard<std::mutex> refillLock(refillMutex);
+  }
+
+  // wake up the I/O thread (e.g. after a rewind request)
+  void Notify()
+  {
+    wakeUp.notify_one();
+  }
+
+  // Run a job in the I/O thread (e.g. a nonblocking load)
+  void AddJob(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back(std::move(job));
+    }
+    wakeUp.notify_one();
+  }
+
+  // Wait until all the jobs added are done
+  void WaitForJobs()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this] { return !running || (jobs.empty() && !runningJob); });
+  }
+
+private:
+
+  void Run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (running)
+    {
+      // run the next job out of the lock, so streams can be added meanwhile
+      if (!jobs.empty())
+      {
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+
+        runningJob = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        runningJob = false;
+
+        jobsDone.notify_all();
+      }
+
+      bool busy = !jobs.empty();
+
+      // refill a copy of the streams out of the lock, so the game thread does not wait for the I/O
+      refillStreams = streams;
+      {
+        std::lock_guard<std::mutex> refillLock(refillMutex);
+        lock.unlock();
+
+        for (auto stream : refillStreams)
+        {
+          if (stream->IsRewindRequested())
+          {
+            stream->Rewind();
+          }
+
+          busy |= stream->Refill();
+        }
+      }
+      lock.lock();
+
+      if (!busy)
+      {
+        // nothing to decode: sleep until the mixer has consumed some frames
+        wakeUp.wait_for(lock, std::chrono::milliseconds(5));
+      }
+    }
+  }
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  bool running{ false };
+
+  std::vector<TxikiAudioStream*> streams;
+
+  // held while refilling, so a removed stream can be freed once it is released
+  std::mutex refillMutex;
+  std::vector<TxikiAudioStream*> refillStreams;
+
+  std::deque<std::function<void()>> jobs;
+  std::condition_variable jobsDone;
+  bool runningJob{ false };
+};
+
+#endif // !TXIKI_AUDIO_STREAM_H
@@ -0,0 +1,50 @@
+#ifndef TXIKI_AUDIO_TRIPLE_BUFFER_H
+#define TXIKI_AUDIO_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// TxikiAudioTripleBuffer
+//
+// Lock-free handoff of a value from one writer thread to one reader thread.
+// The writer fills its buffer and publishes it; the reader always gets the last published buffer.
+// Neither of them waits for the other.
+template <typename T>
+class TxikiAudioTripleBuffer
+{
+public:
+
+  // Writer: buffer to fill before publishing it
+  T& GetWriteBuffer() { return buffers[writeIndex]; }
+
+  // Writer: hand the write buffer to the reader
+  void Publish()
+  {
+    int previous = shared.exchange(writeIndex | NEW_DATA, std::memory_order_acq_rel);
+    writeIndex = previous & INDEX_MASK;
+  }
+
+  // Reader: last buffer published
+  const T& Read()
+  {
+    if (shared.load(std::memory_order_relaxed) & NEW_DATA)
+    {
+      int previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+      readIndex = previous & INDEX_MASK;
+    }
+
+    return buffers[readIndex];
+  }
+
+private:
+
+  static const int INDEX_MASK = 3;
+  static const int NEW_DATA = 4;
+
+  T buffers[3];
+
+  int writeIndex{ 0 };
+  int readIndex{ 1 };
+  std::atomic<int> shared{ 2 };
+};
+
+#endif // !TXIKI_AUDIO_TRIPLE_BUFFER_H
@@ -0,0 +1,112 @@
+#ifndef TXIKI_AUDIO_VOICES_3D_H
+#define TXIKI_AUDIO_VOICES_3D_H
+
+#include <vector>
+
+#include "TxikiAudioSIMD.h"
+#include "TxikiAudioSound.h"
+
+// TxikiAudioVoices3D
+//
+// 3D state of the voices in SoA layout, built by the game thread once per update and handed off to the audio thread
+struct TxikiAudioVoices3D
+{
+  std::vector<TxikiAudioSound*> sounds;
+
+  std::vector<float> positionX;
+  std::vector<float> positionY;
+  std::vector<float> positionZ;
+
+  std::vector<float> velocityX;
+  std::vector<float> velocityY;
+  std::vector<float> velocityZ;
+
+  std::vector<float> minDistance;
+  std::vector<float> maxDistance;
+  std::vector<float> linearRolloff; // 1.0f for linear rolloff, 0.0f otherwise
+  std::vector<float> occlusionGain;
+  std::vector<float> occlusionLowPassCutoff;
+
+  // computed by TxikiAudioSpatializer: distance and direction in listener space (+X right, +Y up, +Z forward)
+  std::vector<float> distance;
+  std::vector<float> directionX;
+  std::vector<float> directionY;
+  std::vector<float> directionZ;
+  std::vector<float> attenuation;
+
+  // stereo gains, applied by the audio thread
+  std::vector<float> gainLeft;
+  std::vector<float> gainRight;
+
+  // Doppler pitch factors, applied by the audio thread
+  std::vector<float> doppler;
+
+  // low-pass cutoffs in Hz of occlusion and air absorption, applied by the audio thread
+  std::vector<float> lowPassCutoff;
+
+  // HRTF slot of the voices rendered binaurally (-1 = panned)
+  std::vector<int> hrtfSlot;
+
+  // ambisonic mix: encoding gains in world space, one channel after another (padded size each),
+  // and the rotation from world to listener ambisonic coordinates
+  std::vector<float> ambisonicGains;
+  float listenerRotation[3][3];
+
+  // multichannel layouts: VBAP gains, one speaker after another (padded size each)
+  std::vector<float> speakerGains;
+
+  // early reflections: the same number of taps per voice, first order ones first.
+  // Tap delays in frames, and tap gains one output channel after another (padded number of taps each).
+  size_t numReflectionTaps{ 0 };
+  size_t numFirstOrderReflections{ 0 };
+  std::vector<uint32_t> reflectionDelays;
+  std::vector<float> reflectionGains;
+
+  size_t Size() const { return sounds.size(); }
+
+  // Note: the capacity is kept, so the buffers stop allocating once they are big enough
+  void Clear()
+  {
+    sounds.clear();
+    for (auto values : { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &minDistance, &maxDistance, &linearRolloff, &occlusionGain, &occlusionLowPassCutoff })
+    {
+      values->clear();
+    }
+  }
+
+  void Add(TxikiAudioSound& sound)
+  {
+    sounds.push_back(&sound);
+    positionX.push_back(sound.position.x);
+    positionY.push_back(sound.position.y);
+    positionZ.push_back(sound.position.z);
+    velocityX.push_back(sound.velocity.x);
+    velocityY.push_back(sound.velocity.y);
+    velocityZ.push_back(sound.velocity.z);
+    minDistance.push_back(sound.minDistance);
+    maxDistance.push_back(sound.maxDistance);
+    linearRolloff.push_back(sound.rolloff.type == AudioSystemRolloffType::LINEAR ? 1.0f : 0.0f);
+    occlusionGain.push_back(sound.occlusionGain);
+    occlusionLowPassCutoff.push_back(sound.occlusionLowPassCutoff);
+  }
+
+  // Fill the last lanes, so the voices can be processed 4 at a time
+  void Pad()
+  {
+    size_t paddedSize = TxikiAudioSIMD::PaddedSize(Size());
+    for (auto values : { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &minDistance, &maxDistance, &linearRolloff, &occlusionGain, &occlusionLowPassCutoff })
+    {
+      values->resize(paddedSize, 1.0f);
+    }
+
+    for (auto values : { &distance, &directionX, &directionY, &directionZ, &attenuation, &gainLeft, &gainRight })
+    {
+      values->resize(paddedSize, 0.0f);
+    }
+
+    doppler.resize(paddedSize, 1.0f);
+    lowPassCutoff.resize(paddedSize, 22000.0f);
+  }
+};
+
+#endif // !TXIKI_AUDIO_VOICES_3D_H
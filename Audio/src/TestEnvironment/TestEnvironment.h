@@ -136,6 +136,35 @@ protected:
 		// init audio
 		AudioManager::Initialise();
 
+		// the cubes occlude the sounds
+		for (int i = 0; i < NUM_CUBES; i++)
+		{
+			if (cubes[i].enabled)
+			{
+				AudioSystemOcclusionBox box;
+				box.center = { cubes[i].pos.x, cubes[i].pos.y, cubes[i].pos.z };
+				box.halfExtents = { cubes[i].scale.x, cubes[i].scale.y, cubes[i].scale.z };
+				box.rotation = { cubes[i].rotation.x, cubes[i].rotation.y, cubes[i].rotation.z };
+				box.occlusion = 0.7f;
+				AudioManager::AddOcclusionBox(box);
+			}
+		}
+
+		// the floor and the walls around it make a room, for the early reflections
+		AudioSystemRoom room;
+		room.walls.resize(5);
+		room.walls[0].normal = { 0.0f, 1.0f, 0.0f };
+		room.walls[0].offset = cubes[0].pos.y + cubes[0].scale.y;
+		room.walls[1].normal = { -1.0f, 0.0f, 0.0f };
+		room.walls[1].offset = -(cubes[1].pos.x - cubes[1].scale.x);
+		room.walls[2].normal = { 1.0f, 0.0f, 0.0f };
+		room.walls[2].offset = cubes[2].pos.x + cubes[2].scale.x;
+		room.walls[3].normal = { 0.0f, 0.0f, -1.0f };
+		room.walls[3].offset = -(cubes[3].pos.z - cubes[3].scale.z);
+		room.walls[4].normal = { 0.0f, 0.0f, 1.0f };
+		room.walls[4].offset = cubes[4].pos.z + cubes[4].scale.z;
+		AudioManager::SetRoom(room);
+
 		// set an audio source
 		AudioManager::AudioSourceDesc audioSourceDesc;
 		audioSourceDesc.soundName = "sound.wav";
@@ -144,6 +173,12 @@ protected:
 		audioSourceDesc.maxDistance = 100.0f;
 		
 		audioSource = AudioManager::SetAudioSource(audioSourceDesc);
+
+		// the room reverberates
+		AudioSystemReverb reverb;
+		reverb.decayTime = 1.2f;
+		AudioManager::SetReverb(reverb);
+		AudioManager::SetSoundReverbSend(audioSourceDesc.soundName, 0.3f);
 	}
 		
 	void InitVBO()
@@ -0,0 +1,531 @@
+#ifndef AUDIO_COOKER_H
+#define AUDIO_COOKER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "..\..\Audio\System\System_Common\AudioSystemParallel.h"
+#include "..\..\Audio\System\System_Common\AudioSystemSoundBank.h"
+#include "..\..\Audio\System\System_TxikiAudio\TxikiAudio\TxikiAudioSoundFileReader.h"
+
+#include "AudioCookerResampler.h"
+
+// AudioCooker
+//
+// Builds a sound bank from a directory of WAV files:
+//  - channels are normalised to stereo and resampled offline to the bank sample rate
+//  - leading and trailing silence is trimmed
+//  - the peak of each block of frames is stored along the samples
+//  - a manifest with all the sound names is written next to the bank
+//
+// Cooked sounds are cached by content hash, so only the files that changed are cooked again.
+class AudioCooker
+{
+public:
+
+  struct Params
+  {
+    std::string inputPath;
+    std::string bankPath;
+    std::string cachePath;         // empty = <bankPath>.cache
+
+    float trimThresholdDb{ -60.0f };
+    bool trimSilence{ true };
+
+    size_t maxThreads{ 0 };        // 0 = one per hardware thread
+  };
+
+  bool Cook(const Params& params_)
+  {
+    params = params_;
+    if (params.cachePath.empty())
+    {
+      params.cachePath = params.bankPath + ".cache";
+    }
+    MakeDirectory(params.cachePath);
+
+    // find the sounds to cook
+    std::vector<std::string> soundNames;
+    ListWaveFiles(params.inputPath, "", soundNames);
+    std::sort(soundNames.begin(), soundNames.end());
+
+    if (soundNames.empty())
+    {
+      printf("No WAV files found in %s\n", params.inputPath.c_str());
+      return false;
+    }
+
+    // cook them in parallel
+    std::vector<CookedSound> cookedSounds(soundNames.size());
+    std::atomic<size_t> numCacheHits{ 0 };
+    std::atomic<bool> failed{ false };
+
+    AudioSystemParallel::For(soundNames.size(), params.maxThreads, [&](size_t i)
+    {
+      cookedSounds[i].name = soundNames[i];
+
+      bool cacheHit = false;
+      if (!CookSound(cookedSounds[i], cacheHit))
+      {
+        failed = true;
+      }
+      else if (cacheHit)
+      {
+        numCacheHits++;
+      }
+    }, [](size_t numJobsDone, size_t numJobs)
+    {
+      printf("\rCooking %d/%d", (int)numJobsDone, (int)numJobs);
+    });
+    printf("\n");
+
+    if (failed)
+    {
+      return false;
+    }
+
+    printf("%d sounds cooked, %d up to date\n", (int)(soundNames.size() - numCacheHits), (int)numCacheHits);
+
+    return WriteBank(cookedSounds) && WriteManifest(cookedSounds);
+  }
+
+private:
+
+  static const uint32_t CACHE_MAGIC = 0x4B435854; // "TXCK"
+  static const uint32_t CACHE_VERSION = 1;
+
+  struct CookedSound
+  {
+    std::string name;
+    std::vector<short> samples;
+    std::vector<uint16_t> peaks;
+  };
+
+  bool CookSound(CookedSound& cookedSound, bool& outCacheHit) const
+  {
+    std::string soundPath = params.inputPath + "/" + cookedSound.name;
+
+    std::vector<char> fileData;
+    if (!ReadFile(soundPath, fileData))
+    {
+      printf("\nError: Unable to read %s\n", soundPath.c_str());
+      return false;
+    }
+
+    // the cache key covers the file content and the cook settings
+    std::ostringstream settings;
+    settings << AudioSystemSoundBankHeader::VERSION << ' ' << AudioSystemSoundBankHeader::SAMPLE_RATE << ' ' << params.trimSilence << ' ' << params.trimThresholdDb;
+
+    uint64_t hash = Hash(fileData.data(), fileData.size(), 14695981039346656037ULL);
+    hash = Hash(settings.str().data(), settings.str().size(), hash);
+
+    char hashName[32];
+    snprintf(hashName, sizeof(hashName), "%016llx", (unsigned long long)hash);
+    std::string cacheFilePath = params.cachePath + "/" + hashName;
+
+    outCacheHit = ReadCache(cacheFilePath, cookedSound);
+    if (outCacheHit)
+    {
+      return true;
+    }
+
+    // parse the file with the runtime WAV reader
+    std::ifstream soundFile(soundPath.c_str(), std::ios_base::binary);
+    TxikiAudioSoundDesc soundDesc;
+    SoundFileReader_WAVE reader;
+    if (!soundFile.is_open() || !reader.Read(soundFile, soundDesc))
+    {
+      printf("\nError: Unable to parse %s\n", soundPath.c_str());
+      return false;
+    }
+
+    std::vector<float> samples = ToStereo(soundDesc);
+
+    if (soundDesc.sampleRate != AudioSystemSoundBankHeader::SAMPLE_RATE)
+    {
+      AudioCookerResampler resampler(soundDesc.sampleRate, AudioSystemSoundBankHeader::SAMPLE_RATE);
+      samples = resampler.Process(samples, AudioSystemSoundBankHeader::NUM_CHANNELS);
+    }
+
+    if (params.trimSilence)
+    {
+      TrimSilence(samples);
+    }
+
+    ToPCM16(samples, cookedSound);
+    ComputePeaks(cookedSound);
+
+    WriteCache(cacheFilePath, cookedSound);
+    return true;
+  }
+
+  static std::vector<float> ToStereo(const TxikiAudioSoundDesc& soundDesc)
+  {
+    const size_t numChannels = soundDesc.numChannels;
+    const size_t numFrames = numChannels ? soundDesc.samplesBufferSize / numChannels : 0;
+
+    std::vector<float> stereo(numFrames * 2);
+
+    for (size_t frame = 0; frame < numFrames; frame++)
+    {
+      const short* in = &soundDesc.samples[frame * numChannels];
+
+      float left = in[0];
+      float right = numChannels > 1 ? in[1] : in[0];
+
+      // fold any extra channel into both sides at -3dB
+      for (size_t c = 2; c < numChannels; c++)
+      {
+        left += in[c] * 0.7071f;
+        right += in[c] * 0.7071f;
+      }
+
+      stereo[frame * 2] = left;
+      stereo[frame * 2 + 1] = right;
+    }
+
+    return stereo;
+  }
+
+  void TrimSilence(std::vector<float>& samples) const
+  {
+    const float threshold = 32767.0f * std::pow(10.0f, params.trimThresholdDb / 20.0f);
+    const size_t numFrames = samples.size() / 2;
+
+    auto isSilent = [&](size_t frame)
+    {
+      return std::fabs(samples[frame * 2]) <= threshold && std::fabs(samples[frame * 2 + 1]) <= threshold;
+    };
+
+    size_t first = 0;
+    while (first < numFrames && isSilent(first))
+    {
+      first++;
+    }
+
+    size_t last = numFrames;
+    while (last > first && isSilent(last - 1))
+    {
+      last--;
+    }
+
+    samples = std::vector<float>(samples.begin() + first * 2, samples.begin() + last * 2);
+  }
+
+  static void ToPCM16(const std::vector<float>& samples, CookedSound& cookedSound)
+  {
+    cookedSound.samples.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+      float value = std::floor(samples[i] + 0.5f);
+      cookedSound.samples[i] = short(value < -32768.0f ? -32768.0f : (value > 32767.0f ? 32767.0f : value));
+    }
+  }
+
+  static void ComputePeaks(CookedSound& cookedSound)
+  {
+    const size_t blockSamples = AudioSystemSoundBankHeader::PEAK_BLOCK_FRAMES * AudioSystemSoundBankHeader::NUM_CHANNELS;
+    const size_t numSamples = cookedSound.samples.size();
+
+    cookedSound.peaks.clear();
+    for (size_t blockStart = 0; blockStart < numSamples; blockStart += blockSamples)
+    {
+      size_t blockEnd = std::min(blockStart + blockSamples, numSamples);
+
+      int peak = 0;
+      for (size_t i = blockStart; i < blockEnd; i++)
+      {
+        peak = std::max(peak, std::abs(int(cookedSound.samples[i])));
+      }
+
+      cookedSound.peaks.push_back(uint16_t(peak));
+    }
+  }
+
+  bool WriteBank(std::vector<CookedSound>& cookedSounds) const
+  {
+    const uint64_t alignment = AudioSystemSoundBankHeader::ALIGNMENT;
+    auto align = [alignment](uint64_t offset) { return (offset + alignment - 1) / alignment * alignment; };
+
+    // table of contents sorted by name hash
+    std::sort(cookedSounds.begin(), cookedSounds.end(), [](const CookedSound& a, const CookedSound& b)
+    {
+      uint64_t hashA = AudioSystemSoundBank::Hash(a.name.c_str());
+      uint64_t hashB = AudioSystemSoundBank::Hash(b.name.c_str());
+      return hashA != hashB ? hashA < hashB : a.name < b.name;
+    });
+
+    AudioSystemSoundBankHeader header;
+    header.numEntries = uint32_t(cookedSounds.size());
+    header.namesOffset = sizeof(AudioSystemSoundBankHeader) + cookedSounds.size() * sizeof(AudioSystemSoundBankEntry);
+
+    std::string names;
+    std::vector<AudioSystemSoundBankEntry> entries(cookedSounds.size());
+    for (size_t i = 0; i < cookedSounds.size(); i++)
+    {
+      entries[i].nameHash = AudioSystemSoundBank::Hash(cookedSounds[i].name.c_str());
+      entries[i].nameOffset = uint32_t(names.size());
+      names += cookedSounds[i].name;
+      names += '\0';
+    }
+    header.namesSize = names.size();
+
+    uint64_t offset = header.namesOffset + header.namesSize;
+    for (size_t i = 0; i < cookedSounds.size(); i++)
+    {
+      AudioSystemSoundBankEntry& entry = entries[i];
+      entry.numChannels = AudioSystemSoundBankHeader::NUM_CHANNELS;
+      entry.sampleRate = AudioSystemSoundBankHeader::SAMPLE_RATE;
+
+      entry.samplesOffset = align(offset);
+      entry.numSamples = cookedSounds[i].samples.size();
+      offset = entry.samplesOffset + entry.numSamples * sizeof(short);
+
+      entry.peaksOffset = align(offset);
+      entry.numPeaks = uint32_t(cookedSounds[i].peaks.size());
+      offset = entry.peaksOffset + entry.numPeaks * sizeof(uint16_t);
+    }
+
+    std::ofstream bankFile(params.bankPath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+    if (!bankFile.is_open())
+    {
+      printf("Error: Unable to write %s\n", params.bankPath.c_str());
+      return false;
+    }
+
+    bankFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bankFile.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(AudioSystemSoundBankEntry));
+    bankFile.write(names.data(), names.size());
+
+    auto pad = [&](uint64_t targetOffset)
+    {
+      static const char zeros[AudioSystemSoundBankHeader::ALIGNMENT] = {};
+      bankFile.write(zeros, std::streamsize(targetOffset - uint64_t(bankFile.tellp())));
+    };
+
+    for (size_t i = 0; i < cookedSounds.size(); i++)
+    {
+      pad(entries[i].samplesOffset);
+      bankFile.write(reinterpret_cast<const char*>(cookedSounds[i].samples.data()), cookedSounds[i].samples.size() * sizeof(short));
+
+      pad(entries[i].peaksOffset);
+      bankFile.write(reinterpret_cast<const char*>(cookedSounds[i].peaks.data()), cookedSounds[i].peaks.size() * sizeof(uint16_t));
+    }
+
+    if (!bankFile.good())
+    {
+      printf("Error: Unable to write %s\n", params.bankPath.c_str());
+      return false;
+    }
+
+    printf("Sound bank %s written: %d sounds, %d bytes\n", params.bankPath.c_str(), (int)cookedSounds.size(), (int)offset);
+    return true;
+  }
+
+  bool WriteManifest(const std::vector<CookedSound>& cookedSounds) const
+  {
+    // <bank name without extension>.manifest, loadable with AudioSystem::LoadSoundManifest
+    std::string manifestPath = params.bankPath;
+    size_t extension = manifestPath.find_last_of('.');
+    size_t directory = manifestPath.find_last_of("/\\");
+    if (extension != std::string::npos && (directory == std::string::npos || extension > directory))
+    {
+      manifestPath.resize(extension);
+    }
+    manifestPath += ".manifest";
+
+    std::vector<std::string> soundNames;
+    for (auto& cookedSound : cookedSounds)
+    {
+      soundNames.push_back(cookedSound.name);
+    }
+    std::sort(soundNames.begin(), soundNames.end());
+
+    std::ofstream manifestFile(manifestPath.c_str(), std::ios_base::trunc);
+    if (!manifestFile.is_open())
+    {
+      printf("Error: Unable to write %s\n", manifestPath.c_str());
+      return false;
+    }
+
+    manifestFile << "# sounds in " << params.bankPath << "\n";
+    for (auto& soundName : soundNames)
+    {
+      manifestFile << soundName << "\n";
+    }
+
+    return manifestFile.good();
+  }
+
+  static bool ReadCache(const std::string& cacheFilePath, CookedSound& cookedSound)
+  {
+    std::ifstream cacheFile(cacheFilePath.c_str(), std::ios_base::binary);
+    if (!cacheFile.is_open())
+    {
+      return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t numSamples = 0;
+    uint64_t numPeaks = 0;
+    cacheFile.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    cacheFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+    cacheFile.read(reinterpret_cast<char*>(&numSamples), sizeof(numSamples));
+    cacheFile.read(reinterpret_cast<char*>(&numPeaks), sizeof(numPeaks));
+    if (!cacheFile.good() || magic != CACHE_MAGIC || version != CACHE_VERSION)
+    {
+      return false;
+    }
+
+    cookedSound.samples.resize(size_t(numSamples));
+    cookedSound.peaks.resize(size_t(numPeaks));
+    cacheFile.read(reinterpret_cast<char*>(cookedSound.samples.data()), numSamples * sizeof(short));
+    cacheFile.read(reinterpret_cast<char*>(cookedSound.peaks.data()), numPeaks * sizeof(uint16_t));
+
+    return cacheFile.good();
+  }
+
+  static void WriteCache(const std::string& cacheFilePath, const CookedSound& cookedSound)
+  {
+    std::ofstream cacheFile(cacheFilePath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+
+    uint32_t magic = CACHE_MAGIC;
+    uint32_t version = CACHE_VERSION;
+    uint64_t numSamples = cookedSound.samples.size();
+    uint64_t numPeaks = cookedSound.peaks.size();
+    cacheFile.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    cacheFile.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    cacheFile.write(reinterpret_cast<const char*>(&numSamples), sizeof(numSamples));
+    cacheFile.write(reinterpret_cast<const char*>(&numPeaks), sizeof(numPeaks));
+    cacheFile.write(reinterpret_cast<const char*>(cookedSound.samples.data()), numSamples * sizeof(short));
+    cacheFile.write(reinterpret_cast<const char*>(cookedSound.peaks.data()), numPeaks * sizeof(uint16_t));
+  }
+
+  // FNV-1a
+  static uint64_t Hash(const char* data, size_t size, uint64_t hash)
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      hash ^= static_cast<uint8_t>(data[i]);
+      hash *= 1099511628211ULL;
+    }
+
+    return hash;
+  }
+
+  static bool ReadFile(const std::string& path, std::vector<char>& outData)
+  {
+    std::ifstream file(path.c_str(), std::ios_base::binary | std::ios_base::ate);
+    if (!file.is_open())
+    {
+      return false;
+    }
+
+    outData.resize(size_t(file.tellg()));
+    file.seekg(0, file.beg);
+    file.read(outData.data(), outData.size());
+
+    return file.good();
+  }
+
+  static bool IsWaveFile(const std::string& fileName)
+  {
+    if (fileName.size() < 4)
+    {
+      return false;
+    }
+
+    std::string extension = fileName.substr(fileName.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".wav";
+  }
+
+  // Recursively list the WAV files, with '/' separated names relative to the input directory
+  static void ListWaveFiles(const std::string& rootPath, const std::string& relativePath, std::vector<std::string>& outNames)
+  {
+    std::string directoryPath = relativePath.empty() ? rootPath : rootPath + "/" + relativePath;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((directoryPath + "/*").c_str(), &findData);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+      return;
+    }
+
+    do
+    {
+      std::string fileName = findData.cFileName;
+      bool isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    DIR* dir = opendir(directoryPath.c_str());
+    if (!dir)
+    {
+      return;
+    }
+
+    while (dirent* entry = readdir(dir))
+    {
+      std::string fileName = entry->d_name;
+
+      struct stat fileStat;
+      bool isDirectory = stat((directoryPath + "/" + fileName).c_str(), &fileStat) == 0 && S_ISDIR(fileStat.st_mode);
+#endif
+
+      if (fileName == "." || fileName == "..")
+      {
+        continue;
+      }
+
+      std::string name = relativePath.empty() ? fileName : relativePath + "/" + fileName;
+      if (isDirectory)
+      {
+        ListWaveFiles(rootPath, name, outNames);
+      }
+      else if (IsWaveFile(fileName))
+      {
+        outNames.push_back(name);
+      }
+
+#ifdef _WIN32
+    } while (FindNextFileA(find, &findData));
+    FindClose(find);
+#else
+    }
+    closedir(dir);
+#endif
+  }
+
+  static void MakeDirectory(const std::string& path)
+  {
+#ifdef _WIN32
+    CreateDirectoryA(path.c_str(), nullptr);
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+  }
+
+  Params params;
+};
+
+#endif // !AUDIO_COOKER_H
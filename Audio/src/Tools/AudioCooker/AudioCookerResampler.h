@@ -0,0 +1,128 @@
+#ifndef AUDIO_COOKER_RESAMPLER_H
+#define AUDIO_COOKER_RESAMPLER_H
+
+#include <cmath>
+#include <vector>
+
+// AudioCookerResampler
+//
+// Offline sample rate converter: Kaiser windowed sinc filter evaluated from a table of filter phases
+class AudioCookerResampler
+{
+public:
+
+  AudioCookerResampler(size_t inputRate_, size_t outputRate_, int halfTaps_ = 32, int numPhases_ = 512, double beta = 9.0)
+    : inputRate(inputRate_)
+    , outputRate(outputRate_)
+    , halfTaps(halfTaps_)
+    , numPhases(numPhases_)
+  {
+    // low pass below the lowest nyquist frequency, leaving some room for the transition band
+    double ratio = double(outputRate) / double(inputRate);
+    double cutoff = (ratio < 1.0 ? ratio : 1.0) * 0.96;
+
+    const double PI = 3.14159265358979323846;
+    size_t numTaps = 2 * halfTaps;
+    filter.resize((numPhases + 1) * numTaps);
+
+    for (int phase = 0; phase <= numPhases; phase++)
+    {
+      float* taps = &filter[phase * numTaps];
+      double frac = double(phase) / double(numPhases);
+
+      double sum = 0.0;
+      for (int j = 0; j < int(numTaps); j++)
+      {
+        // distance from the output time to the input sample (j - halfTaps + 1)
+        double d = frac - double(j - halfTaps + 1);
+        double x = d / double(halfTaps);
+
+        double window = std::fabs(x) < 1.0 ? BesselI0(beta * std::sqrt(1.0 - x * x)) / BesselI0(beta) : 0.0;
+        double sinc = d == 0.0 ? 1.0 : std::sin(PI * cutoff * d) / (PI * cutoff * d);
+        double tap = cutoff * sinc * window;
+
+        taps[j] = float(tap);
+        sum += tap;
+      }
+
+      // unity gain at DC
+      for (size_t j = 0; j < numTaps; j++)
+      {
+        taps[j] = float(taps[j] / sum);
+      }
+    }
+  }
+
+  // Resample interleaved samples
+  std::vector<float> Process(const std::vector<float>& input, size_t numChannels) const
+  {
+    size_t numInputFrames = input.size() / numChannels;
+    size_t numOutputFrames = size_t((unsigned long long)numInputFrames * outputRate / inputRate);
+
+    std::vector<float> output(numOutputFrames * numChannels, 0.0f);
+
+    size_t numTaps = 2 * halfTaps;
+    double step = double(inputRate) / double(outputRate);
+
+    for (size_t n = 0; n < numOutputFrames; n++)
+    {
+      double t = double(n) * step;
+      long long i0 = (long long)t;
+
+      double phasePos = (t - double(i0)) * numPhases;
+      int phase = int(phasePos);
+      float phaseFrac = float(phasePos - phase);
+
+      const float* tapsA = &filter[phase * numTaps];
+      const float* tapsB = tapsA + numTaps;
+
+      for (size_t c = 0; c < numChannels; c++)
+      {
+        float acc = 0.0f;
+        for (size_t j = 0; j < numTaps; j++)
+        {
+          long long k = i0 + (long long)j - halfTaps + 1;
+          if (k < 0 || k >= (long long)numInputFrames)
+          {
+            continue;
+          }
+
+          float tap = tapsA[j] + (tapsB[j] - tapsA[j]) * phaseFrac;
+          acc += input[size_t(k) * numChannels + c] * tap;
+        }
+
+        output[n * numChannels + c] = acc;
+      }
+    }
+
+    return output;
+  }
+
+private:
+
+  static double BesselI0(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; k++)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+      if (term < sum * 1e-12)
+      {
+        break;
+      }
+    }
+
+    return sum;
+  }
+
+  size_t inputRate;
+  size_t outputRate;
+  int halfTaps;
+  int numPhases;
+
+  std::vector<float> filter;
+};
+
+#endif // !AUDIO_COOKER_RESAMPLER_H
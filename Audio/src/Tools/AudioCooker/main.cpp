@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "AudioCooker.h"
+
+static void PrintUsage()
+{
+  printf("Usage: AudioCooker <input directory> <output bank> [options]\n");
+  printf("Options:\n");
+  printf("  --cache <directory>  cooked sounds cache (default: <output bank>.cache)\n");
+  printf("  --trim-db <dB>       silence threshold used to trim the sounds (default: -60)\n");
+  printf("  --no-trim            do not trim the silence\n");
+  printf("  --threads <count>    max number of cooking threads (default: one per hardware thread)\n");
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    PrintUsage();
+    return -1;
+  }
+
+  AudioCooker::Params params;
+  params.inputPath = argv[1];
+  params.bankPath = argv[2];
+
+  for (int i = 3; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--cache") == 0 && hasValue)
+    {
+      params.cachePath = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--trim-db") == 0 && hasValue)
+    {
+      params.trimThresholdDb = float(std::atof(argv[++i]));
+    }
+    else if (std::strcmp(argv[i], "--no-trim") == 0)
+    {
+      params.trimSilence = false;
+    }
+    else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+    {
+      params.maxThreads = size_t(std::atoi(argv[++i]));
+    }
+    else
+    {
+      printf("Unknown option %s\n", argv[i]);
+      PrintUsage();
+      return -1;
+    }
+  }
+
+  AudioCooker cooker;
+  if (!cooker.Cook(params))
+  {
+    printf("Cooking failed!\n");
+    return -1;
+  }
+
+  return 0;
+}